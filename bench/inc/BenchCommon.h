@@ -0,0 +1,221 @@
+
+// clang-format off
+
+
+#ifndef __BENCH_COMMON_H__
+#define __BENCH_COMMON_H__
+
+#include "TimeFrame.h"
+#include "WorkQueueStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+
+
+
+/**
+ * @brief Run-wide benchmark parameters, filled from the command line.
+ */
+struct BenchConfig
+{
+    size_t      _items          = 200'000;  // Items per throughput run
+    size_t      _latencyItems   = 20'000;   // Samples for the latency run
+    size_t      _maxProducers   = 8;        // Upper bound of the producer sweep
+    size_t      _maxWorkers     = 0;        // Upper bound of the pool sweep, 0 = hardware_concurrency
+    size_t      _layoutProducers = 32;      // Producer threads of the cache line layout run
+    uint64_t    _tickInterval   = MS_TO_NS(1);
+    size_t      _tickCount      = 1'000;
+};
+
+
+
+
+/**
+ * @brief Minimal streaming JSON writer, enough for flat benchmark reports.
+ *
+ * Commas are inserted automatically; the caller is responsible for balancing
+ * Begin/End calls.
+ */
+class JsonWriter
+{
+    public:
+        JsonWriter &BeginObject()                   { Sep(); _os << '{'; _first.push_back(true); return *this;  }
+        JsonWriter &EndObject()                     { _os << '}'; _first.pop_back();  return *this;             }
+        JsonWriter &BeginArray()                    { Sep(); _os << '['; _first.push_back(true); return *this;  }
+        JsonWriter &EndArray()                      { _os << ']'; _first.pop_back();  return *this;             }
+
+        JsonWriter &Key(const std::string &key)     { Sep(); Quoted(key); _os << ':'; _pendingKey = true; return *this; }
+
+        JsonWriter &Value(const std::string &val)   { Sep(); Quoted(val); return *this;             }
+        JsonWriter &Value(const char *val)          { return Value(std::string(val));               }
+        JsonWriter &Value(double val)               { Sep(); _os << val; return *this;              }
+        JsonWriter &Value(uint64_t val)             { Sep(); _os << val; return *this;              }
+        JsonWriter &Value(int64_t val)              { Sep(); _os << val; return *this;              }
+        JsonWriter &Value(bool val)                 { Sep(); _os << (val ? "true" : "false"); return *this; }
+
+        template <typename T>
+        JsonWriter &Field(const std::string &key, T val)  { return Key(key).Value(val); }
+
+        std::string Str() const                     { return _os.str(); }
+
+    private:
+        void Sep()
+        {
+            if (_pendingKey)
+            {
+                _pendingKey = false;
+                return;
+            }
+            if (false == _first.empty())
+            {
+                if (false == _first.back())
+                    _os << ',';
+                _first.back() = false;
+            }
+        }
+
+        //Queue names are user supplied
+        void Quoted(const std::string &str)        { _os << '"' << WQEscapeJson(str) << '"'; }
+
+        std::ostringstream  _os;
+        std::vector<bool>   _first;
+        bool                _pendingKey = false;
+};
+
+
+
+
+/**
+ * @brief Hardware event counter (perf_event_open) of the calling thread and of every
+ * thread started after Start(); counts of exited threads are folded in on exit.
+ *
+ * Open() fails where perf is not accessible (perf_event_paranoid, containers),
+ * Stop() then returns 0.
+ */
+class BenchPerfCounter
+{
+    public:
+        ~BenchPerfCounter()                         { if (_fd >= 0) close(_fd); }
+
+        bool        Open(uint32_t type, uint64_t config)
+        {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size           = sizeof(attr);
+            attr.type           = type;
+            attr.config         = config;
+            attr.disabled       = 1;
+            attr.inherit        = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv     = 1;
+            _fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            return _fd >= 0;
+        }
+
+        void        Start()
+        {
+            if (_fd < 0)
+                return;
+            ioctl(_fd, PERF_EVENT_IOC_RESET,  0);
+            ioctl(_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+
+        uint64_t    Stop()
+        {
+            uint64_t val = 0;
+            if (_fd >= 0)
+            {
+                ioctl(_fd, PERF_EVENT_IOC_DISABLE, 0);
+                if (sizeof(val) != read(_fd, &val, sizeof(val)))
+                    val = 0;
+            }
+            return val;
+        }
+
+    private:
+        int         _fd = -1;
+};
+
+
+
+
+inline uint64_t BenchNowNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return TimespecToNs(ts);
+}
+
+
+inline void BenchSpinNs(uint64_t ns)
+{
+    uint64_t until = BenchNowNs() + ns;
+    while (BenchNowNs() < until)
+        ;
+}
+
+
+/**
+ * @brief Percentile of an already sorted sample set, nearest-rank method: sample ceil(p * N) - 1.
+ */
+inline uint64_t BenchPercentile(const std::vector<uint64_t> &sorted, double pct)
+{
+    if (sorted.empty())
+        return 0;
+
+    size_t rank = size_t(std::ceil((pct / 100.0) * sorted.size()));
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+
+/**
+ * @brief Writes {count, mean, p50, p90, p99, p999, max} of the samples into the current object.
+ */
+inline void BenchWriteDistribution(JsonWriter &json, std::vector<uint64_t> &samples)
+{
+    std::sort(samples.begin(), samples.end());
+
+    double mean = 0;
+    for (uint64_t val : samples)
+        mean += val;
+    if (false == samples.empty())
+        mean /= samples.size();
+
+    json.Field("count",   uint64_t(samples.size()))
+        .Field("mean_ns", mean)
+        .Field("p50_ns",  BenchPercentile(samples, 50.0))
+        .Field("p90_ns",  BenchPercentile(samples, 90.0))
+        .Field("p99_ns",  BenchPercentile(samples, 99.0))
+        .Field("p999_ns", BenchPercentile(samples, 99.9))
+        .Field("max_ns",  samples.empty() ? uint64_t(0) : samples.back());
+}
+
+
+
+
+void BenchQueueThroughput(const BenchConfig &cfg, JsonWriter &json);
+void BenchQueueLatency   (const BenchConfig &cfg, JsonWriter &json);
+void BenchQueueBatch     (const BenchConfig &cfg, JsonWriter &json);
+void BenchQueueJournal   (const BenchConfig &cfg, JsonWriter &json);
+void BenchPoolScaling    (const BenchConfig &cfg, JsonWriter &json);
+void BenchPoolMinIdx     (const BenchConfig &cfg, JsonWriter &json);
+void BenchPoolLayout     (const BenchConfig &cfg, JsonWriter &json);
+void BenchParallelFor    (const BenchConfig &cfg, JsonWriter &json);
+void BenchTickJitter     (const BenchConfig &cfg, JsonWriter &json);
+void BenchTimeFrame      (const BenchConfig &cfg, JsonWriter &json);
+
+
+#endif // __BENCH_COMMON_H__
+
+// clang-format on
@@ -0,0 +1,280 @@
+
+// clang-format off
+
+
+#include "BenchCommon.h"
+
+#include <WorkQueue.h>
+
+#include <thread>
+#include <vector>
+
+
+
+
+class ScalingPool : public WorkQueuePool<uint64_t, ScalingPool>
+{
+    public:
+        ScalingPool(size_t queCount)
+            : WorkQueuePool<uint64_t, ScalingPool>(queCount)
+        {
+        }
+
+        void Begin()    {}
+        void End()      {}
+
+        int Pop(uint64_t *pData)
+        {
+            BenchSpinNs(*pData);
+            return 0;
+        }
+};
+
+
+/**
+ * @brief Fixed amount of ~1us work items spread over 1..N workers.
+ */
+void BenchPoolScaling(const BenchConfig &cfg, JsonWriter &json)
+{
+    constexpr uint64_t workNs = US_TO_NS(1);
+
+    size_t maxWorkers = cfg._maxWorkers ? cfg._maxWorkers : std::max(1U, std::thread::hardware_concurrency());
+    size_t items      = cfg._items / 4;
+    double base       = 0;
+
+    json.Key("pool_scaling").BeginArray();
+    for (size_t workers = 1; workers <= maxWorkers; workers = (workers < maxWorkers && workers * 2 > maxWorkers) ? maxWorkers : workers * 2)
+    {
+        ScalingPool pool(workers);
+        pool.Init(WQ_QUEUE_STATE::WORKING, "bench.scaling");
+
+        TimeFrame tf;
+        for (size_t i = 0; i < items; ++i)
+            pool.PushBack(uint64_t(workNs));
+        pool.Release();
+        tf.Stop();
+
+        double sec  = NS_TO_SEC(double(tf.ElapsNs()));
+        double rate = sec > 0 ? items / sec : 0.0;
+        if (workers == 1)
+            base = rate;
+
+        json.BeginObject()
+            .Field("workers",       uint64_t(workers))
+            .Field("work_ns",       workNs)
+            .Field("items",         uint64_t(items))
+            .Field("elapsed_ns",    tf.ElapsNs())
+            .Field("items_per_sec", rate)
+            .Field("speedup",       base > 0 ? rate / base : 0.0)
+            .EndObject();
+
+        if (workers == maxWorkers)
+            break;
+    }
+    json.EndArray();
+}
+
+
+
+/**
+ * @brief ParallelFor over ~1us elements, 1..N participants (pool workers + the caller).
+ *
+ * The speedup is against a plain loop on the calling thread.
+ */
+void BenchParallelFor(const BenchConfig &cfg, JsonWriter &json)
+{
+    constexpr uint64_t workNs = US_TO_NS(1);
+
+    size_t maxWorkers = cfg._maxWorkers ? cfg._maxWorkers : std::max(1U, std::thread::hardware_concurrency());
+    size_t items      = cfg._items;
+
+    TimeFrame tfSerial;
+    for (size_t i = 0; i < items; ++i)
+        BenchSpinNs(workNs);
+    tfSerial.Stop();
+    double serialNs = double(tfSerial.ElapsNs());
+
+    json.Key("parallel_for").BeginObject()
+        .Field("work_ns",   workNs)
+        .Field("items",     uint64_t(items))
+        .Field("serial_ns", uint64_t(serialNs))
+        .Key("runs").BeginArray();
+
+    for (size_t workers = 1; workers <= maxWorkers; workers = (workers < maxWorkers && workers * 2 > maxWorkers) ? maxWorkers : workers * 2)
+    {
+        ScalingPool pool(workers - 1);      // the caller is the last participant
+        pool.Init(WQ_QUEUE_STATE::WORKING, "bench.parallel");
+
+        TimeFrame tf;
+        pool.ParallelFor(0, items, [](size_t) { BenchSpinNs(workNs); });
+        tf.Stop();
+        pool.Release();
+
+        json.BeginObject()
+            .Field("workers",       uint64_t(workers))
+            .Field("elapsed_ns",    tf.ElapsNs())
+            .Field("speedup",       tf.ElapsNs() > 0 ? serialNs / double(tf.ElapsNs()) : 0.0)
+            .EndObject();
+
+        if (workers == maxWorkers)
+            break;
+    }
+    json.EndArray().EndObject();
+}
+
+
+
+
+class PausedQueue : public WorkQueue<uint64_t, PausedQueue>
+{
+    public:
+        void Begin()                { SetWaitTime({0, long(MS_TO_NS(1))}); }
+        void End()                  {}
+        int  Pop(uint64_t *)        { return 0; }
+};
+
+
+/**
+ * @brief Cost of the MinIdx() scan on WorkQueuePool::PushBack.
+ *
+ * Both the pool and the reference queue are started and then paused, so the
+ * workers stay parked on their condition variable and pushes are rejected
+ * right after the state check: the pool figure minus the single queue figure
+ * is the price of selecting the least loaded worker.
+ */
+void BenchPoolMinIdx(const BenchConfig &cfg, JsonWriter &json)
+{
+    size_t items = cfg._items;
+
+    double refNs = 0;
+    {
+        PausedQueue que;
+        que.Init(WQ_QUEUE_STATE::WORKING, "bench.minidx.ref");
+        que.SetState(WQ_QUEUE_STATE::PAUSE);
+
+        TimeFrame tf;
+        for (size_t i = 0; i < items; ++i)
+            que.PushBack(uint64_t(i));
+        tf.Stop();
+        refNs = double(tf.ElapsNs()) / items;
+
+        que.Release();
+    }
+
+    json.Key("pool_minidx").BeginObject()
+        .Field("queue_push_ns", refNs)
+        .Key("pools").BeginArray();
+
+    for (size_t workers : {1, 2, 4, 8, 16, 32, 64})
+    {
+        ScalingPool pool(workers);
+        pool.Init(WQ_QUEUE_STATE::WORKING, "bench.minidx");
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));     // let the workers park
+        pool.SetState(WQ_QUEUE_STATE::PAUSE);
+
+        TimeFrame tf;
+        for (size_t i = 0; i < items; ++i)
+            pool.PushBack(uint64_t(i));
+        tf.Stop();
+        double pushNs = double(tf.ElapsNs()) / items;
+
+        pool.Release();
+
+        json.BeginObject()
+            .Field("workers",       uint64_t(workers))
+            .Field("push_ns",       pushNs)
+            .Field("minidx_ns",     std::max(0.0, pushNs - refNs))
+            .EndObject();
+    }
+
+    json.EndArray().EndObject();
+}
+
+
+
+
+template <typename TPolicy>
+class LayoutPool : public WorkQueuePool<uint64_t, LayoutPool<TPolicy>, TPolicy>
+{
+    public:
+        LayoutPool(size_t queCount)
+            : WorkQueuePool<uint64_t, LayoutPool<TPolicy>, TPolicy>(queCount)
+        {
+        }
+
+        void Begin()                {}
+        void End()                  {}
+        int  Pop(uint64_t *)        { return 0; }
+};
+
+
+template <typename TPolicy>
+static void RunLayout(const BenchConfig &cfg, const char *layout, JsonWriter &json)
+{
+    size_t producers   = std::max<size_t>(1, cfg._layoutProducers);
+    size_t workers     = 8;
+    size_t perProducer = std::max<size_t>(1, cfg._items / producers);
+
+    BenchPerfCounter misses;
+    BenchPerfCounter l1dMisses;
+    bool perf = misses.Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    l1dMisses.Open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+
+    misses.Start();
+    l1dMisses.Start();
+    TimeFrame tf;
+    {
+        LayoutPool<TPolicy> pool(workers);
+        pool.Init(WQ_QUEUE_STATE::WORKING, "bench.layout");
+
+        std::vector<std::thread> threads;
+        for (size_t idx = 0; idx < producers; ++idx)
+            threads.emplace_back([&pool, perProducer]()
+            {
+                for (size_t i = 0; i < perProducer; ++i)
+                    pool.PushBack(uint64_t(i));
+            });
+        for (auto &th : threads)
+            th.join();
+        pool.Release();
+    }
+    tf.Stop();
+    uint64_t missCount    = misses.Stop();
+    uint64_t l1dMissCount = l1dMisses.Stop();
+
+    double items = double(producers * perProducer);
+    double sec   = NS_TO_SEC(double(tf.ElapsNs()));
+    json.BeginObject()
+        .Field("layout",            layout)
+        .Field("align",             uint64_t(TPolicy::Align))
+        .Field("producers",         uint64_t(producers))
+        .Field("workers",           uint64_t(workers))
+        .Field("items",             uint64_t(items))
+        .Field("elapsed_ns",        tf.ElapsNs())
+        .Field("items_per_sec",     sec > 0 ? items / sec : 0.0)
+        .Field("perf_available",    perf)
+        .Field("cache_misses",      missCount)
+        .Field("l1d_read_misses",   l1dMissCount)
+        .Field("misses_per_item",   double(missCount) / items)
+        .EndObject();
+}
+
+
+/**
+ * @brief Cache misses of many producers feeding a pool, padded vs compact queue layout.
+ *
+ * The padded layout (WQDefaultPolicy) keeps the queue lock, the depth polled by
+ * MinIdx, the state and the worker side fields on separate cache lines; the compact
+ * one (WQCompactPolicy) packs them. Counters come from perf_event_open and cover the
+ * producers and the workers; they read 0 where perf is not accessible.
+ */
+void BenchPoolLayout(const BenchConfig &cfg, JsonWriter &json)
+{
+    json.Key("pool_layout").BeginArray();
+    RunLayout<WQCompactPolicy>(cfg, "compact", json);
+    RunLayout<WQDefaultPolicy>(cfg, "padded",  json);
+    json.EndArray();
+}
+
+
+// clang-format on
@@ -0,0 +1,60 @@
+
+// clang-format off
+
+
+#include "BenchCommon.h"
+
+#include <WorkQueue.h>
+
+
+
+
+class JitterTicker : public TickThread<JitterTicker>
+{
+    public:
+        bool OnBegin()      { _stamps.reserve(_limit + 1); return true; }
+        void OnEnd()        {}
+
+        void Tick()         { _stamps.push_back(BenchNowNs()); }
+
+        size_t                  _limit = 0;
+        std::vector<uint64_t>   _stamps;
+};
+
+
+/**
+ * @brief Deviation of the observed TickThread period from the configured interval.
+ */
+void BenchTickJitter(const BenchConfig &cfg, JsonWriter &json)
+{
+    JitterTicker ticker;
+    ticker._limit = cfg._tickCount;
+    ticker.SetInterval(cfg._tickInterval);
+    ticker.Start();
+
+    while (ticker.TickCount() <= ticker._limit)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ticker.Stop();
+
+    std::vector<uint64_t> jitter;
+    std::vector<uint64_t> period;
+    for (size_t idx = 1; idx < ticker._stamps.size(); ++idx)
+    {
+        uint64_t delta = ticker._stamps[idx] - ticker._stamps[idx - 1];
+        period.push_back(delta);
+        jitter.push_back(delta > cfg._tickInterval ? delta - cfg._tickInterval : cfg._tickInterval - delta);
+    }
+
+    json.Key("tick_jitter").BeginObject()
+        .Field("interval_ns", cfg._tickInterval)
+        .Key("period").BeginObject();
+    BenchWriteDistribution(json, period);
+    json.EndObject()
+        .Key("jitter").BeginObject();
+    BenchWriteDistribution(json, jitter);
+    json.EndObject()
+        .EndObject();
+}
+
+
+// clang-format on
@@ -0,0 +1,42 @@
+
+// clang-format off
+
+
+#include "BenchCommon.h"
+
+
+
+
+template <typename TFrame>
+static double FrameCostNs(size_t loops)
+{
+    int64_t   sink = 0;
+    TimeFrame total;
+    for (size_t i = 0; i < loops; ++i)
+    {
+        TFrame tf;
+        tf.Stop();
+        sink += tf.ElapsNs();
+    }
+    total.Stop();
+
+    return sink >= 0 ? double(total.ElapsNs()) / loops : 0.0;
+}
+
+
+/**
+ * @brief Cost of a construct + Stop + ElapsNs cycle per clock policy.
+ */
+void BenchTimeFrame(const BenchConfig &cfg, JsonWriter &json)
+{
+    ClockTsc::Calibrate();
+
+    json.Key("timeframe").BeginObject()
+        .Field("tsc_available", ClockTsc::Available())
+        .Field("monotonic_ns",  FrameCostNs<TimeFrame>   (cfg._items))
+        .Field("tsc_ns",        FrameCostNs<TimeFrameTsc>(cfg._items))
+        .EndObject();
+}
+
+
+// clang-format on
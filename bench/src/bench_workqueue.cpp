@@ -0,0 +1,291 @@
+
+// clang-format off
+
+
+#include "BenchCommon.h"
+
+#include <WorkQueue.h>
+#include <WorkQueueBatch.h>
+
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+
+
+template <size_t TSize>
+struct Payload
+{
+    uint8_t _bytes[TSize] {};
+};
+
+
+template <size_t TSize>
+class ThroughputQueue : public WorkQueue<Payload<TSize>, ThroughputQueue<TSize>>
+{
+    public:
+        void Begin()    {}
+        void End()      {}
+
+        int Pop(Payload<TSize> *pData)
+        {
+            _sink += pData->_bytes[0];
+            ++_count;
+            return 0;
+        }
+
+        uint64_t    _count = 0;
+        uint64_t    _sink  = 0;
+};
+
+
+/**
+ * @brief Pushes cfg._items payloads of TSize bytes from `producers` threads
+ *        and measures the time until the worker has popped all of them.
+ */
+template <size_t TSize>
+static void RunThroughput(const BenchConfig &cfg, size_t producers, JsonWriter &json)
+{
+    ThroughputQueue<TSize> que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "bench.throughput");
+
+    size_t perProducer = cfg._items / producers;
+    size_t total       = perProducer * producers;
+
+    TimeFrame tf;
+    std::vector<std::thread> threads;
+    for (size_t idx = 0; idx < producers; ++idx)
+    {
+        threads.emplace_back([&que, perProducer]()
+        {
+            Payload<TSize> data;
+            for (size_t i = 0; i < perProducer; ++i)
+            {
+                data._bytes[0] = uint8_t(i);
+                que.PushBack(data);
+            }
+        });
+    }
+    for (auto &th : threads)
+        th.join();
+    que.Release();
+    tf.Stop();
+
+    double sec = NS_TO_SEC(double(tf.ElapsNs()));
+
+    json.BeginObject()
+        .Field("producers",     uint64_t(producers))
+        .Field("payload_bytes", uint64_t(TSize))
+        .Field("items",         uint64_t(total))
+        .Field("popped",        que._count)
+        .Field("elapsed_ns",    tf.ElapsNs())
+        .Field("items_per_sec", sec > 0 ? total / sec : 0.0)
+        .EndObject();
+}
+
+
+void BenchQueueThroughput(const BenchConfig &cfg, JsonWriter &json)
+{
+    json.Key("queue_throughput").BeginArray();
+    for (size_t producers = 1; producers <= cfg._maxProducers; producers *= 2)
+    {
+        RunThroughput<8>   (cfg, producers, json);
+        RunThroughput<64>  (cfg, producers, json);
+        RunThroughput<256> (cfg, producers, json);
+        RunThroughput<1024>(cfg, producers, json);
+    }
+    json.EndArray();
+}
+
+
+
+/**
+ * @brief 8 byte items from 1..N producers, plain PushBack against WQBatchProducer
+ *        combining buffers of `batch` items (batch 1 is the plain PushBack run).
+ */
+static void RunBatch(const BenchConfig &cfg, size_t producers, size_t batch, JsonWriter &json)
+{
+    ThroughputQueue<8> que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "bench.batch");
+
+    size_t perProducer = cfg._items / producers;
+    size_t total       = perProducer * producers;
+
+    TimeFrame tf;
+    std::vector<std::thread> threads;
+    for (size_t idx = 0; idx < producers; ++idx)
+    {
+        threads.emplace_back([&que, perProducer, batch]()
+        {
+            Payload<8> data;
+            if (batch <= 1)
+            {
+                for (size_t i = 0; i < perProducer; ++i)
+                    que.PushBack(data);
+                return;
+            }
+            WQBatchProducer<ThroughputQueue<8>> producer(que, batch);
+            for (size_t i = 0; i < perProducer; ++i)
+                producer.Push(data);
+        });
+    }
+    for (auto &th : threads)
+        th.join();
+    que.Release();
+    tf.Stop();
+
+    double sec = NS_TO_SEC(double(tf.ElapsNs()));
+
+    json.BeginObject()
+        .Field("producers",     uint64_t(producers))
+        .Field("batch",         uint64_t(batch))
+        .Field("items",         uint64_t(total))
+        .Field("popped",        que._count)
+        .Field("elapsed_ns",    tf.ElapsNs())
+        .Field("items_per_sec", sec > 0 ? total / sec : 0.0)
+        .EndObject();
+}
+
+
+void BenchQueueBatch(const BenchConfig &cfg, JsonWriter &json)
+{
+    json.Key("queue_batch").BeginArray();
+    for (size_t producers = 1; producers <= cfg._maxProducers; producers *= 2)
+        for (size_t batch : {1, 16, 64, 256})
+            RunBatch(cfg, producers, batch, json);
+    json.EndArray();
+}
+
+
+
+
+class LatencyQueue : public WorkQueue<uint64_t, LatencyQueue>
+{
+    public:
+        void Begin()    {}
+        void End()      {}
+
+        int Pop(uint64_t *pData)
+        {
+            _samples.push_back(BenchNowNs() - *pData);
+            return 0;
+        }
+
+        bool CanRunInline(const uint64_t * /*pData*/) const    { return _inline; }
+
+        std::vector<uint64_t> _samples;
+        bool                  _inline = false;
+};
+
+
+static void RunLatency(const BenchConfig &cfg, bool pushOrRun, const char *key, JsonWriter &json)
+{
+    constexpr uint64_t pacingNs = US_TO_NS(20);
+
+    LatencyQueue que;
+    que._samples.reserve(cfg._latencyItems);
+    que._inline = pushOrRun;
+    que.Init(WQ_QUEUE_STATE::WORKING, "bench.latency");
+
+    for (size_t i = 0; i < cfg._latencyItems; ++i)
+    {
+        if (pushOrRun)
+            que.PushOrRun(BenchNowNs());
+        else
+            que.PushBack(BenchNowNs());
+        BenchSpinNs(pacingNs);
+    }
+    que.Release();
+
+    json.Key(key).BeginObject()
+        .Field("pacing_ns", pacingNs)
+        .Field("inlined",   que.Stats()._inlined.load());
+    BenchWriteDistribution(json, que._samples);
+    json.EndObject();
+}
+
+
+/**
+ * @brief End-to-end latency from the push to the start of Pop, PushBack against
+ *        PushOrRun (popped on the producer while the worker is idle).
+ *
+ * Items are paced so that the measurement reflects the hand-off cost
+ * (lock, wake-up, drain) rather than queueing delay under saturation.
+ */
+void BenchQueueLatency(const BenchConfig &cfg, JsonWriter &json)
+{
+    RunLatency(cfg, false, "queue_latency",        json);
+    RunLatency(cfg, true,  "queue_latency_inline", json);
+}
+
+
+
+
+/**
+ * @brief Single producer throughput of 64 byte items, in memory against journaled
+ *        with msync every `syncEvery` records (0 = kernel write-back only).
+ */
+static void RunJournal(const BenchConfig &cfg, uint32_t syncEvery, bool durable, JsonWriter &json)
+{
+    char dir[] = "/tmp/wq_bench_journal_XXXXXX";
+    if (durable && nullptr == mkdtemp(dir))
+        return;
+
+    ThroughputQueue<64> que;
+    WQJournalConfig jcfg;
+    jcfg._syncEvery = syncEvery;
+    if (durable)
+        que.EnableJournal(dir, jcfg);
+    que.Init(WQ_QUEUE_STATE::WORKING, "bench.journal");
+
+    TimeFrame tf;
+    Payload<64> data;
+    size_t accepted = 0;
+    for (size_t i = 0; i < cfg._items; ++i)
+    {
+        data._bytes[0] = uint8_t(i);
+        accepted += (0 != que.PushBack(data)) ? 1 : 0;
+    }
+    que.Release();
+    tf.Stop();
+
+    double sec = NS_TO_SEC(double(tf.ElapsNs()));
+
+    json.BeginObject()
+        .Field("durable",       durable)
+        .Field("sync_every",    uint64_t(syncEvery))
+        .Field("items",         uint64_t(cfg._items))
+        .Field("popped",        que._count)
+        .Field("elapsed_ns",    tf.ElapsNs())
+        .Field("items_per_sec", sec > 0 ? cfg._items / sec : 0.0)
+        .EndObject();
+
+    if (durable)
+    {
+        if (DIR *d = opendir(dir))
+        {
+            while (dirent *entry = readdir(d))
+                if ('.' != entry->d_name[0])
+                    unlink((std::string(dir) + "/" + entry->d_name).c_str());
+            closedir(d);
+        }
+        rmdir(dir);
+    }
+}
+
+
+void BenchQueueJournal(const BenchConfig &cfg, JsonWriter &json)
+{
+    json.Key("queue_journal").BeginArray();
+    RunJournal(cfg, 0,    false, json);
+    RunJournal(cfg, 0,    true,  json);
+    RunJournal(cfg, 4096, true,  json);
+    RunJournal(cfg, 256,  true,  json);
+    json.EndArray();
+}
+
+
+// clang-format on
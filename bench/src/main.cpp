@@ -0,0 +1,106 @@
+
+// clang-format off
+
+
+#include "BenchCommon.h"
+
+#include <WorkQueue.h>
+
+#include <fstream>
+#include <iostream>
+#include <string.h>
+#include <thread>
+
+
+
+
+static void Usage(const char *prog)
+{
+    std::cerr << "Usage: " << prog << " [options]\n"
+              << "  -o <file>        Write the JSON report to <file> instead of stdout\n"
+              << "  -n <items>       Items per throughput run          (default 200000)\n"
+              << "  -l <items>       Samples for the latency run       (default 20000)\n"
+              << "  -p <count>       Max producers for the sweep       (default 8)\n"
+              << "  -w <count>       Max pool workers for the sweep    (default hardware threads)\n"
+              << "  -t <count>       TickThread ticks to sample        (default 1000)\n"
+              << "  -c <count>       Producer threads of the layout run (default 32)\n"
+              << "  -s <name>        Run only section: throughput|batch|latency|journal|scaling|minidx|layout|parallel|jitter|timeframe\n";
+}
+
+
+int main(int argc, const char * argv[])
+{
+    BenchConfig cfg;
+    std::string out;
+    std::string only;
+
+    for (int idx = 1; idx < argc; ++idx)
+    {
+        const char *arg = argv[idx];
+        const char *val = (idx + 1 < argc) ? argv[idx + 1] : nullptr;
+
+        if (nullptr == val || arg[0] != '-' || strlen(arg) != 2)
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+
+        switch (arg[1])
+        {
+            case 'o' : out                  = val;                  break;
+            case 'n' : cfg._items           = std::stoul(val);      break;
+            case 'l' : cfg._latencyItems    = std::stoul(val);      break;
+            case 'p' : cfg._maxProducers    = std::stoul(val);      break;
+            case 'w' : cfg._maxWorkers      = std::stoul(val);      break;
+            case 't' : cfg._tickCount       = std::stoul(val);      break;
+            case 'c' : cfg._layoutProducers = std::stoul(val);      break;
+            case 's' : only                 = val;                  break;
+            default  :
+                Usage(argv[0]);
+                return 1;
+        }
+        ++idx;
+    }
+
+    JsonWriter json;
+    json.BeginObject();
+
+    json.Key("meta").BeginObject()
+        .Field("hardware_threads",  uint64_t(std::thread::hardware_concurrency()))
+        .Field("items",             uint64_t(cfg._items))
+        .Field("timestamp",         TimespecText2(TimeFrame().TimeStamp()))
+        .EndObject();
+
+    if (only.empty() || only == "throughput")   BenchQueueThroughput(cfg, json);
+    if (only.empty() || only == "batch")        BenchQueueBatch     (cfg, json);
+    if (only.empty() || only == "latency")      BenchQueueLatency   (cfg, json);
+    if (only.empty() || only == "journal")      BenchQueueJournal   (cfg, json);
+    if (only.empty() || only == "scaling")      BenchPoolScaling    (cfg, json);
+    if (only.empty() || only == "minidx")       BenchPoolMinIdx     (cfg, json);
+    if (only.empty() || only == "layout")       BenchPoolLayout     (cfg, json);
+    if (only.empty() || only == "parallel")     BenchParallelFor    (cfg, json);
+    if (only.empty() || only == "jitter")       BenchTickJitter     (cfg, json);
+    if (only.empty() || only == "timeframe")    BenchTimeFrame      (cfg, json);
+
+    json.EndObject();
+
+    if (out.empty())
+    {
+        std::cout << json.Str() << std::endl;
+    }
+    else
+    {
+        std::ofstream file(out);
+        if (false == file.is_open())
+        {
+            std::cerr << "ERROR: can not open " << out << std::endl;
+            return 1;
+        }
+        file << json.Str() << std::endl;
+    }
+
+    return 0;
+}
+
+
+// clang-format on
@@ -0,0 +1,49 @@
+
+// clang-format off
+
+
+#ifndef __FUTEX_H__
+#define __FUTEX_H__
+
+#include <atomic>
+#include <climits>
+#include <errno.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdint.h>
+
+
+
+
+/**
+ * @brief Blocks while `word` still holds `expected`.
+ *
+ * Thin wrapper around FUTEX_WAIT. Returns 0 when woken (or when the value had
+ * already changed), -1 with errno ETIMEDOUT / EINTR otherwise. `timeout` is relative.
+ * `shared` selects the process-shared futex, for words living in shared memory.
+ */
+inline int FutexWait(std::atomic<uint32_t> &word, uint32_t expected, const timespec *timeout = nullptr, bool shared = false)
+{
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be a plain 32 bit integer");
+
+    long rc = syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word),
+                      shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, expected, timeout, nullptr, 0);
+    return (rc == -1 && errno != EAGAIN) ? -1 : 0;
+}
+
+
+/**
+ * @brief Wakes up to `count` threads blocked in FutexWait() on `word`.
+ */
+inline int FutexWake(std::atomic<uint32_t> &word, int count = INT_MAX, bool shared = false)
+{
+    return int(syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word),
+                       shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0));
+}
+
+
+#endif // __FUTEX_H__
+
+// clang-format on
@@ -0,0 +1,147 @@
+
+// clang-format off
+
+
+#ifndef __METRICS_REPORTER_H__
+#define __METRICS_REPORTER_H__
+
+#include "WorkQueue.h"
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+
+
+enum class WQ_METRICS_FORMAT
+{
+    PROMETHEUS  = 0,
+    JSON        = 1,
+};
+
+
+
+
+/**
+ * @brief Periodic exporter of WorkQueue / WorkQueuePool metrics.
+ *
+ * Every tick the reporter reads the lock-free WorkQueueStats counters and Size()
+ * of each registered queue, renders them as Prometheus text exposition or JSON,
+ * and publishes the result to a file (written to "<path>.tmp" and renamed) and/or
+ * to every client connecting to a local Unix stream socket. Only the reporter's own
+ * registration lock is taken, producers and consumers are never blocked.
+ *
+ * Queue names are taken from Name(), pool workers are reported as "name:idx".
+ * Latency percentiles cover the window since the previous snapshot.
+ *
+ * Usage example:
+ * @code
+ * MetricsReporter reporter;
+ * reporter.Register(que);
+ * reporter.RegisterPool(pool);
+ * reporter.SetOutputFile("/var/lib/node_exporter/workqueue.prom");
+ * reporter.SetInterval(SEC_TO_NS(5));
+ * reporter.Start();
+ * ...
+ * reporter.Stop();
+ * @endcode
+ */
+class MetricsReporter : public TickThread<MetricsReporter>
+{
+    public:
+        MetricsReporter();
+        ~MetricsReporter();
+
+        template <typename TQueue>
+        void            Register(const TQueue &que);
+        template <typename TPool>
+        void            RegisterPool(const TPool &pool);
+        void            Unregister(const void *owner);
+
+        void            SetFormat(WQ_METRICS_FORMAT fmt);
+        int             SetOutputFile(const std::string &path);
+        int             SetOutputSocket(const std::string &path);
+
+        std::string     Snapshot();
+
+        //From TickThread
+        bool            OnBegin();
+        void            Tick();
+        void            OnEnd();
+
+    private:
+        struct Source
+        {
+            const void                 *_owner  = nullptr;
+            const std::string          *_name   = nullptr;
+            const WorkQueueStats       *_stats  = nullptr;
+            std::function<size_t()>     _size;
+
+            WQHistogramSnapshot         _lastWait;
+            WQHistogramSnapshot         _lastService;
+            WQHistogramSnapshot         _lastRetry;
+            uint64_t                    _lastPopped = 0;
+            uint64_t                    _lastTs     = 0;
+        };
+
+        struct Sample
+        {
+            std::string         _name;
+            size_t              _depth   = 0;
+            uint64_t            _pushed  = 0;
+            uint64_t            _popped  = 0;
+            uint64_t            _dropped = 0;
+            uint64_t            _throttledNs = 0;
+            uint64_t            _expired   = 0;
+            uint64_t            _cancelled = 0;
+            uint64_t            _retried   = 0;
+            uint64_t            _deadLettered = 0;
+            uint64_t            _rehomed   = 0;
+            uint64_t            _inlined   = 0;
+            double              _popRate = 0;
+            WQHistogramSnapshot _wait;          // window
+            WQHistogramSnapshot _service;       // window
+            WQHistogramSnapshot _waitTotal;
+            WQHistogramSnapshot _serviceTotal;
+            WQHistogramSnapshot _retry;         // window
+            WQHistogramSnapshot _retryTotal;
+        };
+
+        void            AddSource(const void *owner, const std::string *name, const WorkQueueStats *stats, std::function<size_t()> size);
+        std::string     RenderPrometheus(const std::vector<Sample> &samples) const;
+        std::string     RenderJson(const std::vector<Sample> &samples) const;
+        void            PublishFile(const std::string &path, const std::string &text);
+        void            PublishSocket(int sockFd, const std::string &text);
+
+        std::mutex              _lock;
+        std::mutex              _publishLock;   // Tick publishing, keeps SetOutputSocket from closing the socket meanwhile
+        std::vector<Source>     _sources;
+        WQ_METRICS_FORMAT       _format     = WQ_METRICS_FORMAT::PROMETHEUS;
+        std::string             _filePath;
+        std::string             _sockPath;
+        int                     _sockFd     = -1;
+};
+
+
+
+
+template <typename TQueue>
+void MetricsReporter::Register(const TQueue &que)
+{
+    AddSource(&que, &que.Name(), &que.Stats(), [&que]() { return que.Size(); });
+}
+
+
+template <typename TPool>
+void MetricsReporter::RegisterPool(const TPool &pool)
+{
+    for (size_t idx = 0; idx < pool.QueCount(); ++idx)
+        AddSource(&pool, &pool.QueName(idx), &pool.QueStats(idx), [&pool, idx]() { return pool.QueSize(idx); });
+}
+
+
+#endif // __METRICS_REPORTER_H__
+
+// clang-format on
@@ -12,6 +12,11 @@
 #include <time.h>
 #include <stdint.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#endif
+
 
 
 // Time Units Conversion Macros
@@ -77,75 +82,143 @@ timespec    TimespecFromNs(double ns);
 timespec    TimespecFromNs(uint64_t ns);  //Required due to double precision failure
 
 
-class TimeFrame
+/**
+ * @brief Clock policy backed by clock_gettime(CLOCK_MONOTONIC). Ticks are nanoseconds.
+ */
+struct ClockMonotonic
 {
-    public:
-        TimeFrame();
-        TimeFrame(const TimeFrame &val) = default;
-        TimeFrame(TimeFrame &&val)      = default;
-        ~TimeFrame();
+    static uint64_t     Now()                       { timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts); return TimespecToNs(ts); }
+    static int64_t      ToNs(int64_t ticks)         { return ticks;             }
+    static uint64_t     FromMonotonic(uint64_t ns)  { return ns;                }
+    static timespec     ToRealtime(uint64_t ticks);
+};
 
-        TimeFrame &operator = (const TimeFrame &val) = default;
-        TimeFrame &operator = (TimeFrame &&val)      = default;
 
-        bool        operator <  (const TimeFrame& lhs) const  { return TimeFrame::TimeSpecCmp(Elaps(), lhs.Elaps()) < 0;   }
-        bool        operator >  (const TimeFrame& lhs) const  { return TimeFrame::TimeSpecCmp(Elaps(), lhs.Elaps()) > 0;   }
-        bool        operator == (const TimeFrame& lhs) const  { return TimeFrame::TimeSpecCmp(Elaps(), lhs.Elaps()) == 0;  }
+/**
+ * @brief Clock policy backed by the invariant time stamp counter (rdtsc).
+ *
+ * Reading the counter costs a few nanoseconds against ~20ns for a vDSO
+ * clock_gettime. The tick rate is calibrated once against CLOCK_MONOTONIC,
+ * lazily on the first conversion or explicitly through Calibrate(). When the
+ * CPU does not advertise an invariant TSC (or is not x86) the policy falls
+ * back to CLOCK_MONOTONIC and ticks are plain nanoseconds.
+ */
+struct ClockTsc
+{
+    struct Calibration
+    {
+        bool        _tsc        = false;    // rdtsc in use
+        double      _nsPerTick  = 1.0;
+        uint64_t    _tickBase   = 0;        // counter value at _monoBase
+        uint64_t    _monoBase   = 0;        // CLOCK_MONOTONIC ns
+    };
+
+    static uint64_t             Now();
+    static int64_t              ToNs(int64_t ticks)     { return int64_t(ticks * Calibrate()._nsPerTick); }
+    static uint64_t             FromMonotonic(uint64_t ns);
+    static timespec             ToRealtime(uint64_t ticks);
+
+    static bool                 Available();
+    static const Calibration &  Calibrate();
+};
+
 
+inline uint64_t ClockTsc::Now()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool s_tsc = Available();
+    if (s_tsc)
+        return __rdtsc();
+#endif
+    return ClockMonotonic::Now();
+}
 
-        int         Start();
-        int         Stop();
-        void        Reset()                     { Start(); Stop();                                          }
-        void        Step(const timespec &ts)    { _start = _stop; _stop = ts;                                   }
-        void        Step()                      { timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts); Step(ts);   }
 
 
-        timespec    TimeStamp() const;
-        timespec    Elaps() const;
-        int64_t     ElapsNs() const;
 
-        std::string ElapsText() const;
+/**
+ * @brief Timestamp-free helpers shared by every TimeFrameT instantiation.
+ */
+class TimeFrameBase
+{
+    public:
         static std::string TimeStampText(const timespec &ts);
 
-
         static timespec TimeSpecDif (const timespec &t1, const timespec &t2);
         static timespec TimeSpecAdd (const timespec &t1, const timespec &t2);
         static timespec TimeSpecDiv (const timespec &t1, double val);
         static int      TimeSpecCmp (const timespec &t1, const timespec &t2);
+};
+
+
+/**
+ * @brief Elapsed time measurement parameterized by a clock policy.
+ *
+ * Start/Stop/Step only read TClock (a single clock read each); the wall clock
+ * timestamp of the frame start is derived on demand by TimeStamp().
+ *
+ * @tparam TClock ClockMonotonic (default) or ClockTsc
+ */
+template <typename TClock = ClockMonotonic>
+class TimeFrameT : public TimeFrameBase
+{
+    public:
+        TimeFrameT()                                    { Start();      }
+
+        bool        operator <  (const TimeFrameT& lhs) const   { return ElapsNs() <  lhs.ElapsNs();    }
+        bool        operator >  (const TimeFrameT& lhs) const   { return ElapsNs() >  lhs.ElapsNs();    }
+        bool        operator == (const TimeFrameT& lhs) const   { return ElapsNs() == lhs.ElapsNs();    }
+
+
+        int         Start()                     { _start = _stop = TClock::Now(); return 0;                     }
+        int         Stop()                      { _stop  = TClock::Now(); return 0;                             }
+        void        Reset()                     { Start();                                                      }
+        void        Step(const timespec &ts)    { _start = _stop; _stop = TClock::FromMonotonic(TimespecToNs(ts)); }
+        void        Step()                      { _start = _stop; _stop = TClock::Now();                        }
+
+
+        timespec    TimeStamp() const           { return TClock::ToRealtime(_start);                            }
+        timespec    Elaps() const               { return TimespecFromNs(uint64_t(std::max<int64_t>(ElapsNs(), 0))); }
+        int64_t     ElapsNs() const             { return TClock::ToNs(int64_t(_stop - _start));                 }
+
+        std::string ElapsText() const           { return TimespecText(Elaps());                                 }
 
     private :
-        timespec    _start {};
-        timespec    _stop {};
-        timespec    _ts {};
+        uint64_t    _start = 0;
+        uint64_t    _stop  = 0;
 };
 
 
+using TimeFrame     = TimeFrameT<ClockMonotonic>;
+using TimeFrameTsc  = TimeFrameT<ClockTsc>;
 
-inline bool     operator <  (const timespec& lhs, const timespec& rhs)  { return TimeFrame::TimeSpecCmp(lhs, rhs) < 0;      }
-inline bool     operator >  (const timespec& lhs, const timespec& rhs)  { return TimeFrame::TimeSpecCmp(lhs, rhs) > 0;      }
-inline bool     operator == (const timespec& lhs, const timespec& rhs)  { return TimeFrame::TimeSpecCmp(lhs, rhs) == 0;     }
-inline bool     operator >= (const timespec& lhs, const timespec& rhs)  { int cmp = TimeFrame::TimeSpecCmp(lhs, rhs); return (cmp == 0) || (cmp > 0); }
-inline bool     operator <= (const timespec& lhs, const timespec& rhs)  { int cmp = TimeFrame::TimeSpecCmp(lhs, rhs); return (cmp == 0) || (cmp < 0); }
 
-inline timespec operator -  (const timespec& lhs, const timespec& rhs)  { return TimeFrame::TimeSpecDif(lhs, rhs);          }
-inline timespec operator +  (const timespec& lhs, const timespec& rhs)  { return TimeFrame::TimeSpecAdd(lhs, rhs);          }
-inline timespec operator /  (const timespec& lhs, double val)           { return TimeFrame::TimeSpecDiv(lhs, val);          }
+
+inline bool     operator <  (const timespec& lhs, const timespec& rhs)  { return TimeFrameBase::TimeSpecCmp(lhs, rhs) < 0;      }
+inline bool     operator >  (const timespec& lhs, const timespec& rhs)  { return TimeFrameBase::TimeSpecCmp(lhs, rhs) > 0;      }
+inline bool     operator == (const timespec& lhs, const timespec& rhs)  { return TimeFrameBase::TimeSpecCmp(lhs, rhs) == 0;     }
+inline bool     operator >= (const timespec& lhs, const timespec& rhs)  { int cmp = TimeFrameBase::TimeSpecCmp(lhs, rhs); return (cmp == 0) || (cmp > 0); }
+inline bool     operator <= (const timespec& lhs, const timespec& rhs)  { int cmp = TimeFrameBase::TimeSpecCmp(lhs, rhs); return (cmp == 0) || (cmp < 0); }
+
+inline timespec operator -  (const timespec& lhs, const timespec& rhs)  { return TimeFrameBase::TimeSpecDif(lhs, rhs);          }
+inline timespec operator +  (const timespec& lhs, const timespec& rhs)  { return TimeFrameBase::TimeSpecAdd(lhs, rhs);          }
+inline timespec operator /  (const timespec& lhs, double val)           { return TimeFrameBase::TimeSpecDiv(lhs, val);          }
 inline timespec operator *  (const timespec& lhs, double val)           { return { time_t(lhs.tv_sec * val), long(lhs.tv_nsec * val) };         }
 
-inline timespec operator -= (timespec& lhs,       const timespec& rhs)  { return lhs = TimeFrame::TimeSpecDif(lhs, rhs);    }
-inline timespec operator += (timespec& lhs,       const timespec& rhs)  { return lhs = TimeFrame::TimeSpecAdd(lhs, rhs);    }
-inline timespec operator /= (timespec& lhs,       double val)           { return lhs = TimeFrame::TimeSpecDiv(lhs, val);    }
+inline timespec operator -= (timespec& lhs,       const timespec& rhs)  { return lhs = TimeFrameBase::TimeSpecDif(lhs, rhs);    }
+inline timespec operator += (timespec& lhs,       const timespec& rhs)  { return lhs = TimeFrameBase::TimeSpecAdd(lhs, rhs);    }
+inline timespec operator /= (timespec& lhs,       double val)           { return lhs = TimeFrameBase::TimeSpecDiv(lhs, val);    }
 inline timespec operator *= (timespec& lhs,       double val)           { return lhs = { time_t(lhs.tv_sec * val), long(lhs.tv_nsec * val) };   }
 
 
 
 
 
-template <int TryCOUNT>
+template <int TryCOUNT, typename TClock = ClockMonotonic>
 struct MeasureCollection
 {
     std::string _name;
-    std::array<TimeFrame, TryCOUNT> _data;
+    std::array<TimeFrameT<TClock>, TryCOUNT> _data;
     //timespec    _mean {};
 
     std::string BenchmarkText();
@@ -158,9 +231,9 @@ struct MeasureCollection
     timespec    Median();
     void        MinMax(timespec &min, timespec &max);
 
-    std::array<TimeFrame, TryCOUNT> SortData() const
+    std::array<TimeFrameT<TClock>, TryCOUNT> SortData() const
     {
-        std::array<TimeFrame, TryCOUNT> dataSorted = _data;
+        std::array<TimeFrameT<TClock>, TryCOUNT> dataSorted = _data;
         //TODO: Research for a high perf sorting alorithm
         std::sort(dataSorted.begin(), dataSorted.end()/*, TimeFrame::TimeSpecCmp*/);
         return dataSorted;
@@ -168,8 +241,8 @@ struct MeasureCollection
 };
 
 
-template <int TryCOUNT>
-std::string MeasureCollection<TryCOUNT>::BenchmarkTextBrief()
+template <int TryCOUNT, typename TClock>
+std::string MeasureCollection<TryCOUNT, TClock>::BenchmarkTextBrief()
 {
     std::ostringstream ss;
     BenchmarkTextBrief(ss);
@@ -177,8 +250,8 @@ std::string MeasureCollection<TryCOUNT>::BenchmarkTextBrief()
 }
 
 
-template <int TryCOUNT>
-void MeasureCollection<TryCOUNT>::BenchmarkTextBrief(std::ostringstream &ss)
+template <int TryCOUNT, typename TClock>
+void MeasureCollection<TryCOUNT, TClock>::BenchmarkTextBrief(std::ostringstream &ss)
 {
     timespec min, max;
     MinMax(min, max);
@@ -192,8 +265,8 @@ void MeasureCollection<TryCOUNT>::BenchmarkTextBrief(std::ostringstream &ss)
 }
 
 
-template <int TryCOUNT>
-std::string MeasureCollection<TryCOUNT>::BenchmarkText()
+template <int TryCOUNT, typename TClock>
+std::string MeasureCollection<TryCOUNT, TClock>::BenchmarkText()
 {
     std::ostringstream ss;
 
@@ -204,8 +277,8 @@ std::string MeasureCollection<TryCOUNT>::BenchmarkText()
 }
 
 
-template <int TryCOUNT>
-std::string MeasureCollection<TryCOUNT>::BenchmarkTextData()
+template <int TryCOUNT, typename TClock>
+std::string MeasureCollection<TryCOUNT, TClock>::BenchmarkTextData()
 {
     std::ostringstream ss;
     BenchmarkTextData(ss);
@@ -213,20 +286,20 @@ std::string MeasureCollection<TryCOUNT>::BenchmarkTextData()
 }
 
 
-template <int TryCOUNT>
-void MeasureCollection<TryCOUNT>::BenchmarkTextData(std::ostringstream &ss)
+template <int TryCOUNT, typename TClock>
+void MeasureCollection<TryCOUNT, TClock>::BenchmarkTextData(std::ostringstream &ss)
 {
     for(int tryIdx = 0; tryIdx < TryCOUNT; ++tryIdx)
     {
-        ss  << _data[tryIdx].TimeStampText() << " - "
+        ss  << TimeFrameBase::TimeStampText(_data[tryIdx].TimeStamp()) << " - "
             << "Proc: " << std::setw(16) << _data[tryIdx].ElapsText() << " "
             << std::endl;
     }
 }
 
 
-template <int TryCOUNT>
-timespec MeasureCollection<TryCOUNT>::Mean()
+template <int TryCOUNT, typename TClock>
+timespec MeasureCollection<TryCOUNT, TClock>::Mean()
 {
     timespec mean {};
     for (auto &item : _data)
@@ -239,8 +312,8 @@ timespec MeasureCollection<TryCOUNT>::Mean()
 }
 
 
-template <int TryCOUNT>
-timespec MeasureCollection<TryCOUNT>::Median()
+template <int TryCOUNT, typename TClock>
+timespec MeasureCollection<TryCOUNT, TClock>::Median()
 {
     timespec res {};
     auto s = SortData();
@@ -261,8 +334,8 @@ timespec MeasureCollection<TryCOUNT>::Median()
 }
 
 
-template <int TryCOUNT>
-void MeasureCollection<TryCOUNT>::MinMax(timespec &min, timespec &max)
+template <int TryCOUNT, typename TClock>
+void MeasureCollection<TryCOUNT, TClock>::MinMax(timespec &min, timespec &max)
 {
     min.tv_sec  = INT_MAX;
     min.tv_nsec = LONG_MAX;
@@ -286,51 +359,4 @@ void MeasureCollection<TryCOUNT>::MinMax(timespec &min, timespec &max)
 
 
 
-inline
-TimeFrame::TimeFrame()
-{
-    Start();
-}
-
-/*
-inline
-TimeFrame::TimeFrame(const TimeFrame &val)
-    : _start(val._start)
-    , _stop(val._stop)
-{
-}
-*/
-
-inline
-TimeFrame::~TimeFrame()
-{
-    Stop();
-}
-
-inline
-int TimeFrame::Start()
-{
-    clock_gettime(CLOCK_REALTIME, &_ts);
-    if (clock_gettime(CLOCK_MONOTONIC, &_start) == -1)
-        return -1;
-    _stop = _start;
-    return 0;
-}
-
-inline
-int TimeFrame::Stop()
-{
-    if (clock_gettime(CLOCK_MONOTONIC, &_stop) == -1)
-        return -1;
-    return 0;
-}
-
-inline
-timespec TimeFrame::TimeStamp() const
-{
-    return _ts;
-}
-
-
-
 #endif  /* __TIME_FRAME_H__ */
@@ -5,7 +5,21 @@
 #ifndef __WORK_QUEUE_H__
 #define __WORK_QUEUE_H__
 
+#include "Futex.h"
 #include "TimeFrame.h"
+#include "WorkQueueBarrier.h"
+#include "WorkQueueCoro.h"
+#include "WorkQueueExpiry.h"
+#include "WorkQueueProbe.h"
+#include "WorkQueueFuture.h"
+#include "WorkQueueJournal.h"
+#include "WorkQueueParallel.h"
+#include "WorkQueuePolicy.h"
+#include "WorkQueueRate.h"
+#include "WorkQueueRetry.h"
+#include "WorkQueueStats.h"
+#include "WorkQueueTrace.h"
+#include "WorkQueueTuning.h"
 
 #include <thread>
 #include <sstream>
@@ -16,8 +30,16 @@
 #include <deque>
 #include <list>
 #include <vector>
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
 #include <stdint.h>
+#include <string.h>
 
 
 
@@ -106,6 +128,11 @@ void Thread<T>::USleep(uint32_t ns)
  * };
  * @endcode
  *
+ * One-shot timers can be attached with AddTimer(), or awaited from a coroutine
+ * with co_await ticker.After(ns). They fire on the tick thread right after
+ * Tick(), so their resolution is the tick interval. Timers still pending when
+ * the thread stops are fired with cancelled = true.
+ *
  * @tparam T The derived class type (CRTP pattern)
  */
 template <typename T>
@@ -121,10 +148,24 @@ class TickThread : public Thread<TickThread<T>>
 
         bool        DoQuit()        { return _quit; }
 
+        int         AddTimer(uint64_t ns, WQCallFn fn, void *ctx);
+        WQTimerAwaiter<TickThread<T>>   After(uint64_t ns)  { return {this, ns}; }
+
 //    protected:
         void        Run();
 
     private:
+        struct Timer
+        {
+            uint64_t    _due;       // ClockMonotonic::Now() deadline
+            WQCallFn    _call;
+            void       *_ctx;
+
+            bool operator>(const Timer &other) const    { return _due > other._due; }
+        };
+
+        void        FireTimers(bool cancel);
+
         uint64_t                    _interval {1000};
 //        std::condition_variable     _cv;
 //        std::mutex                  _mtx;
@@ -132,6 +173,12 @@ class TickThread : public Thread<TickThread<T>>
 
         std::atomic<uint64_t>       _tickCount  {0};
         TimeFrame                   _tickTs     {};
+
+        std::mutex                  _timerLock;
+        std::vector<Timer>          _timers;            // min-heap on _due
+        std::vector<Timer>          _timersDue;         // tick thread only
+        std::atomic_size_t          _timerCount {0};
+        bool                        _timerClosed = false;
 };
 
 
@@ -157,6 +204,44 @@ void TickThread<T>::Stop()
 }
 
 
+template <typename T>
+int TickThread<T>::AddTimer(uint64_t ns, WQCallFn fn, void *ctx)
+{
+    std::lock_guard<std::mutex> lock(_timerLock);
+    if (_timerClosed || DoQuit())
+        return -1;
+
+    _timers.push_back(Timer{ClockMonotonic::Now() + ns, fn, ctx});
+    std::push_heap(_timers.begin(), _timers.end(), std::greater<Timer>());
+    ++_timerCount;
+    return 0;
+}
+
+
+template <typename T>
+void TickThread<T>::FireTimers(bool cancel)
+{
+    {
+        std::lock_guard<std::mutex> lock(_timerLock);
+        uint64_t now = ClockMonotonic::Now();
+        while (false == _timers.empty() && (cancel || _timers.front()._due <= now))
+        {
+            std::pop_heap(_timers.begin(), _timers.end(), std::greater<Timer>());
+            _timersDue.push_back(_timers.back());
+            _timers.pop_back();
+        }
+        _timerCount = _timers.size();
+        if (cancel)
+            _timerClosed = true;
+    }
+
+    //Callbacks run unlocked, they may add new timers
+    for (auto &timer : _timersDue)
+        timer._call(timer._ctx, cancel);
+    _timersDue.clear();
+}
+
+
 template <typename T>
 void TickThread<T>::Run()
 {
@@ -164,7 +249,10 @@ void TickThread<T>::Run()
     _tickTs.Reset();
 
     if (false == static_cast<T *>(this)->OnBegin())
+    {
+        FireTimers(true);
         return;
+    }
 
 //    std::unique_lock<std::mutex> lock(_mtx);
 //    while (!_cv.wait_for(lock, _interval, [this]{return _quit.load();}))
@@ -179,13 +267,29 @@ void TickThread<T>::Run()
     {
         _tickTs.Step();
         ++_tickCount;
+        WQ_PROBE2(tick, this, _tickCount.load());
 
-        static_cast<T *>(this)->Tick();
+        //Timed only while a tracer is attached to tick_overrun
+        if (WQ_PROBE_ENABLED(tick_overrun))
+        {
+            uint64_t tsTick = ClockMonotonic::Now();
+            static_cast<T *>(this)->Tick();
+            uint64_t tickNs = ClockMonotonic::Now() - tsTick;
+            if (tickNs > _interval)
+                WQ_PROBE4(tick_overrun, this, _tickCount.load(), tickNs, _interval);
+        }
+        else
+        {
+            static_cast<T *>(this)->Tick();
+        }
+        if (_timerCount > 0)
+            FireTimers(false);
 
         if ((false == DoQuit()) && _interval > 0)
             this->USleep(_interval);
     }
 
+    FireTimers(true);
     static_cast<T *>(this)->OnEnd();
 }
 
@@ -197,25 +301,6 @@ void TickThread<T>::Run()
 
 
 
-/**
- * @brief
- *
- */
-
-enum class WQ_QUEUE_STATE
-{
-    NA              = 0,
-    WORKING         = 1,
-    PAUSE           = 2,
-    EXITING_WAIT    = 3,
-    EXITING_FORCE   = 4,
-};
-
-std::string WQ_QUEUE_STATE_text(WQ_QUEUE_STATE value);
-
-
-
-
 /**
  * @brief A thread-safe work queue implementation using the CRTP (Curiously Recurring Template Pattern).
  *
@@ -226,6 +311,33 @@ std::string WQ_QUEUE_STATE_text(WQ_QUEUE_STATE value);
  * The worker queue manages a collection of data items and processes them in a background thread.
  * It supports various states including WORKING, PAUSE, EXITING_WAIT, and EXITING_FORCE.
  *
+ * Items pushed with a WQItemLimit (PushExpiring) carry a deadline and/or a
+ * WQCancelToken. The Listener checks them right before dispatch and discards a
+ * stale item instead of calling Pop(), after handing it to OnExpired(). The base
+ * OnExpired() does nothing, the derived class may hide it.
+ *
+ * With a WQRetryPolicy set, a non-zero int returned by Pop() moves the item to a
+ * retry lane owned by the worker: it is popped again after an exponential backoff
+ * while the worker goes on with the next items. After the last attempt the item
+ * goes to OnDeadLetter() (a no-op unless hidden), which may forward it to another
+ * queue acting as dead-letter queue.
+ *
+ * Besides data items the queue carries plain callbacks (PushCall), which the
+ * Listener runs in place of Pop(). Schedule() builds on them so a coroutine can
+ * hop onto the worker thread with co_await que.Schedule().
+ *
+ * PushOrRun() skips the hand-off for items the derived class lets run on any
+ * thread (CanRunInline): an idle queue pops them right on the caller, a full one
+ * makes the caller pop the pending items first. One thread at a time owns Pop(),
+ * so ordering holds; items that need the worker's Begin() state simply stay off
+ * the fast path.
+ *
+ * The container, queue lock, Listener wake-up, drain buffer and state storage
+ * come from TPolicy (see WQPolicy), so a single producer latency critical queue
+ * or a bounded one only compiles the machinery it uses. The optional features
+ * (journal, rate limit, retries, conflation, batch tuning, deadlines, callbacks)
+ * follow TPolicy::Features: one left out takes no space in the queue or its items.
+ *
  * Usage example:
  * @code
  * class MyWorker : public WorkQueue<MyData, MyWorker> {
@@ -241,18 +353,50 @@ std::string WQ_QUEUE_STATE_text(WQ_QUEUE_STATE value);
  *     void Pop(MyData* data) {
  *         // Process the data item
  *     }
+ *
+ *     void OnExpired(MyData* data, WQ_EXPIRE_REASON reason) {
+ *         // Optional, a PushExpiring item that was not popped
+ *     }
+ *
+ *     void OnDeadLetter(MyData* data, int rc, uint32_t attempts) {
+ *         // Optional, Pop kept failing (int Pop and SetRetryPolicy only)
+ *     }
+ *
+ *     bool CanRunInline(const MyData* data) const {
+ *         // Optional, true if PushOrRun may Pop this item on the pushing thread
+ *     }
  * };
  * @endcode
  *
  * @tparam TData The type of data items to be processed
  * @tparam TDerived The derived class type (CRTP pattern)
+ * @tparam TPolicy WQPolicy bundle, WQDefaultPolicy keeps deque + mutex + condition_variable + list
  */
 
 
-template <typename TData, typename TDerived>
-class WorkQueue : public Thread<WorkQueue<TData, TDerived>>
+template <typename TData, typename TDerived, typename TPolicy = WQDefaultPolicy>
+class WorkQueue : public Thread<WorkQueue<TData, TDerived, TPolicy>>
 {
+    using TLock = typename TPolicy::Lock;
+
+    static_assert(TPolicy::Wake::template Supports<TLock>(),
+                  "WorkQueue policy: this Wake policy can not wait on this Lock policy (WQCondWake needs std::mutex, use WQCondAnyWake)");
+
+    //Optional machinery of TPolicy::Features, see WQ_FEATURE
+    static constexpr bool HAS_JOURNAL  = 0 != (TPolicy::Features & WQ_FEATURE_JOURNAL);
+    static constexpr bool HAS_RATE     = 0 != (TPolicy::Features & WQ_FEATURE_RATE);
+    static constexpr bool HAS_RETRY    = 0 != (TPolicy::Features & WQ_FEATURE_RETRY);
+    static constexpr bool HAS_CONFLATE = 0 != (TPolicy::Features & WQ_FEATURE_CONFLATE);
+    static constexpr bool HAS_TUNING   = 0 != (TPolicy::Features & WQ_FEATURE_TUNING);
+    static constexpr bool HAS_EXPIRY   = 0 != (TPolicy::Features & WQ_FEATURE_EXPIRY);
+    static constexpr bool HAS_CALL     = 0 != (TPolicy::Features & WQ_FEATURE_CALL);
+
+    template <uint32_t TFeature, typename T>
+    using Field = WQField<TPolicy::Features, TFeature, T>;
+
  public:
+    using Data = TData;
+
     virtual ~WorkQueue();
 /*
     enum class QUEUE_STATE
@@ -266,10 +410,43 @@ class WorkQueue : public Thread<WorkQueue<TData, TDerived>>
 
     int                 Init(WQ_QUEUE_STATE state, const std::string &name = "");
 
+    //Init without a worker thread: the caller's own event loop consumes the queue with TryDrain(),
+    //with WQEventFdWake whenever EventFd() is readable (see WQReactor). Begin() runs here and End()
+    //in Release(), which drains or drops what is left on the calling thread. Needs a policy without
+    //WQ_FEATURE_RATE and WQ_FEATURE_RETRY, the event loop must not sleep for tokens or backoffs
+    int                 InitExternal(WQ_QUEUE_STATE state, const std::string &name = "");
+    //Runs up to maxItems pending items on the calling thread and returns their count; never blocks
+    //on an empty queue. Resets EventFd() when nothing is left or the queue does not drain (PAUSE).
+    //InitExternal queues only, always from the same thread
+    size_t              TryDrain(size_t maxItems = SIZE_MAX);
+    //WQEventFdWake readiness fd: readable while items are pending, owned by the queue
+    template <typename TW = typename TPolicy::Wake>
+    int                 EventFd() const;
+
+    //Durable mode for trivially copyable TData, call before Init. Data items are appended to a
+    //WQJournal in dir and acknowledged after Pop; Init queues the items a previous run left behind
+    int                 EnableJournal(const std::string &dir, const WQJournalConfig &cfg = WQJournalConfig());
+
+    //Paces the worker with a token bucket, one token per Pop or per drained batch. The Listener
+    //takes its tokens before it drains and only as many items as it got tokens for, so a paced
+    //backlog stays queued (Size, PushFresh, PushConflate see it); a drained item that turns out
+    //stale has spent its token. The waits show in Stats()._throttledNs. A bucket may be shared by
+    //several queues; call before Init
+    int                 SetRateLimit(std::shared_ptr<WQTokenBucket> bucket, WQ_RATE_UNIT unit = WQ_RATE_UNIT::ITEM);
+    int                 SetRateLimit(double ratePerSec, double burst = 1.0, WQ_RATE_UNIT unit = WQ_RATE_UNIT::ITEM);
+
+    //Retries data items whose int Pop() failed, see WQRetryPolicy; call before Init
+    int                 SetRetryPolicy(const WQRetryPolicy &policy);
+
+    //Lets the Listener cap its batches and linger for underfilled ones, tuned against a latency SLO
+    //from the queue's own measurements (see WQBatchTuner); call before Init
+    int                 SetBatchTuning(const WQBatchTuning &tuning);
+    const WQBatchTuner& BatchTuner() const;
+
     void                SetState(WQ_QUEUE_STATE stat);
     WQ_QUEUE_STATE      GetState() const;
     void                SetWaitTime(const timespec &tmsp);
-    const timespec &    GetWaitTime();
+    timespec            GetWaitTime() const;
 
     size_t              Size() const ;
 
@@ -283,187 +460,1296 @@ class WorkQueue : public Thread<WorkQueue<TData, TDerived>>
     size_t              PushFresh(TData &&data);
     size_t              PushFresh(const TData &data);
 
-    void*               Listener();
-    void                Release(bool bForce = false);
+    //PushBack of [first, last) under one lock acquisition and one wake-up, in order. Returns the
+    //count accepted, the rest is dropped (queue not WORKING, bounded container full, journal full)
+    template <typename TIter>
+    size_t              PushRange(TIter first, TIter last);
+
+    //PushFresh per key: replaces the value of a still pending item with the same key, which keeps
+    //its place in the queue (the old value counts as dropped), or pushes back a new one
+    size_t              PushConflate(uint64_t key, TData &&data);
+    size_t              PushConflate(uint64_t key, const TData &data);
+
+    //Item that is discarded before Pop once limit._deadlineNs passed or limit._token is cancelled
+    size_t              PushExpiring(TData &&data, const WQItemLimit &limit, WQ_PUSH_OP op = WQ_PUSH_OP::BACK);
+    size_t              PushExpiring(const TData &data, const WQItemLimit &limit, WQ_PUSH_OP op = WQ_PUSH_OP::BACK);
+
+    //Pops data on the calling thread instead of queueing it while the queue is idle (nothing pending,
+    //worker between batches). On a full bounded container the caller waits out the worker's batch and
+    //pops the pending items ahead of its own instead (caller-runs). Either way Pop() never runs on two
+    //threads at once and the queue order holds. Items CanRunInline refuses, and all items of a queue
+    //with a rate limit, a retry policy or InitExternal, are pushed back. 1 popped here, 0 queued, -1 dropped
+    int                 PushOrRun(TData &&data);
+    int                 PushOrRun(const TData &data);
+
+    //Default hook for PushOrRun: no item may run off the worker thread (Pop may rely on Begin()
+    //thread state), hidden by TDerived::CanRunInline
+    bool                CanRunInline(const TData * /*data*/) const  { return false; }
+    //Default hook for discarded PushExpiring items, hidden by TDerived::OnExpired
+    void                OnExpired(TData * /*data*/, WQ_EXPIRE_REASON /*reason*/)  {}
+    //Default hook for items that failed every retry, hidden by TDerived::OnDeadLetter
+    void                OnDeadLetter(TData * /*data*/, int /*rc*/, uint32_t /*attempts*/) {}
+
+    //Result type of TDerived::Pop, delivered through WQFuture by Submit
+    template <typename TD = TDerived>
+    using PopResult = decltype(std::declval<TD&>().Pop(std::declval<TData*>()));
+
+    //Pushes data with a result slot from WQFutureSlab. With every slot in use the data is not queued:
+    //the future is invalid (Valid() false) and the push counts in Stats()._dropped
+    template <typename TD = TDerived>
+    WQFuture<PopResult<TD>> Submit(const TData &data, WQ_PUSH_OP op = WQ_PUSH_OP::BACK);
+
+    //Runs fn(ctx, false) on the worker thread instead of Pop(), or fn(ctx, true) if the
+    //item is dropped later on. Returns -1 without calling fn when the queue is not WORKING
+    int                 PushCall(WQCallFn fn, void *ctx, WQ_PUSH_OP op = WQ_PUSH_OP::BACK);
+    WQScheduleAwaiter<WorkQueue> Schedule(WQ_PUSH_OP op = WQ_PUSH_OP::BACK)    { return {this, op}; }
+
+    void*               Listener();
+    void                Release(bool bForce = false);
+    //Drains like Release(), forces the exit once timeout passed. 0 if everything drained, -1 if forced
+    int                 Release(const timespec &timeout);
+
+    //Barrier on the items pushed before the call: 0 once each of them completed Pop (or was dropped),
+    //-1 if timeoutNs passed first. Items pushed later, PushFront ones included, neither satisfy nor
+    //extend it (see WQBarrier). Never call it from Pop, the worker would wait for itself
+    int                 WaitIdle(uint64_t timeoutNs = UINT64_MAX);
+    void                Flush()                     { WaitIdle(); }
+    uint64_t            Completed() const           { return _completed.load(std::memory_order_acquire); }
+
+    //Counts this queue's items as shard `shard` of barrier, whose Wait() then covers them wherever
+    //they complete. Call before Init; WorkQueuePool shares one barrier between its workers
+    using Barrier = WQBarrier<TPolicy::Align>;
+    void                ShareBarrier(Barrier *barrier, size_t shard)  { _barrier = barrier; _barrierShard = shard; }
+
+    //How long the current Pop() has been running, 0 between items. Lock-free and approximate,
+    //the worker pays one relaxed store per item for it (see WQWatchdog)
+    uint64_t            PopRunningNs() const;
+    //Hands the pending data items to the `count` queues in targets, oldest first in even slices, each
+    //slice at the drain end of its target. Callbacks, conflated keys and journaled items stay here.
+    //Returns the count moved, counted as _rehomed here (see WorkQueuePool::Rehome). The targets must
+    //share this queue's barrier, so WaitIdle keeps covering the items until they complete there
+    size_t              MovePending(WorkQueue *const *targets, size_t count);
+
+    const std::string&  Name() const;
+    const WorkQueueStats& Stats() const;
+    //Bytes a queued item takes in the container (a WQRingContainer slot), TData plus the fields of TPolicy::Features
+    static constexpr size_t ItemSize()          { return sizeof(QueItem); }
+
+ private:
+
+    //Fields of a feature TPolicy leaves out are empty WQNoField stand-ins that read as 0 (see WQField)
+    struct QueItem
+    {
+        TData       _data;
+        uint64_t    _tsPush;    // WQClock::Now() at push time
+        uint64_t    _traceId;   // WQTrace item id, 0 if not sampled
+        [[no_unique_address]] Field<WQ_FEATURE_CALL, void *>           _ctx;       // _call argument, or WQFutureState<PopResult<>> of Submit, or nullptr
+        [[no_unique_address]] Field<WQ_FEATURE_CALL, WQCallFn>         _call;      // PushCall callback, nullptr for data items
+        [[no_unique_address]] Field<WQ_FEATURE_JOURNAL, uint64_t>      _journalSeq;// WQJournal record to acknowledge, 0 if not journaled
+        std::atomic<uint64_t> *_left;   // WQBarrier counter the item leaves through once it completed
+        [[no_unique_address]] Field<WQ_FEATURE_CONFLATE, uint64_t>     _key   = 0; // PushConflate key, indexed in _conflateIndex while queued
+        [[no_unique_address]] Field<WQ_FEATURE_CONFLATE, bool>         _keyed = false;
+        [[no_unique_address]] Field<WQ_FEATURE_RETRY, uint32_t>        _attempts = 0;  // failed Pop() calls, see WQRetryPolicy
+        [[no_unique_address]] Field<WQ_FEATURE_EXPIRY, uint64_t>       _deadline = 0;  // WQClock::Now() ticks, 0 never expires
+        [[no_unique_address]] Field<WQ_FEATURE_EXPIRY, WQCancelToken>  _token;
+    };
+
+    struct RetryItem
+    {
+        uint64_t    _dueNs;         // WQNowNs() time of the next attempt
+        QueItem     _item;
+
+        bool operator>(const RetryItem &other) const    { return _dueNs > other._dueNs; }
+    };
+
+    using TContainer = typename TPolicy::template Container<QueItem>;
+    using TDrain     = typename TPolicy::template Drain<QueItem>;
+
+    struct PushRequest;
+
+    template <typename TArg>
+    bool                        PushItem(WQ_PUSH_OP op, TArg &&data, void *ctx, WQCallFn call, uint64_t key = 0, const WQItemLimit *limit = nullptr);
+    template <typename TArg>
+    void                        ApplyPush(TArg &&data, PushRequest &req);
+    template <typename TArg>
+    int                         RunOrPush(TArg &&data);
+    int                         Dispatch(QueItem &item);
+    bool                        Retry(QueItem &item, int rc);
+    bool                        RetryPending() const;
+    void                        JournalAck(uint64_t seq);
+    WQ_EXPIRE_REASON            Staleness(const QueItem &item, uint64_t tsNow) const;
+    void                        Expire(QueItem &item, WQ_EXPIRE_REASON reason);
+    void                        DropItem(void *ctx, WQCallFn call);
+    void                        RecoverItem(uint64_t seq, const void *record);
+    void                        Complete(QueItem &item);
+    size_t                      RateQuota(size_t maxItems, uint64_t &waitNs);
+    void                        Throttle(uint64_t waitNs);
+    int                         Setup(const std::string &name);
+    size_t                      TakeLocked(TDrain &buff, size_t maxItems);
+    size_t                      DueRetries() const;
+    void                        TakeRetries(TDrain &buff, size_t maxItems);
+    uint64_t                    Process(TDrain &buff);
+    void                        Adopt(QueItem *first, QueItem *last);
+
+    uint64_t                    TraceItemId();
+    uint32_t                    TraceQueueId();
+    void                        TracePush(uint64_t traceId, uint64_t ts);
+
+    //Fields are grouped by who writes them, each group starting on its own TPolicy::Align line,
+    //so producers, the worker and Size() readers (WorkQueuePool::MinIdx) do not invalidate each other
+    static constexpr size_t     LINE = TPolicy::Align;
+
+    //One push on its way from PushItem to ApplyPush, inputs then results
+    struct PushRequest
+    {
+        WQ_PUSH_OP  _op;
+        void       *_ctx;
+        WQCallFn    _call;
+        uint64_t    _key;
+        uint64_t    _ts;
+        uint64_t    _traceId;
+        uint64_t    _deadline;
+        WQCancelToken *_token;
+        TContainer *_dropped;       // receives the container content on PushFresh, null for the other ops
+
+        bool        _accepted      = false;
+        bool        _superseded    = false;
+        uint64_t    _journalSeq    = 0;
+        uint64_t    _supersededSeq = 0;
+    };
+
+    //Read-mostly, set up before Init
+    std::string                 _name;
+    Barrier                    *_barrier      = &_ownBarrier;
+    size_t                      _barrierShard = 0;
+    std::atomic<uint32_t>       _traceQueueId {0};  // WQTrace name id, registered by the first traced event
+    [[no_unique_address]] Field<WQ_FEATURE_JOURNAL, std::unique_ptr<WQJournal>>   _journal;
+    [[no_unique_address]] Field<WQ_FEATURE_RATE, std::shared_ptr<WQTokenBucket>>  _rate;
+    [[no_unique_address]] Field<WQ_FEATURE_RATE, WQ_RATE_UNIT>                    _rateUnit = WQ_RATE_UNIT::ITEM;
+    [[no_unique_address]] Field<WQ_FEATURE_RETRY, WQRetryPolicy>                  _retryPolicy;
+    bool                        _external = false;  // InitExternal: no worker thread, TryDrain consumes
+    [[no_unique_address]] Field<WQ_FEATURE_TUNING, bool>                          _tuned = false;     // SetBatchTuning
+
+    //Read by every push and by the worker, rarely written (WQStateShared also counts its readers here)
+    alignas(LINE) typename TPolicy::State _thState;
+
+    //Producer side: what a push touches under the queue lock
+    alignas(LINE) TLock         _thLockQue;
+    typename TPolicy::Wake      _thWake;
+    TContainer                  _container;
+    [[no_unique_address]] Field<WQ_FEATURE_CONFLATE, std::unordered_map<uint64_t, QueItem *>> _conflateIndex;   // queued PushConflate items, container references stay valid
+    std::atomic<uint64_t>       _traceSeq {0};
+    std::thread::id             _inlineOwner;       // PushOrRun caller popping right now, none by default
+
+    //Queue depth, polled by Size() without taking the lock
+    alignas(LINE) std::atomic_size_t _containerSize = 0;
+
+    //Worker side
+    alignas(LINE) TDrain        _tryBuff;           // TryDrain batch, reused
+    [[no_unique_address]] Field<WQ_FEATURE_RETRY, std::vector<RetryItem>> _retry;   // min-heap on _dueNs, worker thread only
+    std::atomic<uint64_t>       _popStart     {0};  // WQClock::Now() at the start of the current Pop()
+    std::atomic<bool>           _workerBusy {false};// Listener holds a batch, PushOrRun may not pop
+    std::atomic<std::thread::id> _workerTid;
+    [[no_unique_address]] Field<WQ_FEATURE_TUNING, WQBatchTuner> _tuner;
+    std::atomic<uint64_t>       _completed    {0};  // pushed items that were popped or dropped since
+
+    WorkQueueStats              _stats;             // split into producer and worker lines itself
+    Barrier                     _ownBarrier;        // WaitIdle of a queue outside a pool, lines of its own
+};
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+WorkQueue<TData, TDerived, TPolicy>::~WorkQueue()
+{
+    Release();
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueue<TData, TDerived, TPolicy>::Init(WQ_QUEUE_STATE state, const std::string &name /*= ""*/)
+{
+    if (0 != Setup(name))
+        return -1;
+
+    SetState(state);
+    this->Start();
+    return 0;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueue<TData, TDerived, TPolicy>::InitExternal(WQ_QUEUE_STATE state, const std::string &name /*= ""*/)
+{
+    static_assert(false == HAS_RATE && false == HAS_RETRY,
+                  "InitExternal needs a policy without WQ_FEATURE_RATE and WQ_FEATURE_RETRY, the caller's event loop must not sleep for tokens or backoffs (see WQEventFdPolicy)");
+    if (0 != Setup(name))
+        return -1;
+
+    _external = true;
+    static_cast<TDerived*>(this)->Begin();
+    SetState(state);
+    return 0;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueue<TData, TDerived, TPolicy>::Setup(const std::string &name)
+{
+    _name = name;
+    _traceQueueId.store(0, std::memory_order_relaxed);
+    WQClock::Calibrate();
+
+    if constexpr (HAS_JOURNAL)
+    {
+        if (nullptr != _journal && false == _journal->IsOpen())
+        {
+            std::lock_guard<TLock> lck{_thLockQue};
+            if (0 != _journal->Open([this](uint64_t seq, const void *record) { RecoverItem(seq, record); }))
+                return -1;
+        }
+    }
+    return 0;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+void WorkQueue<TData, TDerived, TPolicy>::Release(bool bForce /*= false*/)
+{
+    SetState(bForce ? WQ_QUEUE_STATE::EXITING_FORCE : WQ_QUEUE_STATE::EXITING_WAIT);
+    if (_external)
+    {
+        //No worker thread: the exiting Listener drains (or drops) the rest right here
+        _external = false;
+        Listener();
+        static_cast<TDerived*>(this)->End();
+    }
+    else
+    {
+        this->Join();
+    }
+    if constexpr (HAS_JOURNAL)
+        if (nullptr != _journal)
+            _journal->Sync();
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueue<TData, TDerived, TPolicy>::Release(const timespec &timeout)
+{
+    SetState(WQ_QUEUE_STATE::EXITING_WAIT);
+    int ret = WaitIdle(uint64_t(TimespecToNs(timeout)));
+    Release(0 != ret);
+    return ret;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueue<TData, TDerived, TPolicy>::WaitIdle(uint64_t timeoutNs /*= UINT64_MAX*/)
+{
+    uint64_t now = WQNowNs();
+    return _barrier->Wait(timeoutNs > UINT64_MAX - now ? UINT64_MAX : now + timeoutNs);
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+void WorkQueue<TData, TDerived, TPolicy>::Complete(QueItem &item)
+{
+    //Popped, dropped or discarded for good: the item leaves the barrier epoch it was pushed in
+    _completed.fetch_add(1, std::memory_order_relaxed);
+    _barrier->Leave(item._left);
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueue<TData, TDerived, TPolicy>::EnableJournal(const std::string &dir, const WQJournalConfig &cfg /*= WQJournalConfig()*/)
+{
+    static_assert(HAS_JOURNAL, "EnableJournal needs a policy with WQ_FEATURE_JOURNAL");
+    static_assert(std::is_trivially_copyable<TData>::value, "EnableJournal needs a trivially copyable TData");
+    if (nullptr != _journal || WQ_QUEUE_STATE::EXITING_WAIT != GetState())
+        return -1;
+
+    _journal = std::make_unique<WQJournal>(dir, uint32_t(sizeof(TData)), cfg);
+    return 0;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueue<TData, TDerived, TPolicy>::SetRateLimit(std::shared_ptr<WQTokenBucket> bucket, WQ_RATE_UNIT unit /*= WQ_RATE_UNIT::ITEM*/)
+{
+    static_assert(HAS_RATE, "SetRateLimit needs a policy with WQ_FEATURE_RATE");
+    if (WQ_QUEUE_STATE::EXITING_WAIT != GetState())
+        return -1;
+
+    _rate     = std::move(bucket);
+    _rateUnit = unit;
+    return 0;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueue<TData, TDerived, TPolicy>::SetRateLimit(double ratePerSec, double burst /*= 1.0*/, WQ_RATE_UNIT unit /*= WQ_RATE_UNIT::ITEM*/)
+{
+    return SetRateLimit(std::make_shared<WQTokenBucket>(ratePerSec, burst), unit);
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueue<TData, TDerived, TPolicy>::SetRetryPolicy(const WQRetryPolicy &policy)
+{
+    static_assert(HAS_RETRY, "SetRetryPolicy needs a policy with WQ_FEATURE_RETRY");
+    static_assert(std::is_same<PopResult<>, int>::value, "SetRetryPolicy needs an int TDerived::Pop");
+    if (WQ_QUEUE_STATE::EXITING_WAIT != GetState())
+        return -1;
+
+    _retryPolicy = policy;
+    return 0;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueue<TData, TDerived, TPolicy>::SetBatchTuning(const WQBatchTuning &tuning)
+{
+    static_assert(HAS_TUNING, "SetBatchTuning needs a policy with WQ_FEATURE_TUNING");
+    if (WQ_QUEUE_STATE::EXITING_WAIT != GetState())
+        return -1;
+
+    _tuner.Configure(tuning);
+    _tuned = true;
+    return 0;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+bool WorkQueue<TData, TDerived, TPolicy>::Retry(QueItem &item, int rc)
+{
+    ++item._attempts;
+    if (item._attempts < _retryPolicy._maxAttempts)
+    {
+        uint64_t due = WQNowNs() + _retryPolicy.BackoffNs(item._attempts);
+        _retry.push_back(RetryItem{due, std::move(item)});
+        std::push_heap(_retry.begin(), _retry.end(), std::greater<RetryItem>());
+        WorkQueueStats::Inc(_stats._retried);
+        return true;
+    }
+
+    static_cast<TDerived*>(this)->OnDeadLetter(&item._data, rc, item._attempts);
+    WorkQueueStats::Inc(_stats._deadLettered);
+    return false;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+bool WorkQueue<TData, TDerived, TPolicy>::RetryPending() const
+{
+    if constexpr (HAS_RETRY)
+        return false == _retry.empty();
+    return false;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+void WorkQueue<TData, TDerived, TPolicy>::JournalAck(uint64_t seq)
+{
+    //The record of an item that is done with, 0 for items that were not journaled
+    if constexpr (HAS_JOURNAL)
+        if (0 != seq)
+            _journal->Ack(seq);
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+const WQBatchTuner& WorkQueue<TData, TDerived, TPolicy>::BatchTuner() const
+{
+    static_assert(HAS_TUNING, "BatchTuner needs a policy with WQ_FEATURE_TUNING");
+    return _tuner;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueue<TData, TDerived, TPolicy>::RateQuota(size_t maxItems, uint64_t &waitNs)
+{
+    //Items the next drain may take: one token each, or all of them for the one token of a batch
+    uint64_t now = WQNowNs();
+    if (WQ_RATE_UNIT::BATCH == _rateUnit)
+        return 0 != _rate->Acquire(1, now, waitNs) ? maxItems : 0;
+    return size_t(_rate->Acquire(maxItems, now, waitNs));
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+void WorkQueue<TData, TDerived, TPolicy>::Throttle(uint64_t waitNs)
+{
+    //Sleep to the exact token time, in slices so that a forced exit is not held up
+    uint64_t now   = WQNowNs();
+    uint64_t from  = now;
+    uint64_t until = now + waitNs;
+    while (now < until && GetState() != WQ_QUEUE_STATE::EXITING_FORCE)
+    {
+        timespec wake = TimespecFromNs(std::min(until, now + MS_TO_NS(10)));
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL);
+        now = WQNowNs();
+    }
+    WorkQueueStats::Inc(_stats._throttledNs, now - from);
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+void WorkQueue<TData, TDerived, TPolicy>::RecoverItem(uint64_t seq, const void *record)
+{
+    if constexpr (std::is_trivially_copyable<TData>::value)
+    {
+        //Items beyond a bounded container stay in the journal for the next run
+        if (_container.full())
+            return;
+
+        alignas(TData) unsigned char buf[sizeof(TData)];
+        memcpy(buf, record, sizeof(TData));
+        _container.emplace_front(QueItem{*std::launder(reinterpret_cast<TData *>(buf)), WQClock::Now(), 0, nullptr, nullptr, seq, _barrier->Enter(_barrierShard)});
+        ++_containerSize;
+        WorkQueueStats::Inc(_stats._pushed);
+    }
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+WQ_QUEUE_STATE WorkQueue<TData, TDerived, TPolicy>::GetState() const
+{
+    return _thState.Get();
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+void WorkQueue<TData, TDerived, TPolicy>::SetState(WQ_QUEUE_STATE stat)
+{
+    WQ_QUEUE_STATE prev = _thState.Exchange(stat);
+    WQ_PROBE3(state, _name.c_str(), int(prev), int(stat));
+    (void)prev;
+
+    //Notify under the queue lock so a Listener between its predicate check and its sleep can not miss the change,
+    //and a WQEventFdWake Reset() can not run between its flag and its write.
+    //Every change notifies: a WQEventFdWake fd that TryDrain reset while paused turns readable again
+    //for the items still pending, the next TryDrain resets it if there are none
+    std::lock_guard<TLock> lck{_thLockQue};
+    _thWake.Notify();
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+timespec WorkQueue<TData, TDerived, TPolicy>::GetWaitTime() const
+{
+    return _thState.WaitTime();
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+void WorkQueue<TData, TDerived, TPolicy>::SetWaitTime(const timespec &tmsp)
+{
+    _thState.SetWaitTime(tmsp);
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueue<TData, TDerived, TPolicy>::Size() const
+{
+    return _containerSize;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+const std::string& WorkQueue<TData, TDerived, TPolicy>::Name() const
+{
+    return _name;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+const WorkQueueStats& WorkQueue<TData, TDerived, TPolicy>::Stats() const
+{
+    return _stats;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+template <typename TArg>
+bool WorkQueue<TData, TDerived, TPolicy>::PushItem(WQ_PUSH_OP op, TArg &&data, void *ctx, WQCallFn call, uint64_t key /*= 0*/, const WQItemLimit *limit /*= nullptr*/)
+{
+    WQ_QUEUE_STATE state = GetState();
+    switch (state)
+    {
+        case WQ_QUEUE_STATE::WORKING :
+        {
+            uint64_t ts       = WQClock::Now();
+            uint64_t traceId  = TraceItemId();
+            uint64_t deadline = 0;
+            WQCancelToken token;
+            if (nullptr != limit)
+            {
+                deadline = (0 != limit->_deadlineNs) ? std::max<uint64_t>(WQClock::FromMonotonic(limit->_deadlineNs), 1) : 0;
+                token    = limit->_token;
+            }
+
+            //Only PushFresh takes the container content, an empty container may allocate, so the others skip it
+            std::optional<TContainer> dropped;
+            if (WQ_PUSH_OP::FRESH == op)
+                dropped.emplace();
+
+            PushRequest req{op, ctx, call, key, ts, traceId, deadline, &token, dropped ? &*dropped : nullptr};
+            {
+                std::lock_guard<TLock> lck{_thLockQue};
+                ApplyPush(std::forward<TArg>(data), req);
+                if (req._accepted)
+                    _thWake.Notify();
+            }
+            if (false == req._accepted)
+                break;
+
+            TracePush(traceId, ts);
+            WQ_PROBE3(push, _name.c_str(), _containerSize.load(), int(op));
+
+            //Group commit: whoever crosses the threshold msyncs everything appended so far
+            if constexpr (HAS_JOURNAL)
+                if (0 != req._journalSeq && _journal->SyncDue())
+                    _journal->Sync();
+
+            //Futures and callbacks of the cleared items complete outside the queue lock, PushFresh discards them for good
+            JournalAck(req._supersededSeq);
+            //A superseded value is not an item of its own, its pending item stays in the barrier
+            if (dropped)
+            {
+                while (false == dropped->empty())
+                {
+                    JournalAck(dropped->back()._journalSeq);
+                    DropItem(dropped->back()._ctx, dropped->back()._call);
+                    Complete(dropped->back());
+                    dropped->pop_back();
+                }
+            }
+            return true;
+        }
+
+        default :
+            break;
+    }
+
+    _stats._dropped.fetch_add(1, std::memory_order_relaxed);
+    WQ_PROBE3(drop, _name.c_str(), _containerSize.load(), int(state));
+    if (nullptr == call)
+        DropItem(ctx, nullptr);
+    return false;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+template <typename TArg>
+void WorkQueue<TData, TDerived, TPolicy>::ApplyPush(TArg &&data, PushRequest &req)
+{
+    //Called with _thLockQue held
+    QueItem *pending = nullptr;
+    if constexpr (HAS_CONFLATE)
+    {
+        if (WQ_PUSH_OP::CONFLATE == req._op)
+        {
+            auto it = _conflateIndex.find(req._key);
+            if (_conflateIndex.end() != it)
+                pending = it->second;
+        }
+    }
+
+    //A bounded container refuses new items when full, FRESH and conflated replacements always fit
+    if (WQ_PUSH_OP::FRESH != req._op && nullptr == pending && _container.full())
+        return;
+
+    uint64_t journalSeq = 0;
+    if constexpr (HAS_JOURNAL && std::is_trivially_copyable<TData>::value)
+    {
+        //Journal order follows queue order, a journal that can not take the record rejects the push
+        if (nullptr != _journal && nullptr == req._call)
+        {
+            journalSeq = _journal->Append(&static_cast<const TData &>(data));
+            if (0 == journalSeq)
+                return;
+        }
+    }
+
+    switch (req._op)
+    {
+        case WQ_PUSH_OP::BACK :
+            _container.emplace_front(QueItem{std::forward<TArg>(data), req._ts, req._traceId, req._ctx, req._call, journalSeq, _barrier->Enter(_barrierShard), 0, false, 0, req._deadline, std::move(*req._token)});
+            ++_containerSize;
+            break;
+
+        case WQ_PUSH_OP::FRONT :
+            _container.emplace_back(QueItem{std::forward<TArg>(data), req._ts, req._traceId, req._ctx, req._call, journalSeq, _barrier->Enter(_barrierShard), 0, false, 0, req._deadline, std::move(*req._token)});
+            ++_containerSize;
+            break;
+
+        case WQ_PUSH_OP::FRESH :
+            _stats._dropped.fetch_add(_container.size(), std::memory_order_relaxed);
+            req._dropped->swap(_container);
+            if constexpr (HAS_CONFLATE)
+                _conflateIndex.clear();
+            _container.emplace_back(QueItem{std::forward<TArg>(data), req._ts, req._traceId, req._ctx, req._call, journalSeq, _barrier->Enter(_barrierShard), 0, false, 0, req._deadline, std::move(*req._token)});
+            _containerSize = 1;
+            break;
+
+        case WQ_PUSH_OP::CONFLATE :
+            if constexpr (false == HAS_CONFLATE)
+            {
+                return;
+            }
+            else if (nullptr != pending)
+            {
+                pending->_data       = std::forward<TArg>(data);
+                req._supersededSeq   = pending->_journalSeq;
+                pending->_journalSeq = journalSeq;
+                pending->_deadline   = req._deadline;
+                pending->_token      = std::move(*req._token);
+                req._superseded      = true;
+                _stats._dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                QueItem &item = _container.emplace_front(QueItem{std::forward<TArg>(data), req._ts, req._traceId, req._ctx, req._call, journalSeq, _barrier->Enter(_barrierShard), req._key, true, 0, req._deadline, std::move(*req._token)});
+                _conflateIndex.emplace(req._key, &item);
+                ++_containerSize;
+            }
+            break;
+    }
+    WorkQueueStats::Inc(_stats._pushed);
+    req._journalSeq = journalSeq;
+    req._accepted   = true;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueue<TData, TDerived, TPolicy>::PushBack(const TData &data)
+{
+    PushItem(WQ_PUSH_OP::BACK, data, nullptr, nullptr);
+    return _containerSize;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueue<TData, TDerived, TPolicy>::PushBack(TData &&data)
+{
+    PushItem(WQ_PUSH_OP::BACK, std::move(data), nullptr, nullptr);
+    return _containerSize;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueue<TData, TDerived, TPolicy>::PushFront(const TData &data)
+{
+    PushItem(WQ_PUSH_OP::FRONT, data, nullptr, nullptr);
+    return _containerSize;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueue<TData, TDerived, TPolicy>::PushFront(TData &&data)
+{
+    PushItem(WQ_PUSH_OP::FRONT, std::move(data), nullptr, nullptr);
+    return _containerSize;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueue<TData, TDerived, TPolicy>::PushFresh(const TData &data)
+{
+    PushItem(WQ_PUSH_OP::FRESH, data, nullptr, nullptr);
+    return _containerSize;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueue<TData, TDerived, TPolicy>::PushFresh(TData &&data)
+{
+    PushItem(WQ_PUSH_OP::FRESH, std::move(data), nullptr, nullptr);
+    return _containerSize;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+template <typename TIter>
+size_t WorkQueue<TData, TDerived, TPolicy>::PushRange(TIter first, TIter last)
+{
+    size_t   count      = 0;
+    uint64_t journalSeq = 0;
+    if (GetState() == WQ_QUEUE_STATE::WORKING)
+    {
+        uint64_t ts = WQClock::Now();
+        {
+            std::lock_guard<TLock> lck{_thLockQue};
+            for (; first != last && false == _container.full(); ++first)
+            {
+                uint64_t seq = 0;
+                if constexpr (HAS_JOURNAL && std::is_trivially_copyable<TData>::value)
+                {
+                    if (nullptr != _journal)
+                    {
+                        seq = _journal->Append(&static_cast<const TData &>(*first));
+                        if (0 == seq)
+                            break;
+                        journalSeq = seq;
+                    }
+                }
+
+                uint64_t traceId = TraceItemId();
+                _container.emplace_front(QueItem{*first, ts, traceId, nullptr, nullptr, seq, _barrier->Enter(_barrierShard)});
+                TracePush(traceId, ts);
+                ++count;
+            }
+
+            if (0 != count)
+            {
+                _containerSize += count;
+                WorkQueueStats::Inc(_stats._pushed, count);
+                _thWake.Notify();
+            }
+        }
+        WQ_PROBE3(push, _name.c_str(), _containerSize.load(), int(WQ_PUSH_OP::BACK));
+
+        if constexpr (HAS_JOURNAL)
+            if (0 != journalSeq && _journal->SyncDue())
+                _journal->Sync();
+    }
+
+    size_t rejected = 0;
+    for (; first != last; ++first)
+        ++rejected;
+    if (0 != rejected)
+        _stats._dropped.fetch_add(rejected, std::memory_order_relaxed);
+    return count;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueue<TData, TDerived, TPolicy>::PushConflate(uint64_t key, const TData &data)
+{
+    static_assert(HAS_CONFLATE, "PushConflate needs a policy with WQ_FEATURE_CONFLATE");
+    PushItem(WQ_PUSH_OP::CONFLATE, data, nullptr, nullptr, key);
+    return _containerSize;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueue<TData, TDerived, TPolicy>::PushConflate(uint64_t key, TData &&data)
+{
+    static_assert(HAS_CONFLATE, "PushConflate needs a policy with WQ_FEATURE_CONFLATE");
+    PushItem(WQ_PUSH_OP::CONFLATE, std::move(data), nullptr, nullptr, key);
+    return _containerSize;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueue<TData, TDerived, TPolicy>::PushExpiring(const TData &data, const WQItemLimit &limit, WQ_PUSH_OP op /*= WQ_PUSH_OP::BACK*/)
+{
+    static_assert(HAS_EXPIRY, "PushExpiring needs a policy with WQ_FEATURE_EXPIRY");
+    PushItem(op, data, nullptr, nullptr, 0, &limit);
+    return _containerSize;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueue<TData, TDerived, TPolicy>::PushExpiring(TData &&data, const WQItemLimit &limit, WQ_PUSH_OP op /*= WQ_PUSH_OP::BACK*/)
+{
+    static_assert(HAS_EXPIRY, "PushExpiring needs a policy with WQ_FEATURE_EXPIRY");
+    PushItem(op, std::move(data), nullptr, nullptr, 0, &limit);
+    return _containerSize;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueue<TData, TDerived, TPolicy>::PushOrRun(const TData &data)
+{
+    return RunOrPush(data);
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueue<TData, TDerived, TPolicy>::PushOrRun(TData &&data)
+{
+    return RunOrPush(std::move(data));
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+template <typename TArg>
+int WorkQueue<TData, TDerived, TPolicy>::RunOrPush(TArg &&data)
+{
+    //The retry lane and the rate limiter are the worker's, an external queue pops on its own loop only
+    bool workerOnly = _external;
+    if constexpr (HAS_RATE)
+        workerOnly |= nullptr != _rate;
+    if constexpr (HAS_RETRY)
+        workerOnly |= 0 != _retryPolicy._maxAttempts;
+    if (workerOnly || false == static_cast<TDerived*>(this)->CanRunInline(&data))
+        return PushItem(WQ_PUSH_OP::BACK, std::forward<TArg>(data), nullptr, nullptr) ? 0 : -1;
+
+    const std::thread::id self = std::this_thread::get_id();
+    TDrain   buff;
+    bool     own     = false;   // data is the last item of buff
+    uint64_t ts      = 0;
+    uint64_t traceId = 0;
+    for (;;)
+    {
+        {
+            std::lock_guard<TLock> lck{_thLockQue};
+            bool full = _container.full();
+            bool busy = std::thread::id() != _inlineOwner || _workerBusy.load(std::memory_order_acquire);
+            if (WQ_QUEUE_STATE::WORKING != GetState() || (0 != _containerSize && false == full))
+                break;
+
+            if (false == busy)
+            {
+                //Oldest first, up to the first item that has to stay on the worker thread
+                while (_containerSize > 0 && nullptr == _container.back()._call &&
+                       static_cast<TDerived*>(this)->CanRunInline(&_container.back()._data))
+                {
+                    buff.push_back(std::move(_container.back()));
+                    if constexpr (HAS_CONFLATE)
+                        if (buff.back()._keyed)
+                            _conflateIndex.erase(buff.back()._key);
+                    _container.pop_back();
+                    _containerSize--;
+                }
+                if (0 == _containerSize)
+                {
+                    ts      = WQClock::Now();
+                    traceId = TraceItemId();
+                    buff.push_back(QueItem{std::forward<TArg>(data), ts, traceId, nullptr, nullptr, 0, _barrier->Enter(_barrierShard)});
+                    WorkQueueStats::Inc(_stats._pushed);
+                    own = true;
+                }
+                //The Listener takes no batch until the owner hands Pop() back
+                if (false == buff.empty())
+                    _inlineOwner = self;
+                break;
+            }
+
+            //Pop() from within Pop() can not wait for itself
+            if (false == full || self == _inlineOwner || self == _workerTid.load(std::memory_order_relaxed))
+                break;
+        }
+        //Full while the worker is mid-batch: wait it out rather than pop ahead of its items
+        std::this_thread::yield();
+    }
+
+    int rc = 1;
+    if (own)
+        TracePush(traceId, ts);
+    else
+        rc = PushItem(WQ_PUSH_OP::BACK, std::forward<TArg>(data), nullptr, nullptr) ? 0 : -1;
+
+    if (buff.empty())
+        return rc;
+
+    _stats._inlined.fetch_add(buff.size(), std::memory_order_relaxed);
+    Process(buff);
+    {
+        std::lock_guard<TLock> lck{_thLockQue};
+        _inlineOwner = std::thread::id();
+        _thWake.Notify();
+    }
+    return rc;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+template <typename TD>
+WQFuture<typename WorkQueue<TData, TDerived, TPolicy>::template PopResult<TD>> WorkQueue<TData, TDerived, TPolicy>::Submit(const TData &data, WQ_PUSH_OP op /*= WQ_PUSH_OP::BACK*/)
+{
+    static_assert(HAS_CALL, "Submit needs a policy with WQ_FEATURE_CALL");
+    WQFutureState<PopResult<TD>> *state = WQFutureSlab<PopResult<TD>>::Instance().Acquire();
+    if (nullptr == state)
+    {
+        _stats._dropped.fetch_add(1, std::memory_order_relaxed);
+        WQ_PROBE3(drop, _name.c_str(), _containerSize.load(), int(GetState()));
+        return WQFuture<PopResult<TD>>();
+    }
+
+    WQFuture<PopResult<TD>> future(state);
+    PushItem(op, data, state, nullptr);
+    return future;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueue<TData, TDerived, TPolicy>::PushCall(WQCallFn fn, void *ctx, WQ_PUSH_OP op /*= WQ_PUSH_OP::BACK*/)
+{
+    static_assert(HAS_CALL, "PushCall needs a policy with WQ_FEATURE_CALL");
+    static_assert(std::is_default_constructible<TData>::value, "PushCall needs a default constructible TData");
+    return PushItem(op, TData{}, ctx, fn) ? 0 : -1;
+}
+
 
-    const std::string&  Name() const;
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueue<TData, TDerived, TPolicy>::Dispatch(QueItem &item)
+{
+    if constexpr (HAS_CALL)
+    {
+        if (nullptr != item._call)
+        {
+            item._call(item._ctx, false);
+            return 0;
+        }
 
- private:
+        if (nullptr != item._ctx)
+        {
+            auto *state = static_cast<WQFutureState<PopResult<>> *>(item._ctx);
+            item._ctx = nullptr;
 
-    std::string                 _name;
-    mutable std::shared_mutex   _thStatLock;
-    std::mutex                  _thLockQue;
-    std::condition_variable     _thCond;
-    WQ_QUEUE_STATE              _thState = WQ_QUEUE_STATE::EXITING_WAIT;
-    timespec                    _thWaitTime {1,0};
-
-    std::deque<TData>           _container;
-    std::atomic_size_t          _containerSize = 0;
-};
+            if constexpr (std::is_void<PopResult<>>::value)
+            {
+                static_cast<TDerived*>(this)->Pop(&item._data);
+                state->SetValue();
+            }
+            else
+            {
+                state->SetValue(static_cast<TDerived*>(this)->Pop(&item._data));
+            }
+            state->Release();
+            return 0;
+        }
+    }
+
+    if constexpr (std::is_same<PopResult<>, int>::value)
+        return static_cast<TDerived*>(this)->Pop(&item._data);
+    static_cast<TDerived*>(this)->Pop(&item._data);
+    return 0;
+}
 
 
-template <typename TData, typename TDerived>
-WorkQueue<TData, TDerived>::~WorkQueue()
+template <typename TData, typename TDerived, typename TPolicy>
+WQ_EXPIRE_REASON WorkQueue<TData, TDerived, TPolicy>::Staleness(const QueItem &item, uint64_t tsNow) const
 {
-    Release();
+    if constexpr (HAS_EXPIRY)
+    {
+        if (item._token.IsCancelled())
+            return WQ_EXPIRE_REASON::CANCELLED;
+        if (0 != item._deadline && tsNow >= item._deadline)
+            return WQ_EXPIRE_REASON::DEADLINE;
+    }
+    return WQ_EXPIRE_REASON::NONE;
 }
 
 
-template <typename TData, typename TDerived>
-int WorkQueue<TData, TDerived>::Init(WQ_QUEUE_STATE state, const std::string &name /*= ""*/)
+template <typename TData, typename TDerived, typename TPolicy>
+void WorkQueue<TData, TDerived, TPolicy>::Expire(QueItem &item, WQ_EXPIRE_REASON reason)
 {
-    _name = name;
-    SetState(state);
-    this->Start();
-    return 0;
+    static_cast<TDerived*>(this)->OnExpired(&item._data, reason);
+    WorkQueueStats::Inc(WQ_EXPIRE_REASON::DEADLINE == reason ? _stats._expired : _stats._cancelled);
+    JournalAck(item._journalSeq);
+    DropItem(item._ctx, item._call);
 }
 
 
-template <typename TData, typename TDerived>
-void WorkQueue<TData, TDerived>::Release(bool bForce /*= false*/)
+template <typename TData, typename TDerived, typename TPolicy>
+void WorkQueue<TData, TDerived, TPolicy>::DropItem(void *ctx, WQCallFn call)
 {
-    SetState(bForce ? WQ_QUEUE_STATE::EXITING_FORCE : WQ_QUEUE_STATE::EXITING_WAIT);
-    this->Join();
+    if constexpr (false == HAS_CALL)
+        return;
+
+    if (nullptr != call)
+    {
+        call(ctx, true);
+        return;
+    }
+
+    if (nullptr == ctx)
+        return;
+
+    auto *state = static_cast<WQFutureState<PopResult<>> *>(ctx);
+    state->Break();
+    state->Release();
 }
 
 
-template <typename TData, typename TDerived>
-WQ_QUEUE_STATE WorkQueue<TData, TDerived>::GetState() const
+template <typename TData, typename TDerived, typename TPolicy>
+uint64_t WorkQueue<TData, TDerived, TPolicy>::TraceItemId()
 {
-    std::shared_lock<std::shared_mutex> lck(_thStatLock);
-    return _thState;
+    return WQTrace::Enabled() ? WQTrace::ItemId(TraceQueueId(), _traceSeq) : 0;
 }
 
 
-template <typename TData, typename TDerived>
-void WorkQueue<TData, TDerived>::SetState(WQ_QUEUE_STATE stat)
+template <typename TData, typename TDerived, typename TPolicy>
+uint32_t WorkQueue<TData, TDerived, TPolicy>::TraceQueueId()
 {
-    std::scoped_lock lck(_thStatLock);
-    _thState = stat;
-    _thCond.notify_one();
+    //Queues that are never traced never touch the global name registry
+    uint32_t id = _traceQueueId.load(std::memory_order_acquire);
+    if (0 == id)
+    {
+        uint32_t fresh = WQTrace::RegisterQueue(_name);
+        if (_traceQueueId.compare_exchange_strong(id, fresh, std::memory_order_acq_rel))
+            id = fresh;
+    }
+    return id;
 }
 
 
-template <typename TData, typename TDerived>
-const timespec  &WorkQueue<TData, TDerived>::GetWaitTime()
+template <typename TData, typename TDerived, typename TPolicy>
+void WorkQueue<TData, TDerived, TPolicy>::TracePush(uint64_t traceId, uint64_t ts)
 {
-    std::shared_lock<std::shared_mutex> lck(_thStatLock);
-    return _thWaitTime;
+    if (0 != traceId)
+        WQTrace::Record(WQ_TRACE_EVENT::PUSH, TraceQueueId(), traceId, ts, WQClock::Now());
 }
 
 
-template <typename TData, typename TDerived>
-void WorkQueue<TData, TDerived>::SetWaitTime(const timespec &tmsp)
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueue<TData, TDerived, TPolicy>::TakeLocked(TDrain &buff, size_t maxItems)
 {
-    std::scoped_lock lck(_thStatLock);
-    _thWaitTime = tmsp;
+    //Called with _thLockQue held, moves the oldest items into the drain buffer
+    uint64_t tsDrain = WQTrace::Enabled() ? WQClock::Now() : 0;
+
+    size_t count = 0;
+    while (_containerSize > 0 && count < maxItems)
+    {
+        buff.push_back(std::move(_container.back()));
+        if constexpr (HAS_CONFLATE)
+            if (buff.back()._keyed)
+                _conflateIndex.erase(buff.back()._key);
+
+        _container.pop_back();
+        _containerSize--;
+        ++count;
+    }
+
+    //Fired once the batch is taken, a batch cap (SetBatchTuning) may leave items behind
+    WQ_PROBE2(drain_start, _name.c_str(), count);
+    if (0 != tsDrain && 0 != count)
+        WQTrace::Record(WQ_TRACE_EVENT::DRAIN, TraceQueueId(), 0, tsDrain, WQClock::Now(), uint32_t(count));
+    return count;
 }
 
 
-template <typename TData, typename TDerived>
-size_t WorkQueue<TData, TDerived>::Size() const
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueue<TData, TDerived, TPolicy>::DueRetries() const
 {
-    return _containerSize;
+    size_t due = 0;
+    if constexpr (HAS_RETRY)
+    {
+        uint64_t now = WQNowNs();
+        for (auto &retry : _retry)
+            due += retry._dueNs <= now ? 1 : 0;
+    }
+    return due;
 }
 
 
-template <typename TData, typename TDerived>
-const std::string& WorkQueue<TData, TDerived>::Name() const
+template <typename TData, typename TDerived, typename TPolicy>
+void WorkQueue<TData, TDerived, TPolicy>::TakeRetries(TDrain &buff, size_t maxItems)
 {
-    return _name;
+    if constexpr (HAS_RETRY)
+    {
+        if (_retry.empty())
+            return;
+
+        uint64_t now = WQNowNs();
+        while (0 != maxItems-- && false == _retry.empty() && _retry.front()._dueNs <= now)
+        {
+            std::pop_heap(_retry.begin(), _retry.end(), std::greater<RetryItem>());
+            buff.push_back(std::move(_retry.back()._item));
+            _retry.pop_back();
+        }
+    }
 }
 
 
-template <typename TData, typename TDerived>
-size_t WorkQueue<TData, TDerived>::PushBack(const TData &data)
+template <typename TData, typename TDerived, typename TPolicy>
+uint64_t WorkQueue<TData, TDerived, TPolicy>::Process(TDrain &buff)
 {
-    switch (GetState())
+    //Returns the slowest push to end of Pop() latency of the batch, measured for SetBatchTuning only
+    uint64_t worstNs = 0;
+    uint64_t tsNow   = buff.empty() ? 0 : WQClock::Now();
+    for(auto &item : buff)
     {
-        case WQ_QUEUE_STATE::WORKING :
+        //Stale items are discarded without Pop
+        WQ_EXPIRE_REASON stale = Staleness(item, tsNow);
+        if (WQ_EXPIRE_REASON::NONE != stale && GetState() != WQ_QUEUE_STATE::EXITING_FORCE)
         {
-            std::lock_guard<std::mutex> lck{_thLockQue};
-            _container.emplace_front(data);
-            ++_containerSize;
-            _thCond.notify_one();
-            break;
+            Expire(item, stale);
         }
+        else if (GetState() != WQ_QUEUE_STATE::EXITING_FORCE)
+        {
+            uint64_t waitNs = WQClockDiffNs(item._tsPush, tsNow);
+            _popStart.store(tsNow, std::memory_order_relaxed);
+            _stats._waitNs.Record(waitNs);
+            WQ_PROBE2(pop_start, _name.c_str(), waitNs);
+
+            int rc = Dispatch(item);
+
+            uint64_t tsEnd     = WQClock::Now();
+            uint64_t serviceNs = WQClockDiffNs(tsNow, tsEnd);
+            _stats._serviceNs.Record(serviceNs);
+            WQ_PROBE2(pop_end, _name.c_str(), serviceNs);
+            if (0 != item._traceId)
+                WQTrace::Record(WQ_TRACE_EVENT::POP, TraceQueueId(), item._traceId, tsNow, tsEnd);
+            tsNow = tsEnd;
+            if (_tuned)
+                worstNs = std::max(worstNs, WQClockDiffNs(item._tsPush, tsEnd));
+
+            //A failed item completes once it succeeds or is dead lettered, not while it waits in the retry lane
+            bool failed = false;
+            if constexpr (HAS_RETRY)
+            {
+                failed = (0 != rc && 0 != _retryPolicy._maxAttempts);
+                if (failed && Retry(item, rc))
+                    continue;
+                if (0 != item._attempts)
+                    _stats._retryNs.Record(WQClockDiffNs(item._tsPush, tsEnd));
+            }
+            (void)rc;
 
-        default :
-            break;
+            JournalAck(item._journalSeq);
+            if (false == failed)
+                WorkQueueStats::Inc(_stats._popped);
+        }
+        else
+        {
+            _stats._dropped.fetch_add(1, std::memory_order_relaxed);
+            DropItem(item._ctx, item._call);
+        }
+        Complete(item);
     }
-
-    return _containerSize;
+    return worstNs;
 }
 
 
-template <typename TData, typename TDerived>
-size_t WorkQueue<TData, TDerived>::PushBack(TData &&data)
+template <typename TData, typename TDerived, typename TPolicy>
+uint64_t WorkQueue<TData, TDerived, TPolicy>::PopRunningNs() const
 {
-    return PushBack(data);
+    //Process() records the wait before Pop() and the service after it: inside Pop() while they differ
+    uint64_t start = _popStart.load(std::memory_order_relaxed);
+    if (_stats._waitNs.Count() == _stats._serviceNs.Count())
+        return 0;
+    return WQClockDiffNs(start, WQClock::Now());
 }
 
 
-template <typename TData, typename TDerived>
-size_t WorkQueue<TData, TDerived>::PushFront(const TData &data)
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueue<TData, TDerived, TPolicy>::MovePending(WorkQueue *const *targets, size_t count)
 {
-    switch (GetState())
+    if (0 == count)
+        return 0;
+    for (size_t idx = 0; idx < count; ++idx)
+        if (targets[idx]->_barrier != _barrier)
+            return 0;
+
+    std::vector<QueItem> moved;     // oldest first
     {
-        case WQ_QUEUE_STATE::WORKING :
+        std::lock_guard<TLock> lck{_thLockQue};
+        TContainer keep;
+        while (false == _container.empty())
         {
-            std::lock_guard<std::mutex> lck{_thLockQue};
-            _container.emplace_back(data);
-            ++_containerSize;
-            _thCond.notify_one();
+            QueItem &item = _container.back();
+            if (nullptr == item._call && false == item._keyed && 0 == item._journalSeq)
+            {
+                moved.push_back(std::move(item));
+            }
+            else
+            {
+                QueItem &kept = keep.emplace_front(std::move(item));
+                if constexpr (HAS_CONFLATE)
+                    if (kept._keyed)
+                        _conflateIndex[kept._key] = &kept;
+            }
+            _container.pop_back();
         }
-
-        default :
-            break;
+        _container.swap(keep);
+        _containerSize = _container.size();
     }
+    if (moved.empty())
+        return 0;
 
-    return _containerSize;
-}
+    size_t slice = (moved.size() + count - 1) / count;
+    for (size_t idx = 0, from = 0; from < moved.size(); ++idx, from += slice)
+        targets[idx]->Adopt(moved.data() + from, moved.data() + std::min(moved.size(), from + slice));
 
-
-template <typename TData, typename TDerived>
-size_t WorkQueue<TData, TDerived>::PushFront(TData &&data)
-{
-    return PushFront(data);
+    //No Complete here: the items leave the shared barrier wherever they are popped
+    _stats._rehomed.fetch_add(moved.size(), std::memory_order_relaxed);
+    return moved.size();
 }
 
 
-template <typename TData, typename TDerived>
-size_t WorkQueue<TData, TDerived>::PushFresh(const TData &data)
+template <typename TData, typename TDerived, typename TPolicy>
+void WorkQueue<TData, TDerived, TPolicy>::Adopt(QueItem *first, QueItem *last)
 {
-    switch (GetState())
+    //Items taken from another queue: older than anything pending here, so they go to the drain end
+    std::vector<QueItem *> dropped;
     {
-        case WQ_QUEUE_STATE::WORKING :
+        std::lock_guard<TLock> lck{_thLockQue};
+        WQ_QUEUE_STATE state  = GetState();
+        bool           accept = (WQ_QUEUE_STATE::WORKING == state || WQ_QUEUE_STATE::PAUSE == state || WQ_QUEUE_STATE::EXITING_WAIT == state);
+        size_t         count  = 0;
+        while (last != first)
         {
-            std::lock_guard<std::mutex> lck{_thLockQue};
-            _container.clear();
-            _container.emplace_back(data);
-            _containerSize = 1;
-            _thCond.notify_one();
+            --last;
+            if (false == accept || _container.full())
+            {
+                dropped.push_back(last);
+                continue;
+            }
+            _container.emplace_back(std::move(*last));
+            ++count;
         }
+        if (0 != count)
+        {
+            _containerSize += count;
+            WorkQueueStats::Inc(_stats._pushed, count);
+            _thWake.Notify();
+        }
+    }
 
-        default :
-            break;
+    _stats._dropped.fetch_add(dropped.size(), std::memory_order_relaxed);
+    for (QueItem *item : dropped)
+    {
+        DropItem(item->_ctx, nullptr);
+        Complete(*item);
     }
+}
 
-    return _containerSize;
+
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueue<TData, TDerived, TPolicy>::TryDrain(size_t maxItems /*= SIZE_MAX*/)
+{
+    {
+        //Pushes and SetState notify under the lock, so neither
+        //an empty container nor a paused state seen here can miss the next wake up
+        std::lock_guard<TLock> lck{_thLockQue};
+        WQ_QUEUE_STATE state = GetState();
+        bool drainable = WQ_QUEUE_STATE::WORKING == state || WQ_QUEUE_STATE::EXITING_WAIT == state;
+        if (drainable)
+            TakeLocked(_tryBuff, maxItems);
+
+        //A level triggered fd left readable while nothing can be drained would spin the event loop
+        if constexpr (std::is_base_of<WQEventFdWake, typename TPolicy::Wake>::value)
+            if (0 == _containerSize || false == drainable)
+                _thWake.Reset();
+        if (false == drainable)
+            return 0;
+    }
+
+    size_t count = _tryBuff.size();
+    Process(_tryBuff);
+    _tryBuff.clear();
+    return count;
 }
 
 
-template <typename TData, typename TDerived>
-size_t WorkQueue<TData, TDerived>::PushFresh(TData &&data)
+template <typename TData, typename TDerived, typename TPolicy>
+template <typename TW>
+int WorkQueue<TData, TDerived, TPolicy>::EventFd() const
 {
-    return PushFresh(data);
+    static_assert(std::is_base_of<WQEventFdWake, TW>::value, "EventFd needs a WQEventFdWake policy");
+    return _thWake.Fd();
 }
 
 
-template <typename TData, typename TDerived>
-void WorkQueue<TData, TDerived>::Run()
+template <typename TData, typename TDerived, typename TPolicy>
+void WorkQueue<TData, TDerived, TPolicy>::Run()
 {
 //    std::cout << "WorkQueue thread : " << _name << " : Entering\n";
+    _workerTid.store(std::this_thread::get_id(), std::memory_order_relaxed);
     static_cast<TDerived*>(this)->Begin();
     Listener();
     static_cast<TDerived*>(this)->End();
@@ -471,10 +1757,11 @@ void WorkQueue<TData, TDerived>::Run()
 }
 
 
-template <typename TData, typename TDerived>
-void* WorkQueue<TData, TDerived>::Listener()
+template <typename TData, typename TDerived, typename TPolicy>
+void* WorkQueue<TData, TDerived, TPolicy>::Listener()
 {
     bool doExit = false;
+    TDrain listBuff;
     for(/*int count = 0*/; true != doExit; /*count++*/)
     {
         switch(GetState())
@@ -482,14 +1769,41 @@ void* WorkQueue<TData, TDerived>::Listener()
             case WQ_QUEUE_STATE::WORKING:
             case WQ_QUEUE_STATE::EXITING_WAIT:
             {
-                std::list<TData> listBuff;
+                listBuff.clear();
+                size_t   retryMax = SIZE_MAX;
+                uint64_t paceNs   = 0;
 
                 {
-                    std::unique_lock<std::mutex> lck{_thLockQue};
-                    _thCond.wait(lck, [this]()   {  return (GetState() == WQ_QUEUE_STATE::EXITING_FORCE) ||
-                                                           (GetState() == WQ_QUEUE_STATE::EXITING_WAIT) ||
-                                                           (_containerSize > 0); });
+                    std::unique_lock<TLock> lck{_thLockQue};
+                    //A PushOrRun caller owns Pop() until it hands it back, whatever the state
+                    auto ready = [this]()   {  return std::thread::id() == _inlineOwner &&
+                                                      ((GetState() == WQ_QUEUE_STATE::EXITING_FORCE) ||
+                                                       (GetState() == WQ_QUEUE_STATE::EXITING_WAIT && false == RetryPending()) ||
+                                                       (_containerSize > 0)); };
+                    //Pending retries bound the sleep, a draining queue still waits out their backoff
+                    if constexpr (HAS_RETRY)
+                    {
+                        if (false == _retry.empty())
+                            _thWake.WaitUntil(lck, _retry.front()._dueNs, ready);
+                        else
+                            _thWake.Wait(lck, ready);
+                    }
+                    else
+                    {
+                        _thWake.Wait(lck, ready);
+                    }
                     //std::cout << "_containerSize : " << _containerSize << std::endl;
+                    _workerBusy.store(true, std::memory_order_relaxed);
+
+                    //Adaptive batching: an underfilled batch may wait a little for more items
+                    if constexpr (HAS_TUNING)
+                    {
+                        if (_tuned && WQ_QUEUE_STATE::WORKING == GetState() && _containerSize > 0 && _containerSize < _tuner.Batch() && 0 != _tuner.LingerNs())
+                        {
+                            _thWake.WaitUntil(lck, WQNowNs() + _tuner.LingerNs(), [this]() { return GetState() != WQ_QUEUE_STATE::WORKING ||
+                                                                                                     _containerSize >= _tuner.Batch(); });
+                        }
+                    }
 
                     switch (GetState())
                     {
@@ -498,36 +1812,52 @@ void* WorkQueue<TData, TDerived>::Listener()
                             break;
 
                         case WQ_QUEUE_STATE::EXITING_WAIT :
-                            if (0 == _containerSize)
+                            if (0 == _containerSize && false == RetryPending())
                             {
                                 doExit = true;
                                 break;
                             }
 
                         default:
-                            while (_containerSize > 0)
+                        {
+                            size_t maxItems = SIZE_MAX;
+                            if constexpr (HAS_TUNING)
+                                maxItems = _tuned ? _tuner.Batch() : SIZE_MAX;
+                            if constexpr (HAS_RATE)
                             {
-                                listBuff.push_back(std::move(_container.back()));
-                                //Pop(&_container.back());
-
-                                _container.pop_back();
-                                _containerSize--;
+                                if (nullptr != _rate)
+                                {
+                                    //Tokens first, the items they do not cover stay queued while the worker waits
+                                    size_t quota = RateQuota(std::min(maxItems, _containerSize + DueRetries()), paceNs);
+                                    retryMax = 0 == quota ? 0 : quota - TakeLocked(listBuff, quota);
+                                    break;
+                                }
                             }
+                            TakeLocked(listBuff, maxItems);
+                        }
                     }
                 }
 
-                for(auto &item : listBuff)
-                {
-                    if (GetState() != WQ_QUEUE_STATE::EXITING_FORCE)
-                        static_cast<TDerived*>(this)->Pop(&item);
-                }
-
+                //Retries that are due run after the fresh batch
+                if (false == doExit)
+                    TakeRetries(listBuff, retryMax);
+                if (0 != paceNs)
+                    Throttle(paceNs);
+
+                uint64_t worstNs = Process(listBuff);
+                if constexpr (HAS_TUNING)
+                    if (_tuned && false == listBuff.empty())
+                        _tuner.Update(listBuff.size(), worstNs);
+                _workerBusy.store(false, std::memory_order_release);
                 break;
             }
 
             case WQ_QUEUE_STATE::PAUSE:
-                clock_nanosleep(CLOCK_MONOTONIC, 0, &GetWaitTime(), NULL);
+            {
+                timespec waitTime = GetWaitTime();
+                clock_nanosleep(CLOCK_MONOTONIC, 0, &waitTime, NULL);
                 break;
+            }
 
             case WQ_QUEUE_STATE::EXITING_FORCE:
                 doExit = true;
@@ -542,6 +1872,35 @@ void* WorkQueue<TData, TDerived>::Listener()
                 break;
         }
     }
+    //Forced exit leaves items behind, nobody will fulfill their futures or run their callbacks
+    TContainer dropped;
+    {
+        //End() must not overlap a Pop() still running on a PushOrRun caller
+        std::unique_lock<TLock> lck{_thLockQue};
+        _thWake.Wait(lck, [this]() { return std::thread::id() == _inlineOwner; });
+        dropped.swap(_container);
+        if constexpr (HAS_CONFLATE)
+            _conflateIndex.clear();
+        _containerSize = 0;
+    }
+    size_t dropCount = dropped.size();
+    if constexpr (HAS_RETRY)
+    {
+        dropCount += _retry.size();
+        for (auto &retry : _retry)
+        {
+            DropItem(retry._item._ctx, retry._item._call);
+            Complete(retry._item);
+        }
+        _retry.clear();
+    }
+    _stats._dropped.fetch_add(dropCount, std::memory_order_relaxed);
+    while (false == dropped.empty())
+    {
+        DropItem(dropped.back()._ctx, dropped.back()._call);
+        Complete(dropped.back());
+        dropped.pop_back();
+    }
     SetState(WQ_QUEUE_STATE::NA);
 
     return NULL;
@@ -591,11 +1950,11 @@ void* WorkQueue<TData, TDerived>::Listener()
  * @tparam TDerived The derived class type (CRTP pattern)
  */
 
-template <typename TData, typename TDerived>
+template <typename TData, typename TDerived, typename TPolicy = WQDefaultPolicy>
 class WorkQueuePool
 {
     private:
-        class WorkQueuePoolItem : public WorkQueue<TData, WorkQueuePoolItem>
+        class WorkQueuePoolItem : public WorkQueue<TData, WorkQueuePoolItem, TPolicy>
         {
             public:
                 void SetPool(TDerived *pool)
@@ -613,12 +1972,18 @@ class WorkQueuePool
                     return _pPool->Begin();
                 }
 
-                int Pop(TData *data)
+                auto Pop(TData *data)
                 {
+                    using TResult = decltype(_pPool->Pop(data));
                     if (nullptr == _pPool)
                     {
                         std::cerr << "ERROR: invalid _pPool" << std::endl;
-                        return -1;
+                        if constexpr (std::is_same<TResult, int>::value)
+                            return -1;
+                        else if constexpr (false == std::is_void<TResult>::value)
+                            return TResult{};
+                        else
+                            return;
                     }
 
                     return _pPool->Pop(data);
@@ -634,6 +1999,23 @@ class WorkQueuePool
 
                     return _pPool->End();
                 }
+
+                void OnExpired(TData *data, WQ_EXPIRE_REASON reason)
+                {
+                    if (nullptr != _pPool)
+                        _pPool->OnExpired(data, reason);
+                }
+
+                void OnDeadLetter(TData *data, int rc, uint32_t attempts)
+                {
+                    if (nullptr != _pPool)
+                        _pPool->OnDeadLetter(data, rc, attempts);
+                }
+
+                bool CanRunInline(const TData *data) const
+                {
+                    return nullptr != _pPool && _pPool->CanRunInline(data);
+                }
             private:
                 TDerived *_pPool = nullptr;
         };
@@ -641,36 +2023,116 @@ class WorkQueuePool
     public :
 
         using WorkQueuePoolList =  std::vector<WorkQueuePoolItem>;
+        using Data              =  TData;
 
         virtual ~WorkQueuePool() = default;
 
         WorkQueuePool(size_t queCount)
             : _queCount(queCount)
+            , _barrier(queCount)
+            , _parked(std::make_unique<std::atomic_bool[]>(queCount))
             , _pool(queCount)
         {
+            //One barrier for all workers, so WaitIdle follows items that Rehome moves between them
+            for (size_t idx = 0; idx < _queCount; ++idx)
+                _pool[idx].ShareBarrier(&_barrier, idx);
         }
 
         int             Init(WQ_QUEUE_STATE state, const std::string &name = "");
         void            Release();
+        int             Release(const timespec &timeout);
+        void            SetState(WQ_QUEUE_STATE state);
+
+        //Barrier on the items pushed to any worker before the call, see WorkQueue::WaitIdle
+        int             WaitIdle(uint64_t timeoutNs = UINT64_MAX);
+        void            Flush()                         { WaitIdle(); }
+
+        //Rate limit of the workers (see WorkQueue::SetRateLimit), one bucket for the whole pool
+        //when shared, otherwise a bucket with the same rate per worker. Call before Init
+        int             SetRateLimit(double ratePerSec, double burst = 1.0, WQ_RATE_UNIT unit = WQ_RATE_UNIT::ITEM, bool shared = true);
+
+        //Same retry lane on every worker, see WorkQueue::SetRetryPolicy. Call before Init
+        int             SetRetryPolicy(const WQRetryPolicy &policy);
+
+        //Same batch tuning on every worker, each tuned on its own, see WorkQueue::SetBatchTuning. Call before Init
+        int             SetBatchTuning(const WQBatchTuning &tuning);
 
         int             PushBack (TData &&data);
         int             PushFront(TData &&data);
 
+        //Whole range to the least loaded worker, see WorkQueue::PushRange. Returns the worker index,
+        //the count it accepted goes to accepted if given
+        template <typename TIter>
+        int             PushRange(TIter first, TIter last, size_t *accepted = nullptr);
+
+        //Key-affine: a key always lands on the same worker, so its pending item can be replaced there
+        int             PushConflate(uint64_t key, TData &&data);
+        int             PushConflate(uint64_t key, const TData &data);
+
+        //Least loaded worker, see WorkQueue::PushExpiring
+        int             PushExpiring(TData &&data, const WQItemLimit &limit);
+
+        //Least loaded worker, popped on the calling thread when it is idle, see WorkQueue::PushOrRun
+        int             PushOrRun(TData &&data);
+
+        //Default hooks for discarded PushExpiring items and dead lettered items, hidden by TDerived
+        void            OnExpired(TData * /*data*/, WQ_EXPIRE_REASON /*reason*/)  {}
+        void            OnDeadLetter(TData * /*data*/, int /*rc*/, uint32_t /*attempts*/) {}
+        //Default hook for PushOrRun, nothing runs off the workers unless hidden by TDerived
+        bool            CanRunInline(const TData * /*data*/) const  { return false; }
+
+        template <typename TD = TDerived>
+        WQFuture<decltype(std::declval<TD&>().Pop(std::declval<TData*>()))> Submit(const TData &data);
+
+        //co_await pool.Schedule() hops onto the least loaded worker, Schedule(idx) onto a given one
+        WQScheduleAwaiter<WorkQueue<TData, WorkQueuePoolItem, TPolicy>>  Schedule();
+        WQScheduleAwaiter<WorkQueue<TData, WorkQueuePoolItem, TPolicy>>  Schedule(size_t idx);
+
+        //Runs fn(idx) for every idx in [begin, end) on the pool workers and the calling thread,
+        //returns once all of them ran. grain is the smallest chunk handed to one participant
+        template <typename F>
+        int             ParallelFor(size_t begin, size_t end, F &&fn, size_t grain = 1);
+
+        //Folds op(acc, idx) over [begin, end) into per-participant partials seeded with identity,
+        //then combines them with join. join must be associative and commutative (as for std::reduce)
+        template <typename T, typename FOp, typename FJoin = std::plus<>>
+        T               ParallelReduce(size_t begin, size_t end, T identity, FOp &&op, FJoin &&join = FJoin(), size_t grain = 1);
+
         size_t          QueCount() const;
         size_t          Size(std::vector<int> &sizeList);
 
+        const std::string&      Name() const                    { return _name;             }
+        const std::string&      QueName (size_t idx) const      { return _pool[idx].Name(); }
+        size_t                  QueSize (size_t idx) const      { return _pool[idx].Size(); }
+        const WorkQueueStats&   QueStats(size_t idx) const      { return _pool[idx].Stats();}
+        uint64_t                QuePopRunningNs(size_t idx) const { return _pool[idx].PopRunningNs(); }
+        const WQBatchTuner&     QueBatchTuner(size_t idx) const { return _pool[idx].BatchTuner(); }
+
+        //Moves the pending data items of worker `from` to the workers in `to` (every other one when
+        //empty), e.g. while `from` hangs in Pop. Returns the count moved, see WorkQueue::MovePending
+        size_t          Rehome(size_t from, const std::vector<size_t> &to = {});
+        //A parked worker gets no new items from the least loaded routing (PushBack, Submit, Schedule()...)
+        //unless every worker is parked; key-affine PushConflate and Schedule(idx) still reach it
+        void            ParkQue(size_t idx, bool parked)    { _parked[idx].store(parked, std::memory_order_relaxed); }
+        bool            QueParked(size_t idx) const         { return _parked[idx].load(std::memory_order_relaxed); }
+
     private :
         int             MaxIdx();
         int             MinIdx();
 
+        template <typename TBody>
+        void            RunParallel(size_t begin, size_t end, size_t grain, TBody &&body);
+
         std::string         _name;
         size_t              _queCount = 16;
+        WQBarrier<TPolicy::Align> _barrier;     // outlives the workers, their items leave through it
+        std::unique_ptr<std::atomic_bool[]> _parked;
         WorkQueuePoolList   _pool;
 };
 
 
-template <typename TData, typename TDerived>
-int WorkQueuePool<TData, TDerived>::Init(WQ_QUEUE_STATE state, const std::string &name /*= ""*/)
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueuePool<TData, TDerived, TPolicy>::Init(WQ_QUEUE_STATE state, const std::string &name /*= ""*/)
 {
     _name       = name;
 
@@ -683,15 +2145,88 @@ int WorkQueuePool<TData, TDerived>::Init(WQ_QUEUE_STATE state, const std::string
 }
 
 
-template <typename TData, typename TDerived>
-void WorkQueuePool<TData, TDerived>::Release()
+template <typename TData, typename TDerived, typename TPolicy>
+void WorkQueuePool<TData, TDerived, TPolicy>::Release()
 {
     for (size_t idx = 0; idx < _queCount; ++idx)
         _pool[idx].Release();
 }
 
-template <typename TData, typename TDerived>
-int WorkQueuePool<TData, TDerived>::MaxIdx()
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueuePool<TData, TDerived, TPolicy>::Release(const timespec &timeout)
+{
+    SetState(WQ_QUEUE_STATE::EXITING_WAIT);
+    int ret = WaitIdle(uint64_t(TimespecToNs(timeout)));
+    for (size_t idx = 0; idx < _queCount; ++idx)
+        _pool[idx].Release(0 != ret);
+    return ret;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueuePool<TData, TDerived, TPolicy>::WaitIdle(uint64_t timeoutNs /*= UINT64_MAX*/)
+{
+    uint64_t now = WQNowNs();
+    return _barrier.Wait(timeoutNs > UINT64_MAX - now ? UINT64_MAX : now + timeoutNs);
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueuePool<TData, TDerived, TPolicy>::SetRateLimit(double ratePerSec, double burst /*= 1.0*/, WQ_RATE_UNIT unit /*= WQ_RATE_UNIT::ITEM*/, bool shared /*= true*/)
+{
+    auto bucket = std::make_shared<WQTokenBucket>(ratePerSec, burst);
+    for (size_t idx = 0; idx < _queCount; ++idx)
+        if (0 != _pool[idx].SetRateLimit(shared ? bucket : std::make_shared<WQTokenBucket>(ratePerSec, burst), unit))
+            return -1;
+    return 0;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueuePool<TData, TDerived, TPolicy>::SetRetryPolicy(const WQRetryPolicy &policy)
+{
+    for (size_t idx = 0; idx < _queCount; ++idx)
+        if (0 != _pool[idx].SetRetryPolicy(policy))
+            return -1;
+    return 0;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueuePool<TData, TDerived, TPolicy>::SetBatchTuning(const WQBatchTuning &tuning)
+{
+    for (size_t idx = 0; idx < _queCount; ++idx)
+        if (0 != _pool[idx].SetBatchTuning(tuning))
+            return -1;
+    return 0;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueuePool<TData, TDerived, TPolicy>::Rehome(size_t from, const std::vector<size_t> &to /*= {}*/)
+{
+    std::vector<WorkQueue<TData, WorkQueuePoolItem, TPolicy> *> targets;
+    for (size_t idx = 0; idx < _queCount; ++idx)
+        if (idx != from && (to.empty() || to.end() != std::find(to.begin(), to.end(), idx)))
+            targets.push_back(&_pool[idx]);
+
+    if (from >= _queCount)
+        return 0;
+    return _pool[from].MovePending(targets.data(), targets.size());
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+void WorkQueuePool<TData, TDerived, TPolicy>::SetState(WQ_QUEUE_STATE state)
+{
+    for (size_t idx = 0; idx < _queCount; ++idx)
+        _pool[idx].SetState(state);
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueuePool<TData, TDerived, TPolicy>::MaxIdx()
 {
     size_t  sizeMax = 0;
     size_t  idxMax  = (size_t)-1;
@@ -708,19 +2243,22 @@ int WorkQueuePool<TData, TDerived>::MaxIdx()
     return idxMax;
 }
 
-template <typename TData, typename TDerived>
-int WorkQueuePool<TData, TDerived>::MinIdx()
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueuePool<TData, TDerived, TPolicy>::MinIdx()
 {
     size_t  sizeMin = (size_t)-1;
     size_t  idxMin  = (size_t)-1;
+    bool    parkMin = true;     // a parked worker is only picked while no other one is found
 
     for (size_t idx = 0; idx < _queCount; ++idx)
     {
-        size_t size = _pool[idx].Size();
-        if (size < sizeMin)
+        size_t size   = _pool[idx].Size();
+        bool   parked = QueParked(idx);
+        if ((parkMin && false == parked) || (parked == parkMin && size < sizeMin))
         {
             sizeMin = size;
             idxMin  = idx;
+            parkMin = parked;
         }
     }
 
@@ -728,15 +2266,15 @@ int WorkQueuePool<TData, TDerived>::MinIdx()
 }
 
 
-template <typename TData, typename TDerived>
-size_t WorkQueuePool<TData, TDerived>::QueCount() const
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueuePool<TData, TDerived, TPolicy>::QueCount() const
 {
     return  _queCount;
 }
 
 
-template <typename TData, typename TDerived>
-size_t WorkQueuePool<TData, TDerived>::Size(std::vector<int> &sizeList)
+template <typename TData, typename TDerived, typename TPolicy>
+size_t WorkQueuePool<TData, TDerived, TPolicy>::Size(std::vector<int> &sizeList)
 {
     size_t sum = 0;
     for (size_t idx = 0; idx < _queCount; ++idx)
@@ -749,8 +2287,8 @@ size_t WorkQueuePool<TData, TDerived>::Size(std::vector<int> &sizeList)
 }
 
 
-template <typename TData, typename TDerived>
-int WorkQueuePool<TData, TDerived>::PushBack (TData &&data)
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueuePool<TData, TDerived, TPolicy>::PushBack (TData &&data)
 {
     int idx = MinIdx();
     if (idx > -1)
@@ -760,8 +2298,61 @@ int WorkQueuePool<TData, TDerived>::PushBack (TData &&data)
 }
 
 
-template <typename TData, typename TDerived>
-int WorkQueuePool<TData, TDerived>::PushFront(TData &&data)
+template <typename TData, typename TDerived, typename TPolicy>
+template <typename TIter>
+int WorkQueuePool<TData, TDerived, TPolicy>::PushRange(TIter first, TIter last, size_t *accepted /*= nullptr*/)
+{
+    int    idx   = MinIdx();
+    size_t count = (idx > -1) ? _pool[idx].PushRange(first, last) : 0;
+    if (nullptr != accepted)
+        *accepted = count;
+
+    return idx;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueuePool<TData, TDerived, TPolicy>::PushExpiring(TData &&data, const WQItemLimit &limit)
+{
+    int idx = MinIdx();
+    if (idx > -1)
+        _pool[idx].PushExpiring(std::move(data), limit);
+
+    return idx;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueuePool<TData, TDerived, TPolicy>::PushOrRun(TData &&data)
+{
+    int idx = MinIdx();
+    if (idx > -1)
+        _pool[idx].PushOrRun(std::move(data));
+
+    return idx;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueuePool<TData, TDerived, TPolicy>::PushConflate(uint64_t key, TData &&data)
+{
+    size_t idx = key % _queCount;
+    _pool[idx].PushConflate(key, std::move(data));
+    return int(idx);
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueuePool<TData, TDerived, TPolicy>::PushConflate(uint64_t key, const TData &data)
+{
+    size_t idx = key % _queCount;
+    _pool[idx].PushConflate(key, data);
+    return int(idx);
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+int WorkQueuePool<TData, TDerived, TPolicy>::PushFront(TData &&data)
 {
     int idx = MinIdx();
     if (idx > -1)
@@ -771,6 +2362,115 @@ int WorkQueuePool<TData, TDerived>::PushFront(TData &&data)
 }
 
 
+template <typename TData, typename TDerived, typename TPolicy>
+template <typename TD>
+WQFuture<decltype(std::declval<TD&>().Pop(std::declval<TData*>()))> WorkQueuePool<TData, TDerived, TPolicy>::Submit(const TData &data)
+{
+    int idx = MinIdx();
+    if (idx < 0)
+        return {};
+
+    return _pool[idx].Submit(data);
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+WQScheduleAwaiter<WorkQueue<TData, typename WorkQueuePool<TData, TDerived, TPolicy>::WorkQueuePoolItem, TPolicy>> WorkQueuePool<TData, TDerived, TPolicy>::Schedule()
+{
+    int idx = MinIdx();
+    if (idx < 0)
+        return {nullptr, WQ_PUSH_OP::BACK};
+
+    return _pool[idx].Schedule();
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+WQScheduleAwaiter<WorkQueue<TData, typename WorkQueuePool<TData, TDerived, TPolicy>::WorkQueuePoolItem, TPolicy>> WorkQueuePool<TData, TDerived, TPolicy>::Schedule(size_t idx)
+{
+    if (idx >= _queCount)
+        return {nullptr, WQ_PUSH_OP::BACK};
+
+    return _pool[idx].Schedule();
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+template <typename TBody>
+void WorkQueuePool<TData, TDerived, TPolicy>::RunParallel(size_t begin, size_t end, size_t grain, TBody &&body)
+{
+    if (begin >= end)
+        return;
+
+    //Too small to split: no helpers, no job allocation
+    grain = std::max<size_t>(grain, 1);
+    if (end - begin <= grain || 0 == _queCount)
+    {
+        body(begin, end, 0);
+        return;
+    }
+
+    using TJob = WQParallelJob<std::decay_t<TBody>>;
+    TJob *job = new TJob(begin, end, grain, _queCount + 1, std::forward<TBody>(body));
+
+    //One helper each to the least loaded workers, as MinIdx picks them, parked ones (see ParkQue) get none
+    std::vector<std::pair<size_t, size_t>> workers;     // size, index
+    workers.reserve(_queCount);
+    for (size_t idx = 0; idx < _queCount; ++idx)
+        if (false == QueParked(idx))
+            workers.emplace_back(_pool[idx].Size(), idx);
+
+    size_t helpers = std::min(workers.size(), (end - begin + grain - 1) / grain - 1);
+    std::partial_sort(workers.begin(), workers.begin() + helpers, workers.end());
+    for (size_t cnt = 0; cnt < helpers; ++cnt)
+    {
+        job->AddRef();
+        if (0 != _pool[workers[cnt].second].PushCall(&TJob::Helper, job))
+            job->Release();
+    }
+
+    //The caller works too, so a busy (or paused) pool never stalls the call
+    job->Work(0);
+    job->Wait();
+    job->Release();
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+template <typename F>
+int WorkQueuePool<TData, TDerived, TPolicy>::ParallelFor(size_t begin, size_t end, F &&fn, size_t grain /*= 1*/)
+{
+    RunParallel(begin, end, grain, [&fn](size_t first, size_t last, size_t)
+    {
+        for (size_t idx = first; idx < last; ++idx)
+            fn(idx);
+    });
+    return 0;
+}
+
+
+template <typename TData, typename TDerived, typename TPolicy>
+template <typename T, typename FOp, typename FJoin>
+T WorkQueuePool<TData, TDerived, TPolicy>::ParallelReduce(size_t begin, size_t end, T identity, FOp &&op, FJoin &&join /*= FJoin()*/, size_t grain /*= 1*/)
+{
+    //One partial per participant on its own cache line, accumulated locally per chunk
+    struct alignas(WQ_CACHE_LINE) Partial { T _value; };
+    std::vector<Partial> partials(_queCount + 1, Partial{identity});
+    RunParallel(begin, end, grain, [&op, &partials](size_t first, size_t last, size_t slot)
+    {
+        T acc = std::move(partials[slot]._value);
+        for (size_t idx = first; idx < last; ++idx)
+            acc = op(std::move(acc), idx);
+        partials[slot]._value = std::move(acc);
+    });
+
+    T result = std::move(identity);
+    for (auto &partial : partials)
+        result = join(std::move(result), std::move(partial._value));
+    return result;
+}
+
+
 
 
 #endif // __WORK_QUEUE_H__
@@ -0,0 +1,156 @@
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_BARRIER_H__
+#define __WORK_QUEUE_BARRIER_H__
+
+#include "Futex.h"
+#include "TimeFrame.h"
+#include "WorkQueueLayout.h"
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+
+/**
+ * @brief Epoch barrier behind WorkQueue::WaitIdle: waits for exactly the items pushed before the call.
+ *
+ * A push counts its item into the current epoch and keeps the returned counter;
+ * the item leaves through that counter once it completes (popped, dropped,
+ * expired or dead lettered), wherever and whenever that happens: behind a later
+ * PushFront, after a stay in the retry lane, or on another queue sharing the
+ * barrier (WorkQueuePool::Rehome). Wait() opens a new epoch for later pushes and
+ * returns once every older epoch is empty, so later items neither satisfy nor
+ * extend it.
+ *
+ * Counters come in shards, one per queue of a pool, so pushes to different
+ * workers do not share a line; within a shard the producer and the completion
+ * counters sit on lines of their own. At most SLOTS epochs are live: a waiter
+ * that has to open one more first waits for the oldest, which it needs anyway.
+ *
+ * @tparam TAlign Alignment of the counter lines (WQPolicy::Align)
+ */
+template <size_t TAlign = WQ_CACHE_LINE>
+class WQBarrier
+{
+    public:
+        static constexpr size_t SLOTS = 8;
+
+        explicit WQBarrier(size_t shards = 1)
+            : _shards(std::make_unique<Shard[]>(shards))
+            , _shardCount(shards)
+        {
+        }
+
+        WQBarrier(const WQBarrier &) = delete;
+        WQBarrier &operator=(const WQBarrier &) = delete;
+
+        //Counts count items of a push into the current epoch, returns the counter they leave through
+        std::atomic<uint64_t>  *Enter(size_t shard, uint64_t count = 1)
+        {
+            Shard   &sh  = _shards[shard];
+            uint64_t idx = _epoch.load(std::memory_order_acquire) % SLOTS;
+            sh._entered[idx].fetch_add(count, std::memory_order_relaxed);
+            return &sh._left[idx];
+        }
+
+        void                    Leave(std::atomic<uint64_t> *left, uint64_t count = 1)
+        {
+            //Pairs with Wait: either the waiter sees the count or we see the waiter
+            left->fetch_add(count);
+            if (0 != _waiters.load())
+            {
+                _seq.fetch_add(1);
+                FutexWake(_seq);
+            }
+        }
+
+        //0 once every item that entered before the call left, -1 if deadlineNs (CLOCK_MONOTONIC) passed first
+        int                     Wait(uint64_t deadlineNs);
+
+    private:
+        struct Shard
+        {
+            alignas(TAlign) std::atomic<uint64_t>   _entered[SLOTS] {};    // producers
+            alignas(TAlign) std::atomic<uint64_t>   _left[SLOTS]    {};    // whoever completes the items
+        };
+
+        bool                    SlotDrained(size_t idx) const;
+        bool                    DrainedUpTo(uint64_t epoch) const;
+
+        std::unique_ptr<Shard[]>    _shards;
+        size_t                      _shardCount;
+
+        //Read by every push and every completion, written by waiters only
+        alignas(TAlign) std::atomic<uint64_t>   _epoch   {0};
+        std::atomic<uint32_t>                   _waiters {0};
+        std::atomic<uint32_t>                   _seq     {0};       // futex word of Wait
+};
+
+
+template <size_t TAlign>
+bool WQBarrier<TAlign>::SlotDrained(size_t idx) const
+{
+    //Entered first: a completion always follows its push, so left >= that snapshot means empty
+    for (size_t shard = 0; shard < _shardCount; ++shard)
+    {
+        uint64_t entered = _shards[shard]._entered[idx].load();
+        if (_shards[shard]._left[idx].load() < entered)
+            return false;
+    }
+    return true;
+}
+
+
+template <size_t TAlign>
+bool WQBarrier<TAlign>::DrainedUpTo(uint64_t epoch) const
+{
+    //Epochs older than SLOTS back share a slot with a newer one, that could only open once they drained
+    for (uint64_t num = (epoch + 1 >= SLOTS ? epoch + 1 - SLOTS : 0); num <= epoch; ++num)
+        if (_epoch.load() < num + SLOTS && false == SlotDrained(num % SLOTS))
+            return false;
+    return true;
+}
+
+
+template <size_t TAlign>
+int WQBarrier<TAlign>::Wait(uint64_t deadlineNs)
+{
+    int ret = 0;
+    _waiters.fetch_add(1);
+    uint64_t epoch = _epoch.load();
+    for (;;)
+    {
+        uint32_t seq = _seq.load();
+
+        //Later pushes go to the next epoch, whose slot must first be rid of the epoch SLOTS back
+        uint64_t cur = epoch;
+        if (_epoch.load() == epoch && SlotDrained((epoch + 1) % SLOTS))
+            _epoch.compare_exchange_strong(cur, epoch + 1);
+        if (_epoch.load() > epoch && DrainedUpTo(epoch))
+            break;
+
+        uint64_t now = ClockMonotonic::Now();
+        if (now >= deadlineNs)
+        {
+            ret = -1;
+            break;
+        }
+
+        timespec left = TimespecFromNs(deadlineNs - now);
+        FutexWait(_seq, seq, UINT64_MAX == deadlineNs ? nullptr : &left);
+    }
+    _waiters.fetch_sub(1, std::memory_order_relaxed);
+    return ret;
+}
+
+
+
+
+#endif // __WORK_QUEUE_BARRIER_H__
+
+// clang-format on
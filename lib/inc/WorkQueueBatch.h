@@ -0,0 +1,223 @@
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_BATCH_H__
+#define __WORK_QUEUE_BATCH_H__
+
+#include "WorkQueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+
+
+
+
+/**
+ * @brief Something a WQLingerFlusher can flush, see WQBatchProducer.
+ */
+class WQLingerTarget
+{
+    public:
+        virtual ~WQLingerTarget() = default;
+        virtual void    FlushLingered(uint64_t nowNs) = 0;
+};
+
+
+/**
+ * @brief TickThread that flushes the WQBatchProducer buffers whose oldest item waited
+ * longer than their linger time.
+ *
+ * One flusher serves any number of producers; the tick interval bounds how late a
+ * lingering buffer may be flushed on top of its linger time.
+ */
+class WQLingerFlusher : public TickThread<WQLingerFlusher>
+{
+    public:
+        ~WQLingerFlusher()                                  { Release(); }
+
+        int     Init(uint64_t intervalNs = US_TO_NS(100))
+        {
+            SetInterval(intervalNs);
+            Start();
+            return 0;
+        }
+        void    Release()                                   { Stop(); }
+
+        void    Add(WQLingerTarget *target)
+        {
+            std::lock_guard<std::mutex> lck{_lock};
+            _targets.push_back(target);
+        }
+
+        void    Remove(WQLingerTarget *target)
+        {
+            std::lock_guard<std::mutex> lck{_lock};
+            _targets.erase(std::remove(_targets.begin(), _targets.end(), target), _targets.end());
+        }
+
+        //From TickThread
+        bool    OnBegin()                                   { return true; }
+        void    OnEnd()                                     {}
+        void    Tick()
+        {
+            uint64_t now = WQNowNs();
+            std::lock_guard<std::mutex> lck{_lock};
+            for (WQLingerTarget *target : _targets)
+                target->FlushLingered(now);
+        }
+
+    private:
+        std::mutex                      _lock;
+        std::vector<WQLingerTarget *>   _targets;
+};
+
+
+/**
+ * @brief Producer side combining buffer in front of a WorkQueue or WorkQueuePool.
+ *
+ * Each producer thread owns its own WQBatchProducer. Push() only appends to the
+ * local buffer; the buffer goes to the queue with a single PushRange() (one lock
+ * acquisition, one wake-up) once it holds `batch` items, once its oldest item is
+ * `lingerNs` old (checked by an optional WQLingerFlusher), or on Flush(). Items of
+ * one producer keep their order. The price is up to lingerNs (plus the flusher
+ * tick) of extra queueing latency; without a flusher the buffer only leaves on
+ * size or Flush(), and on destruction.
+ *
+ * Usage example:
+ * @code
+ * WQLingerFlusher flusher;
+ * flusher.Init(US_TO_NS(50));
+ *
+ * // on each producer thread
+ * WQBatchProducer<MyQueue> producer(que, 128, US_TO_NS(200), &flusher);
+ * producer.Push(msg);
+ * @endcode
+ *
+ * @tparam TQueue WorkQueue or WorkQueuePool (anything with Data and PushRange)
+ */
+template <typename TQueue>
+class WQBatchProducer : public WQLingerTarget
+{
+    public:
+        using TData = typename TQueue::Data;
+
+        WQBatchProducer(TQueue &que, size_t batch = 64, uint64_t lingerNs = US_TO_NS(100), WQLingerFlusher *flusher = nullptr)
+            : _que(que)
+            , _batch(std::max<size_t>(batch, 1))
+            , _lingerNs(lingerNs)
+            , _flusher(flusher)
+        {
+            _buffer.reserve(_batch);
+            if (nullptr != _flusher)
+                _flusher->Add(this);
+        }
+
+        ~WQBatchProducer()
+        {
+            if (nullptr != _flusher)
+                _flusher->Remove(this);
+            Flush();
+        }
+
+        WQBatchProducer(const WQBatchProducer &) = delete;
+        WQBatchProducer &operator=(const WQBatchProducer &) = delete;
+
+        void        Push(TData &&data)                      { Append(std::move(data)); }
+        void        Push(const TData &data)                 { Append(data);            }
+
+        //Hands the buffered items to the queue now, returns the count it accepted. The queue drops
+        //the rest (see PushRange), they are counted in Dropped() and leave the buffer all the same
+        size_t      Flush()
+        {
+            std::lock_guard<WQSpinLock> lck{_lock};
+            return FlushLocked();
+        }
+
+        size_t      Buffered() const                        { return _buffered.load(std::memory_order_relaxed); }
+        uint64_t    Flushes() const                         { return _flushes.load(std::memory_order_relaxed);  }
+        uint64_t    Dropped() const                         { return _dropped.load(std::memory_order_relaxed);  }
+
+        //From WQLingerTarget, runs on the flusher thread
+        void        FlushLingered(uint64_t nowNs) override
+        {
+            uint64_t first = _firstNs.load(std::memory_order_acquire);
+            if (0 == first || nowNs - first < _lingerNs)
+                return;
+
+            //The owner is pushing right now, it will flush on size or the next tick catches it
+            if (false == _lock.try_lock())
+                return;
+            FlushLocked();
+            _lock.unlock();
+        }
+
+    private:
+        template <typename TArg>
+        void        Append(TArg &&data)
+        {
+            std::lock_guard<WQSpinLock> lck{_lock};
+            if (_buffer.empty())
+                _firstNs.store(WQNowNs(), std::memory_order_release);
+            _buffer.push_back(std::forward<TArg>(data));
+            _buffered.store(_buffer.size(), std::memory_order_relaxed);
+
+            if (_buffer.size() >= _batch)
+                FlushLocked();
+        }
+
+        size_t      FlushLocked()
+        {
+            if (_buffer.empty())
+                return 0;
+
+            size_t accepted = PushBuffer();
+            if (accepted < _buffer.size())
+                _dropped.fetch_add(_buffer.size() - accepted, std::memory_order_relaxed);
+            _buffer.clear();
+            _firstNs.store(0, std::memory_order_relaxed);
+            _buffered.store(0, std::memory_order_relaxed);
+            _flushes.fetch_add(1, std::memory_order_relaxed);
+            return accepted;
+        }
+
+        //WorkQueue::PushRange returns the count it accepted, WorkQueuePool::PushRange the worker index
+        size_t      PushBuffer()
+        {
+            auto first = std::make_move_iterator(_buffer.begin());
+            auto last  = std::make_move_iterator(_buffer.end());
+            if constexpr (std::is_same<decltype(_que.PushRange(first, last)), int>::value)
+            {
+                size_t accepted = 0;
+                _que.PushRange(first, last, &accepted);
+                return accepted;
+            }
+            else
+            {
+                return _que.PushRange(first, last);
+            }
+        }
+
+        TQueue                 &_que;
+        const size_t            _batch;
+        const uint64_t          _lingerNs;
+        WQLingerFlusher        *_flusher;
+
+        WQSpinLock              _lock;          // owner vs flusher, uncontended on the push path
+        std::vector<TData>      _buffer;
+        std::atomic<uint64_t>   _firstNs  {0};  // WQNowNs() of the oldest buffered item, 0 when empty
+        std::atomic<size_t>     _buffered {0};
+        std::atomic<uint64_t>   _flushes  {0};
+        std::atomic<uint64_t>   _dropped  {0};  // flushed items the queue did not accept
+};
+
+
+
+
+#endif // __WORK_QUEUE_BATCH_H__
+
+// clang-format on
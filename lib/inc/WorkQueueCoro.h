@@ -0,0 +1,161 @@
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_CORO_H__
+#define __WORK_QUEUE_CORO_H__
+
+#include <stdint.h>
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#include <exception>
+#endif
+
+
+
+
+//Plain callback carried by a queued item or a TickThread timer.
+//cancelled is true when the item is dropped instead of dispatched.
+using WQCallFn = void (*)(void *ctx, bool cancelled);
+
+enum class WQ_PUSH_OP;
+
+
+
+
+/**
+ * @brief Common part of the WorkQueue / TickThread awaiters.
+ *
+ * The coroutine frame address is handed to the queue as the ctx of a
+ * (WQCallFn, ctx) item, so suspending costs no allocation. Nothing in the
+ * awaiter is touched once it is queued: the frame may already be resumed on
+ * another thread, and the outcome reaches await_resume() through a thread-local
+ * set by the resuming thread right before resume().
+ *
+ * The handle type is only known at the co_await site, await_suspend is a template
+ * and the header stays usable from C++17 translation units.
+ *
+ * await_resume() returns false when the coroutine was resumed without reaching
+ * its target: rejected by a queue that is not WORKING (resumed inline), dropped
+ * by PushFresh / a forced Release (resumed on the dropping thread) or a timer
+ * cancelled by TickThread::Stop (resumed on the tick thread).
+ */
+class WQAwaiterBase
+{
+    public:
+        bool        await_ready() const noexcept    { return false;         }
+        bool        await_resume() const noexcept   { return !Cancelled();  }
+
+    protected:
+        template <typename THandle>
+        static void Resume(void *ctx, bool cancelled)
+        {
+            Cancelled() = cancelled;
+            THandle::from_address(ctx).resume();
+        }
+
+        static bool &Cancelled()
+        {
+            static thread_local bool cancelled = false;
+            return cancelled;
+        }
+};
+
+
+/**
+ * @brief Awaiter returned by WorkQueue::Schedule(), resumes the coroutine in Listener.
+ */
+template <typename TQueue>
+class WQScheduleAwaiter : public WQAwaiterBase
+{
+    public:
+        WQScheduleAwaiter(TQueue *queue, WQ_PUSH_OP op) : _queue(queue), _op(op) {}
+
+        template <typename THandle>
+        bool await_suspend(THandle handle)
+        {
+            //Once queued the frame may be resumed (and gone) before PushCall returns
+            if (nullptr != _queue && 0 == _queue->PushCall(&Resume<THandle>, handle.address(), _op))
+                return true;
+
+            Cancelled() = true;
+            return false;
+        }
+
+    private:
+        TQueue     *_queue;
+        WQ_PUSH_OP  _op;
+};
+
+
+/**
+ * @brief Awaiter returned by TickThread::After(), resumes the coroutine on the tick thread.
+ */
+template <typename TTicker>
+class WQTimerAwaiter : public WQAwaiterBase
+{
+    public:
+        WQTimerAwaiter(TTicker *ticker, uint64_t ns) : _ticker(ticker), _ns(ns) {}
+
+        template <typename THandle>
+        bool await_suspend(THandle handle)
+        {
+            if (0 == _ticker->AddTimer(_ns, &Resume<THandle>, handle.address()))
+                return true;
+
+            Cancelled() = true;
+            return false;
+        }
+
+    private:
+        TTicker    *_ticker;
+        uint64_t    _ns;
+};
+
+
+
+
+#if defined(__cpp_impl_coroutine)
+
+/**
+ * @brief Fire-and-forget coroutine type for handlers driven by the awaiters above.
+ *
+ * Starts eagerly on the calling thread and frees its frame when it runs to
+ * completion. Exceptions escaping the body terminate the process.
+ *
+ * Bind the co_await result to a local before testing it, g++ 12 miscompiles
+ * co_await used directly in an if condition.
+ *
+ * Usage example:
+ * @code
+ * WQDetachedTask Handle(MyQueue &que, MyTicker &tick)
+ * {
+ *     bool ok = co_await que.Schedule();
+ *     if (false == ok)
+ *         co_return;
+ *     // runs on que's worker thread
+ *     co_await tick.After(MS_TO_NS(10));
+ *     // runs on tick's thread
+ * }
+ * @endcode
+ */
+struct WQDetachedTask
+{
+    struct promise_type
+    {
+        WQDetachedTask          get_return_object() noexcept    { return {};    }
+        std::suspend_never      initial_suspend() noexcept      { return {};    }
+        std::suspend_never      final_suspend() noexcept        { return {};    }
+        void                    return_void() noexcept          {               }
+        void                    unhandled_exception() noexcept  { std::terminate(); }
+    };
+};
+
+#endif // __cpp_impl_coroutine
+
+
+
+
+#endif // __WORK_QUEUE_CORO_H__
+
+// clang-format on
@@ -0,0 +1,126 @@
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_EXPIRY_H__
+#define __WORK_QUEUE_EXPIRY_H__
+
+#include "WorkQueueStats.h"
+
+#include <atomic>
+#include <utility>
+#include <stdint.h>
+
+
+
+
+enum class WQ_EXPIRE_REASON
+{
+    NONE        = 0,
+    DEADLINE    = 1,    // the item's deadline passed before the worker reached it
+    CANCELLED   = 2,    // the item's WQCancelToken was cancelled
+};
+
+
+inline const char *WQ_EXPIRE_REASON_text(WQ_EXPIRE_REASON reason)
+{
+    switch (reason)
+    {
+        case WQ_EXPIRE_REASON::NONE      : return "NONE";
+        case WQ_EXPIRE_REASON::DEADLINE  : return "DEADLINE";
+        case WQ_EXPIRE_REASON::CANCELLED : return "CANCELLED";
+    }
+    return "UNKNOWN";
+}
+
+
+/**
+ * @brief Shared cancellation flag for any number of queued items.
+ *
+ * A default constructed token is empty and never cancelled; Create() makes a live
+ * one. Copies share the flag, so attaching one token to every item of a request
+ * and calling Cancel() once discards all of them that are still pending, in O(1).
+ * The flag is reference counted intrusively to keep a queued item one pointer wide.
+ */
+class WQCancelToken
+{
+    public:
+        WQCancelToken() = default;
+        ~WQCancelToken()                                    { Reset(); }
+
+        WQCancelToken(const WQCancelToken &other)           : _state(other._state)  { AddRef(); }
+        WQCancelToken(WQCancelToken &&other) noexcept       : _state(other._state)  { other._state = nullptr; }
+        WQCancelToken& operator = (const WQCancelToken &other)
+        {
+            if (_state != other._state)
+            {
+                Reset();
+                _state = other._state;
+                AddRef();
+            }
+            return *this;
+        }
+        WQCancelToken& operator = (WQCancelToken &&other) noexcept
+        {
+            if (this != &other)
+            {
+                Reset();
+                _state = std::exchange(other._state, nullptr);
+            }
+            return *this;
+        }
+
+        static WQCancelToken Create()                       { WQCancelToken token; token._state = new State; return token; }
+
+        void        Cancel() const                          { if (_state) _state->_cancelled.store(true, std::memory_order_release);        }
+        bool        IsCancelled() const                     { return _state && _state->_cancelled.load(std::memory_order_acquire);          }
+        explicit    operator bool() const                   { return nullptr != _state; }
+
+    private:
+        struct State
+        {
+            std::atomic<bool>       _cancelled {false};
+            std::atomic<uint32_t>   _refs      {1};
+        };
+
+        void        AddRef()                                { if (_state) _state->_refs.fetch_add(1, std::memory_order_relaxed);            }
+        void        Reset()
+        {
+            if (_state && 1 == _state->_refs.fetch_sub(1, std::memory_order_acq_rel))
+                delete _state;
+            _state = nullptr;
+        }
+
+        State      *_state = nullptr;
+};
+
+
+/**
+ * @brief Deadline and cancellation token of a pushed item, see WorkQueue::PushExpiring.
+ */
+struct WQItemLimit
+{
+    uint64_t        _deadlineNs = 0;    // WQNowNs() clock, 0 never expires
+    WQCancelToken   _token;             // empty is not cancellable
+
+    static WQItemLimit  Ttl(uint64_t ttlNs, WQCancelToken token = WQCancelToken())
+    {
+        return WQItemLimit{WQNowNs() + ttlNs, std::move(token)};
+    }
+
+    static WQItemLimit  Deadline(uint64_t deadlineNs, WQCancelToken token = WQCancelToken())
+    {
+        return WQItemLimit{deadlineNs, std::move(token)};
+    }
+
+    static WQItemLimit  Token(WQCancelToken token)
+    {
+        return WQItemLimit{0, std::move(token)};
+    }
+};
+
+
+
+
+#endif // __WORK_QUEUE_EXPIRY_H__
+
+// clang-format on
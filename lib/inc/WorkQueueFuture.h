@@ -0,0 +1,394 @@
+
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_FUTURE_H__
+#define __WORK_QUEUE_FUTURE_H__
+
+#include "Futex.h"
+#include "TimeFrame.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <stdint.h>
+
+
+
+
+template <typename R> class WQFutureSlab;
+
+
+/**
+ * @brief Shared state between a WQFuture and the queued item that fulfills it.
+ *
+ * States come from a per-R WQFutureSlab, so creating one costs a lock-free pop
+ * from a free list instead of an allocation. Completion, continuation hand-over
+ * and waiter wake-up are all driven by the single atomic _status word: whichever
+ * side (Then() or completion) sets its bit second runs the continuation, and the
+ * futex wake is only issued when a waiter announced itself.
+ *
+ * The continuation is stored inline, callables larger than CONT_CAPACITY are
+ * rejected at compile time.
+ */
+template <typename R>
+class WQFutureState
+{
+    public:
+        using TValue = std::conditional_t<std::is_void<R>::value, char, R>;
+
+        static constexpr size_t     CONT_CAPACITY = 48;
+
+        static constexpr uint32_t   DONE    = 0x1;
+        static constexpr uint32_t   BROKEN  = 0x2;
+        static constexpr uint32_t   CONT    = 0x4;
+        static constexpr uint32_t   WAITER  = 0x8;
+
+        template <typename... TArgs>
+        void        SetValue(TArgs&&... args);
+        void        Break()                 { Complete(DONE | BROKEN);  }
+
+        template <typename F>
+        int         SetContinuation(F &&fn);
+
+        int         Wait(const timespec *timeout = nullptr);
+        uint32_t    Status() const          { return _status.load(std::memory_order_acquire); }
+        TValue*     Value()                 { return std::launder(reinterpret_cast<TValue *>(_value)); }
+
+        void        Release();
+
+    private:
+        friend class WQFutureSlab<R>;
+
+        void        Complete(uint32_t bits);
+        void        RunContinuation();
+
+        std::atomic<uint32_t>   _status {0};
+        std::atomic<uint32_t>   _refs   {0};
+        std::atomic<uint32_t>   _next   {0};    // slab free list link, index + 1
+        uint32_t                _index  = 0;    // slot in the slab
+
+        alignas(TValue)             unsigned char _value[sizeof(TValue)];
+        alignas(std::max_align_t)   unsigned char _cont[CONT_CAPACITY];
+        void                      (*_contInvoke) (void *cont, TValue *value) = nullptr;
+        void                      (*_contDestroy)(void *cont)                = nullptr;
+};
+
+
+/**
+ * @brief Lock-free pool of WQFutureState<R>, grown in chunks and never shrunk.
+ *
+ * The free list is a Treiber stack over slot indexes; the head carries a 32 bit
+ * tag against ABA. Only growing takes a mutex.
+ *
+ * The instance is never destroyed: a future or a queued item held by a static
+ * (a global queue, say) releases its state during static destruction, after a
+ * function-local slab would already have freed its chunks.
+ */
+template <typename R>
+class WQFutureSlab
+{
+    public:
+        static constexpr uint32_t CHUNK_SIZE = 1024;
+        static constexpr uint32_t CHUNK_MAX  = 4096;
+
+        static WQFutureSlab&    Instance()      { static WQFutureSlab *s_slab = new WQFutureSlab; return *s_slab; }
+
+        //Returns nullptr once all states of the slab are in use
+        WQFutureState<R>*       Acquire();
+        void                    Recycle(WQFutureState<R> *state);
+
+        //Caps the slab at chunks * CHUNK_SIZE states (at most CHUNK_MAX chunks), chunks already there stay
+        void                    SetMaxChunks(uint32_t chunks);
+
+    private:
+
+        WQFutureState<R>*       At(uint32_t idx)    { return &_chunks[idx / CHUNK_SIZE].load(std::memory_order_acquire)[idx % CHUNK_SIZE]; }
+        int                     Grow();
+
+        std::atomic<uint64_t>                   _head {0};      // tag << 32 | (index + 1), 0 is empty
+        std::atomic<WQFutureState<R> *>         _chunks[CHUNK_MAX] {};
+        uint32_t                                _chunkCount = 0;
+        uint32_t                                _chunkLimit = CHUNK_MAX;
+        std::mutex                              _growLock;
+};
+
+
+/**
+ * @brief Result of WorkQueue::Submit(), fulfilled by the worker with the value returned by Pop.
+ *
+ * Move-only. Wait()/Get() block without a mutex (futex on the state word);
+ * Then() attaches a continuation, run by the worker right after Pop (or
+ * immediately by the caller if the result is already there). The continuation
+ * receives a pointer to the value, nullptr when the item was dropped.
+ *
+ * Return codes: 0 value ready, -1 broken (item dropped) or invalid future,
+ * 1 timed out (WaitFor only).
+ */
+template <typename R>
+class WQFuture
+{
+    public:
+        WQFuture() = default;
+        explicit WQFuture(WQFutureState<R> *state) : _state(state) {}
+        WQFuture(const WQFuture &) = delete;
+        WQFuture(WQFuture &&val) noexcept : _state(val._state)          { val._state = nullptr; }
+        ~WQFuture()                                                     { Reset(); }
+
+        WQFuture &operator = (const WQFuture &) = delete;
+        WQFuture &operator = (WQFuture &&val) noexcept                  { if (this != &val) { Reset(); _state = val._state; val._state = nullptr; } return *this; }
+
+        bool        Valid() const       { return nullptr != _state; }
+        bool        IsReady() const     { return _state && (_state->Status() & WQFutureState<R>::DONE);     }
+        bool        IsBroken() const    { return _state && (_state->Status() & WQFutureState<R>::BROKEN);   }
+
+        int         Wait();
+        int         WaitFor(uint64_t ns);
+
+        template <typename T = R>
+        int         Get(T &val);
+
+        template <typename F>
+        int         Then(F &&fn);
+
+        void        Reset()             { if (_state) _state->Release(); _state = nullptr; }
+
+    private:
+        WQFutureState<R>   *_state = nullptr;
+};
+
+
+
+
+template <typename R>
+template <typename... TArgs>
+void WQFutureState<R>::SetValue(TArgs&&... args)
+{
+    new (_value) TValue(std::forward<TArgs>(args)...);
+    Complete(DONE);
+}
+
+
+template <typename R>
+void WQFutureState<R>::Complete(uint32_t bits)
+{
+    uint32_t prev = _status.fetch_or(bits, std::memory_order_acq_rel);
+    if (prev & CONT)
+        RunContinuation();
+    if (prev & WAITER)
+        FutexWake(_status);
+}
+
+
+template <typename R>
+void WQFutureState<R>::RunContinuation()
+{
+    _contInvoke(_cont, (Status() & BROKEN) ? nullptr : Value());
+}
+
+
+template <typename R>
+template <typename F>
+int WQFutureState<R>::SetContinuation(F &&fn)
+{
+    using TFn = std::decay_t<F>;
+    static_assert(sizeof(TFn)  <= CONT_CAPACITY,              "WQFuture continuation capture is too large, capture a pointer instead");
+    static_assert(alignof(TFn) <= alignof(std::max_align_t),  "WQFuture continuation is over-aligned");
+
+    if (Status() & CONT)
+        return -1;
+
+    new (_cont) TFn(std::forward<F>(fn));
+    _contInvoke  = [](void *cont, TValue *value) { (*static_cast<TFn *>(cont))(reinterpret_cast<R *>(value)); };
+    _contDestroy = [](void *cont)                { static_cast<TFn *>(cont)->~TFn(); };
+
+    uint32_t prev = _status.fetch_or(CONT, std::memory_order_acq_rel);
+    if (prev & DONE)
+        RunContinuation();
+    return 0;
+}
+
+
+template <typename R>
+int WQFutureState<R>::Wait(const timespec *timeout /*= nullptr*/)
+{
+    uint64_t deadline = timeout ? ClockMonotonic::Now() + TimespecToNs(*timeout) : 0;
+
+    uint32_t status = Status();
+    while (0 == (status & DONE))
+    {
+        if (0 == (status & WAITER))
+        {
+            if (false == _status.compare_exchange_weak(status, status | WAITER, std::memory_order_acq_rel))
+                continue;
+            status |= WAITER;
+        }
+
+        if (timeout)
+        {
+            uint64_t now = ClockMonotonic::Now();
+            if (now >= deadline)
+                return 1;
+            timespec left = TimespecFromNs(deadline - now);
+            FutexWait(_status, status, &left);
+        }
+        else
+        {
+            FutexWait(_status, status);
+        }
+        status = Status();
+    }
+    return (status & BROKEN) ? -1 : 0;
+}
+
+
+template <typename R>
+void WQFutureState<R>::Release()
+{
+    if (_refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    uint32_t status = Status();
+    if ((status & DONE) && 0 == (status & BROKEN))
+        Value()->~TValue();
+    if (status & CONT)
+        _contDestroy(_cont);
+
+    _status.store(0, std::memory_order_relaxed);
+    _contInvoke  = nullptr;
+    _contDestroy = nullptr;
+    WQFutureSlab<R>::Instance().Recycle(this);
+}
+
+
+
+
+template <typename R>
+WQFutureState<R> *WQFutureSlab<R>::Acquire()
+{
+    uint64_t head = _head.load(std::memory_order_acquire);
+    for (;;)
+    {
+        uint32_t top = uint32_t(head);
+        if (0 == top)
+        {
+            if (0 != Grow())
+                return nullptr;
+            head = _head.load(std::memory_order_acquire);
+            continue;
+        }
+
+        WQFutureState<R> *state = At(top - 1);
+        uint64_t next = (((head >> 32) + 1) << 32) | state->_next.load(std::memory_order_relaxed);
+        if (_head.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            state->_refs.store(2, std::memory_order_relaxed);      // future + queued item
+            return state;
+        }
+    }
+}
+
+
+template <typename R>
+void WQFutureSlab<R>::Recycle(WQFutureState<R> *state)
+{
+    uint64_t head = _head.load(std::memory_order_relaxed);
+    uint64_t next;
+    do
+    {
+        state->_next.store(uint32_t(head), std::memory_order_relaxed);
+        next = (((head >> 32) + 1) << 32) | (state->_index + 1);
+    }
+    while (false == _head.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed));
+}
+
+
+template <typename R>
+void WQFutureSlab<R>::SetMaxChunks(uint32_t chunks)
+{
+    std::lock_guard<std::mutex> lck{_growLock};
+    _chunkLimit = std::min(chunks, CHUNK_MAX);
+}
+
+
+template <typename R>
+int WQFutureSlab<R>::Grow()
+{
+    std::lock_guard<std::mutex> lck{_growLock};
+    if (0 != uint32_t(_head.load(std::memory_order_acquire)))
+        return 0;   // refilled meanwhile
+    if (_chunkCount >= _chunkLimit)
+        return -1;
+
+    WQFutureState<R> *chunk = new (std::nothrow) WQFutureState<R>[CHUNK_SIZE];
+    if (nullptr == chunk)
+        return -1;
+
+    uint32_t base = _chunkCount * CHUNK_SIZE;
+    for (uint32_t idx = 0; idx < CHUNK_SIZE; ++idx)
+    {
+        chunk[idx]._index = base + idx;
+        chunk[idx]._next.store(idx + 1 < CHUNK_SIZE ? base + idx + 2 : 0, std::memory_order_relaxed);
+    }
+    _chunks[_chunkCount++].store(chunk, std::memory_order_release);
+
+    //Splice the whole chunk in front of the (possibly refilled) list
+    uint64_t head = _head.load(std::memory_order_relaxed);
+    uint64_t next;
+    do
+    {
+        chunk[CHUNK_SIZE - 1]._next.store(uint32_t(head), std::memory_order_relaxed);
+        next = (((head >> 32) + 1) << 32) | (base + 1);
+    }
+    while (false == _head.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed));
+
+    return 0;
+}
+
+
+
+
+template <typename R>
+int WQFuture<R>::Wait()
+{
+    return _state ? _state->Wait() : -1;
+}
+
+
+template <typename R>
+int WQFuture<R>::WaitFor(uint64_t ns)
+{
+    if (nullptr == _state)
+        return -1;
+
+    timespec ts = TimespecFromNs(ns);
+    return _state->Wait(&ts);
+}
+
+
+template <typename R>
+template <typename T>
+int WQFuture<R>::Get(T &val)
+{
+    int rc = Wait();
+    if (0 == rc)
+        val = std::move(*_state->Value());
+    return rc;
+}
+
+
+template <typename R>
+template <typename F>
+int WQFuture<R>::Then(F &&fn)
+{
+    return _state ? _state->SetContinuation(std::forward<F>(fn)) : -1;
+}
+
+
+#endif // __WORK_QUEUE_FUTURE_H__
+
+// clang-format on
@@ -0,0 +1,103 @@
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_JOURNAL_H__
+#define __WORK_QUEUE_JOURNAL_H__
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <stdint.h>
+
+
+
+
+struct WQJournalConfig
+{
+    uint32_t    _segmentRecords = 1 << 16;  // records per segment file
+    uint32_t    _maxSegments    = 256;      // live segment files, Append fails once all are in use
+    uint32_t    _syncEvery      = 256;      // msync once this many records are unsynced, 0 leaves write-back to the kernel
+};
+
+
+/**
+ * @brief Segmented, memory mapped log of fixed-size records, the durable side of a WorkQueue.
+ *
+ * Records are appended into mmap'ed segment files (<dir>/<segment>.wqj), each
+ * record carries a state word (written, then acknowledged) and a checksum of its
+ * payload. A segment file is unlinked as soon as all of its records are
+ * acknowledged. Open() scans the directory left by a previous run and hands the
+ * records that were written but never acknowledged back, oldest first; new
+ * records always start in a fresh segment. A new segment file gets its header
+ * under a temporary name and is renamed into place, leftovers of a crash before
+ * that, and segments without header or written records, are removed by Open().
+ *
+ * The mapping is shared, so everything appended survives a crash of the process
+ * as soon as Append() returns. Sync() msyncs the records appended since the last
+ * Sync() in one go (group commit) to also survive a crash of the machine.
+ * Acknowledgements are not synced on their own: after a power loss an item may be
+ * delivered again, never lost (once synced).
+ *
+ * Append() calls must be serialized by the caller (WorkQueue appends under its
+ * queue lock, keeping journal and queue order identical); Ack() and Sync() may
+ * run concurrently with it.
+ */
+class WQJournal
+{
+    public:
+        using TPendingFn = std::function<void(uint64_t seq, const void *record)>;
+
+        WQJournal(const std::string &dir, uint32_t recordSize, const WQJournalConfig &cfg = WQJournalConfig());
+        ~WQJournal();
+
+        WQJournal(const WQJournal &) = delete;
+        WQJournal &operator=(const WQJournal &) = delete;
+
+        int         Open(const TPendingFn &onPending);
+        void        Close();
+        bool        IsOpen() const          { return _open; }
+
+        //Returns the record sequence (> 0), 0 if the record could not be stored
+        uint64_t    Append(const void *record);
+        void        Ack(uint64_t seq);
+
+        bool        SyncDue() const;
+        int         Sync();
+
+        const std::string &Dir() const      { return _dir; }
+
+    private:
+        struct Segment;
+
+        Segment    *MapSegment(uint64_t idx, bool create);
+        void        UnmapSegment(Segment *seg, bool unlinkFile);
+        bool        IsBlankSegment(uint64_t idx) const;
+        std::string SegmentPath(uint64_t idx) const;
+        uint8_t    *Record(Segment *seg, uint32_t slot) const;
+        std::atomic<Segment *> &Slot(uint64_t idx) const;
+
+        const std::string           _dir;
+        const uint32_t              _recordSize;
+        const uint32_t              _stride;
+        const WQJournalConfig       _cfg;
+        const size_t                _segmentBytes;
+
+        bool                        _open = false;
+        std::unique_ptr<std::atomic<Segment *>[]> _table;
+        std::mutex                  _segLock;           // segment map / unmap and msync
+        std::mutex                  _syncLock;
+
+        Segment                    *_current    = nullptr;
+        uint64_t                    _nextRecord = 0;
+        std::atomic<uint64_t>       _appended {0};      // records [0, _appended) are written
+        std::atomic<uint64_t>       _synced   {0};      // records [0, _synced) are msync'ed
+};
+
+
+
+
+#endif // __WORK_QUEUE_JOURNAL_H__
+
+// clang-format on
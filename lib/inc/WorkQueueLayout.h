@@ -0,0 +1,31 @@
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_LAYOUT_H__
+#define __WORK_QUEUE_LAYOUT_H__
+
+#include <stddef.h>
+
+
+
+
+/**
+ * @brief Alignment that keeps independently written fields off each other's cache line.
+ *
+ * Plays the role of std::hardware_destructive_interference_size, which GCC warns
+ * about in headers because its value follows -mtune and would silently change the
+ * layout (and ABI) of every queue. Builds for parts with 128 byte interference
+ * (adjacent line prefetch on recent x86, Apple M, POWER) can set -DWQ_CACHE_LINE=128.
+ */
+#ifndef WQ_CACHE_LINE
+#define WQ_CACHE_LINE   64
+#endif
+
+static_assert(0 == (WQ_CACHE_LINE & (WQ_CACHE_LINE - 1)), "WQ_CACHE_LINE must be a power of two");
+
+
+
+
+#endif // __WORK_QUEUE_LAYOUT_H__
+
+// clang-format on
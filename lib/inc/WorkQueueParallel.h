@@ -0,0 +1,143 @@
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_PARALLEL_H__
+#define __WORK_QUEUE_PARALLEL_H__
+
+#include "Futex.h"
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+
+/**
+ * @brief One-shot countdown latch, Wait() returns once CountDown() brought it to zero.
+ */
+class WQLatch
+{
+    public:
+        explicit WQLatch(size_t count) : _remaining(count), _open(0 == count ? 1 : 0) {}
+
+        void        CountDown(size_t count = 1);
+        void        Wait();
+        bool        IsOpen() const      { return 0 != _open.load(std::memory_order_acquire); }
+
+    private:
+        std::atomic<size_t>     _remaining;
+        std::atomic<uint32_t>   _open;
+};
+
+
+inline void WQLatch::CountDown(size_t count /*= 1*/)
+{
+    if (_remaining.fetch_sub(count, std::memory_order_acq_rel) == count)
+    {
+        _open.store(1, std::memory_order_release);
+        FutexWake(_open);
+    }
+}
+
+
+inline void WQLatch::Wait()
+{
+    while (0 == _open.load(std::memory_order_acquire))
+        FutexWait(_open, 0);
+}
+
+
+
+
+/**
+ * @brief Shared state of one ParallelFor / ParallelReduce call.
+ *
+ * Participants (the caller and one helper per pool queue) claim chunks of
+ * [begin, end) with a CAS on _next. Chunks are guided: a participant takes
+ * remaining / (2 * participants), never less than the grain, so the first
+ * chunks are large and the tail is split finely for balance.
+ *
+ * The latch counts elements, not helpers: the caller returns as soon as every
+ * element ran, even if some helpers are still queued behind other work. Those
+ * find the range exhausted and only drop their reference, which is why the
+ * job lives on the heap.
+ */
+template <typename TBody>
+class WQParallelJob
+{
+    public:
+        WQParallelJob(size_t begin, size_t end, size_t grain, size_t participants, TBody &&body)
+            : _next(begin), _end(end), _grain(std::max<size_t>(grain, 1)), _participants(participants)
+            , _latch(end - begin), _body(std::move(body))
+        {
+        }
+
+        void        Work(size_t slot);
+        void        Wait()                          { _latch.Wait(); }
+        void        AddRef()                        { _refs.fetch_add(1, std::memory_order_relaxed); }
+        void        Release()                       { if (1 == _refs.fetch_sub(1, std::memory_order_acq_rel)) delete this; }
+        size_t      NextSlot()                      { return _slots.fetch_add(1, std::memory_order_relaxed); }
+
+        //PushCall entry of the helpers
+        static void Helper(void *ctx, bool cancelled)
+        {
+            auto *job = static_cast<WQParallelJob *>(ctx);
+            if (false == cancelled)
+                job->Work(job->NextSlot());
+            job->Release();
+        }
+
+    private:
+        bool        Claim(size_t &begin, size_t &end);
+
+        std::atomic<size_t>     _next;
+        const size_t            _end;
+        const size_t            _grain;
+        const size_t            _participants;
+        std::atomic<size_t>     _slots {1};         // 0 is the caller
+        std::atomic<uint32_t>   _refs  {1};         // the caller
+        WQLatch                 _latch;
+        TBody                   _body;
+};
+
+
+template <typename TBody>
+bool WQParallelJob<TBody>::Claim(size_t &begin, size_t &end)
+{
+    size_t next = _next.load(std::memory_order_relaxed);
+    size_t chunk;
+    do
+    {
+        if (next >= _end)
+            return false;
+        size_t left = _end - next;
+        chunk = std::min(left, std::max(_grain, left / (2 * _participants)));
+    }
+    while (false == _next.compare_exchange_weak(next, next + chunk, std::memory_order_relaxed));
+
+    begin = next;
+    end   = next + chunk;
+    return true;
+}
+
+
+template <typename TBody>
+void WQParallelJob<TBody>::Work(size_t slot)
+{
+    size_t begin, end;
+    while (Claim(begin, end))
+    {
+        _body(begin, end, slot);
+        _latch.CountDown(end - begin);
+    }
+}
+
+
+
+
+#endif // __WORK_QUEUE_PARALLEL_H__
+
+// clang-format on
@@ -0,0 +1,536 @@
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_PIPELINE_H__
+#define __WORK_QUEUE_PIPELINE_H__
+
+#include "WorkQueue.h"
+#include "WorkQueueSpsc.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+
+
+/**
+ * @brief Link between two pipeline stages: one WQSpscRing per (producer, consumer) thread pair.
+ *
+ * Every producer thread owns a row of rings, every consumer thread a column, so
+ * each ring keeps a single writer and a single reader whatever the parallelism on
+ * both sides. Producers deal items round robin over their row and park when the
+ * whole row is full (backpressure), consumers poll their column and park when it
+ * is empty. Each side unparks the other only when it may have been waiting.
+ */
+template <typename T>
+class WQPipelineLink
+{
+    public:
+        void        Init(const std::vector<WQParker *> &producers, const std::vector<WQParker *> &consumers, size_t capacity);
+
+        int         Push   (size_t producer, T &&item, size_t &cursor, WQParker &self, const std::atomic_bool &abort);
+        bool        TryPush(size_t producer, T &&item, size_t &cursor);
+        template <typename F>
+        bool        Consume(size_t consumer, size_t &cursor, F &&fn);
+
+        bool        Empty  (size_t consumer) const;
+        bool        HasRoom(size_t producer) const;
+
+    private:
+        WQSpscRing<T>&  Ring(size_t producer, size_t consumer) const    { return *_rings[producer * _consumers.size() + consumer]; }
+
+        std::vector<std::unique_ptr<WQSpscRing<T>>> _rings;
+        std::vector<WQParker *>                     _producers;
+        std::vector<WQParker *>                     _consumers;
+};
+
+
+template <typename T>
+void WQPipelineLink<T>::Init(const std::vector<WQParker *> &producers, const std::vector<WQParker *> &consumers, size_t capacity)
+{
+    _producers = producers;
+    _consumers = consumers;
+    _rings.clear();
+    for (size_t idx = 0; idx < producers.size() * consumers.size(); ++idx)
+        _rings.push_back(std::make_unique<WQSpscRing<T>>(capacity));
+}
+
+
+template <typename T>
+bool WQPipelineLink<T>::TryPush(size_t producer, T &&item, size_t &cursor)
+{
+    size_t count = _consumers.size();
+    for (size_t step = 0; step < count; ++step)
+    {
+        size_t consumer = (cursor + step) % count;
+        if (Ring(producer, consumer).TryPush(std::move(item)))
+        {
+            cursor = consumer + 1;
+            _consumers[consumer]->Unpark();
+            return true;
+        }
+    }
+    return false;
+}
+
+
+template <typename T>
+int WQPipelineLink<T>::Push(size_t producer, T &&item, size_t &cursor, WQParker &self, const std::atomic_bool &abort)
+{
+    while (false == TryPush(producer, std::move(item), cursor))
+    {
+        if (abort.load(std::memory_order_relaxed))
+            return -1;
+        self.Park([&]() { return abort.load() || HasRoom(producer); });
+    }
+    return 0;
+}
+
+
+template <typename T>
+template <typename F>
+bool WQPipelineLink<T>::Consume(size_t consumer, size_t &cursor, F &&fn)
+{
+    size_t count = _producers.size();
+    for (size_t step = 0; step < count; ++step)
+    {
+        size_t producer = (cursor + step) % count;
+        if (Ring(producer, consumer).Consume(fn))
+        {
+            cursor = producer + 1;
+            _producers[producer]->Unpark();
+            return true;
+        }
+    }
+    return false;
+}
+
+
+template <typename T>
+bool WQPipelineLink<T>::Empty(size_t consumer) const
+{
+    for (size_t producer = 0; producer < _producers.size(); ++producer)
+        if (false == Ring(producer, consumer).Empty())
+            return false;
+    return true;
+}
+
+
+template <typename T>
+bool WQPipelineLink<T>::HasRoom(size_t producer) const
+{
+    for (size_t consumer = 0; consumer < _consumers.size(); ++consumer)
+        if (false == Ring(producer, consumer).Full())
+            return true;
+    return false;
+}
+
+
+
+
+/**
+ * @brief Handed to a stage's Pop() to move results into the next stage.
+ *
+ * Push() blocks while every ring towards the next stage is full and returns -1
+ * (dropping the item) only when the pipeline is force released. A stage may push
+ * any number of items per input, zero filters it out.
+ */
+template <typename T>
+class WQPipelineEmit
+{
+    public:
+        WQPipelineEmit(WQPipelineLink<T> *link, size_t producer, WQParker *self, const std::atomic_bool *abort)
+            : _link(link), _producer(producer), _self(self), _abort(abort)
+        {
+        }
+
+        int         Push(T &&item)      { return _link->Push(_producer, std::move(item), _cursor, *_self, *_abort); }
+
+    private:
+        WQPipelineLink<T>      *_link;
+        size_t                  _producer;
+        WQParker               *_self;
+        const std::atomic_bool *_abort;
+        size_t                  _cursor = 0;
+};
+
+
+
+
+/**
+ * @brief Worker threads of one pipeline stage and the link feeding them.
+ */
+template <typename TStage>
+class WQPipelineNode
+{
+    public:
+        using TIn       = typename TStage::TIn;
+        using TOut      = typename TStage::TOut;
+        using TOutItem  = std::conditional_t<std::is_void<TOut>::value, char, TOut>;
+
+        void                    Create(TStage *stage, size_t workers, const std::atomic_bool *force);
+        void                    Connect(const std::vector<WQParker *> &producers, size_t capacity, WQPipelineLink<TOutItem> *outbox);
+        void                    Start();
+        void                    Finish();
+        void                    Wake();
+
+        std::vector<WQParker *> Parkers();
+        WQPipelineLink<TIn>&    Inbox()         { return _inbox; }
+
+    private:
+        class Worker : public Thread<Worker>
+        {
+            public:
+                Worker(WQPipelineNode *node, size_t idx) : _node(node), _idx(idx) {}
+                void        Run()           { _node->Work(_idx); }
+
+                WQParker    _parker;
+
+            private:
+                WQPipelineNode *_node;
+                size_t          _idx;
+        };
+
+        void                    Work(size_t idx);
+
+        TStage                             *_stage  = nullptr;
+        const std::atomic_bool             *_force  = nullptr;
+        std::atomic_bool                    _upstreamDone {false};
+        WQPipelineLink<TIn>                 _inbox;
+        WQPipelineLink<TOutItem>           *_outbox = nullptr;
+        std::vector<std::unique_ptr<Worker>> _workers;
+};
+
+
+template <typename TStage>
+void WQPipelineNode<TStage>::Create(TStage *stage, size_t workers, const std::atomic_bool *force)
+{
+    _stage        = stage;
+    _force        = force;
+    _upstreamDone = false;
+    _workers.clear();
+    for (size_t idx = 0; idx < workers; ++idx)
+        _workers.push_back(std::make_unique<Worker>(this, idx));
+}
+
+
+template <typename TStage>
+void WQPipelineNode<TStage>::Connect(const std::vector<WQParker *> &producers, size_t capacity, WQPipelineLink<TOutItem> *outbox)
+{
+    _inbox.Init(producers, Parkers(), capacity);
+    _outbox = outbox;
+}
+
+
+template <typename TStage>
+std::vector<WQParker *> WQPipelineNode<TStage>::Parkers()
+{
+    std::vector<WQParker *> parkers;
+    for (auto &worker : _workers)
+        parkers.push_back(&worker->_parker);
+    return parkers;
+}
+
+
+template <typename TStage>
+void WQPipelineNode<TStage>::Start()
+{
+    for (auto &worker : _workers)
+        worker->Start();
+}
+
+
+template <typename TStage>
+void WQPipelineNode<TStage>::Wake()
+{
+    for (auto &worker : _workers)
+        worker->_parker.Unpark();
+}
+
+
+template <typename TStage>
+void WQPipelineNode<TStage>::Finish()
+{
+    //Upstream threads are joined, nothing more can land in the inbox
+    _upstreamDone.store(true, std::memory_order_release);
+    Wake();
+    for (auto &worker : _workers)
+        worker->Join();
+}
+
+
+template <typename TStage>
+void WQPipelineNode<TStage>::Work(size_t idx)
+{
+    WQParker                &self = _workers[idx]->_parker;
+    WQPipelineEmit<TOutItem> emit(_outbox, idx, &self, _force);
+    size_t                   cursor = 0;
+
+    _stage->Begin();
+    while (false == _force->load(std::memory_order_relaxed))
+    {
+        bool got = _inbox.Consume(idx, cursor, [&](TIn &item)
+        {
+            if constexpr (std::is_void<TOut>::value)
+                _stage->Pop(&item);
+            else
+                _stage->Pop(&item, emit);
+        });
+        if (got)
+            continue;
+
+        if (_upstreamDone.load(std::memory_order_acquire))
+        {
+            if (_inbox.Empty(idx))
+                break;
+            continue;
+        }
+        self.Park([&]() { return _force->load() || _upstreamDone.load() || false == _inbox.Empty(idx); });
+    }
+    _stage->End();
+}
+
+
+
+
+/**
+ * @brief A chain of stages wired by bounded SPSC links, each stage running on its own worker threads.
+ *
+ * Items move from stage to stage without copies or locks: a stage consumes its
+ * input in place from the ring slot and moves its outputs into the next link
+ * (use a pointer type such as std::unique_ptr as TOut to hand off large items).
+ * When a link fills up the upstream workers park, which in turn fills their own
+ * inbox, so backpressure reaches Push() at the head of the chain.
+ *
+ * A stage declares its input and output types, Begin() / End() called on each of
+ * its worker threads, and Pop(). Like WorkQueuePool, a stage object is shared by
+ * its workers, so Pop() must be thread safe when SetWorkers() gives it more than
+ * one; order is only kept through single worker stages.
+ *
+ * Usage example:
+ * @code
+ * struct Parse
+ * {
+ *     using TIn  = std::string;
+ *     using TOut = std::unique_ptr<Record>;
+ *     void Begin() {}
+ *     void End()   {}
+ *     void Pop(std::string *line, WQPipelineEmit<TOut> &out)  { out.Push(ParseRecord(*line)); }
+ * };
+ *
+ * struct Persist
+ * {
+ *     using TIn  = std::unique_ptr<Record>;
+ *     using TOut = void;
+ *     void Begin() {}
+ *     void End()   {}
+ *     void Pop(std::unique_ptr<Record> *rec)                  { Store(**rec); }
+ * };
+ *
+ * Pipeline<Parse, Persist> pipe;
+ * pipe.SetWorkers(0, 4);
+ * pipe.Init("ingest");
+ * pipe.Push(std::move(line));
+ * pipe.Release();             // drains stage by stage
+ * @endcode
+ *
+ * Each link holds producers x consumers rings of SetLinkCapacity() items.
+ *
+ * @tparam TStages The stage types, TOut of each one is TIn of the next, TOut of the last one is void
+ */
+template <typename... TStages>
+class Pipeline
+{
+    public:
+        static constexpr size_t STAGE_COUNT = sizeof...(TStages);
+
+        using TNodes    = std::tuple<WQPipelineNode<TStages>...>;
+        using TIn       = typename std::tuple_element_t<0, std::tuple<TStages...>>::TIn;
+
+        Pipeline()                              { _workers.fill(1); }
+        virtual ~Pipeline();
+
+        void            SetWorkers(size_t stage, size_t count);
+        void            SetLinkCapacity(size_t capacity);
+
+        int             Init(const std::string &name = "");
+        void            Release(bool bForce = false);
+
+        int             Push   (TIn &&item);
+        int             Push   (const TIn &item);
+        int             TryPush(TIn &&item);
+
+        template <size_t I>
+        auto&           Stage()                 { return std::get<I>(_stages); }
+        const std::string& Name() const         { return _name; }
+
+    private:
+        template <size_t I>
+        void            InitNode();
+        template <size_t... I>
+        void            InitNodes(std::index_sequence<I...>);
+        template <size_t... I>
+        void            FinishNodes(std::index_sequence<I...>);
+
+        std::string                         _name;
+        std::tuple<TStages...>              _stages;
+        TNodes                              _nodes;
+        std::array<size_t, STAGE_COUNT>     _workers;
+        size_t                              _linkCapacity = 1024;
+
+        std::mutex                          _entryLock;     // serializes producers on the head link
+        WQParker                            _entryParker;
+        size_t                              _entryCursor = 0;
+        bool                                _closed  = true;
+        std::atomic_bool                    _force {false};
+};
+
+
+template <typename... TStages>
+Pipeline<TStages...>::~Pipeline()
+{
+    Release();
+}
+
+
+template <typename... TStages>
+void Pipeline<TStages...>::SetWorkers(size_t stage, size_t count)
+{
+    if (stage < STAGE_COUNT && count > 0)
+        _workers[stage] = count;
+}
+
+
+template <typename... TStages>
+void Pipeline<TStages...>::SetLinkCapacity(size_t capacity)
+{
+    _linkCapacity = capacity;
+}
+
+
+template <typename... TStages>
+template <size_t I>
+void Pipeline<TStages...>::InitNode()
+{
+    using TNode = std::tuple_element_t<I, TNodes>;
+
+    std::vector<WQParker *>                 producers {&_entryParker};
+    WQPipelineLink<typename TNode::TOutItem> *outbox = nullptr;
+
+    if constexpr (I > 0)
+        producers = std::get<I - 1>(_nodes).Parkers();
+
+    if constexpr (I + 1 < STAGE_COUNT)
+    {
+        static_assert(std::is_same<typename TNode::TOut, typename std::tuple_element_t<I + 1, TNodes>::TIn>::value,
+                      "Pipeline stage TOut must match TIn of the next stage");
+        outbox = &std::get<I + 1>(_nodes).Inbox();
+    }
+    else
+    {
+        static_assert(std::is_void<typename TNode::TOut>::value, "Last Pipeline stage must have TOut = void");
+    }
+
+    std::get<I>(_nodes).Connect(producers, _linkCapacity, outbox);
+}
+
+
+template <typename... TStages>
+template <size_t... I>
+void Pipeline<TStages...>::InitNodes(std::index_sequence<I...>)
+{
+    (std::get<I>(_nodes).Create(&std::get<I>(_stages), _workers[I], &_force), ...);
+    (InitNode<I>(), ...);
+    (std::get<I>(_nodes).Start(), ...);
+}
+
+
+template <typename... TStages>
+template <size_t... I>
+void Pipeline<TStages...>::FinishNodes(std::index_sequence<I...>)
+{
+    if (_force)
+        (std::get<I>(_nodes).Wake(), ...);
+    (std::get<I>(_nodes).Finish(), ...);
+}
+
+
+template <typename... TStages>
+int Pipeline<TStages...>::Init(const std::string &name /*= ""*/)
+{
+    std::lock_guard<std::mutex> lck{_entryLock};
+    if (false == _closed)
+        return -1;
+
+    _name        = name;
+    _force       = false;
+    _entryCursor = 0;
+    InitNodes(std::index_sequence_for<TStages...>());
+    _closed      = false;
+    return 0;
+}
+
+
+template <typename... TStages>
+void Pipeline<TStages...>::Release(bool bForce /*= false*/)
+{
+    if (bForce)
+    {
+        _force = true;
+        _entryParker.Unpark();
+    }
+    {
+        //Push() parked on a full head link gives up the lock once the head stage makes room (or on force)
+        std::lock_guard<std::mutex> lck{_entryLock};
+        if (_closed)
+            return;
+        _closed = true;
+    }
+
+    //Stage by stage: each one drains its inbox once everything upstream has exited
+    FinishNodes(std::index_sequence_for<TStages...>());
+}
+
+
+template <typename... TStages>
+int Pipeline<TStages...>::Push(TIn &&item)
+{
+    std::lock_guard<std::mutex> lck{_entryLock};
+    if (_closed)
+        return -1;
+
+    return std::get<0>(_nodes).Inbox().Push(0, std::move(item), _entryCursor, _entryParker, _force);
+}
+
+
+template <typename... TStages>
+int Pipeline<TStages...>::Push(const TIn &item)
+{
+    TIn copy(item);
+    return Push(std::move(copy));
+}
+
+
+template <typename... TStages>
+int Pipeline<TStages...>::TryPush(TIn &&item)
+{
+    std::lock_guard<std::mutex> lck{_entryLock};
+    if (_closed)
+        return -1;
+
+    return std::get<0>(_nodes).Inbox().TryPush(0, std::move(item), _entryCursor) ? 0 : -1;
+}
+
+
+
+
+#endif // __WORK_QUEUE_PIPELINE_H__
+
+// clang-format on
@@ -0,0 +1,592 @@
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_POLICY_H__
+#define __WORK_QUEUE_POLICY_H__
+
+#include "Futex.h"
+#include "TimeFrame.h"
+#include "WorkQueueLayout.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <poll.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+
+
+
+/**
+ * @brief
+ *
+ */
+
+enum class WQ_QUEUE_STATE
+{
+    NA              = 0,
+    WORKING         = 1,
+    PAUSE           = 2,
+    EXITING_WAIT    = 3,
+    EXITING_FORCE   = 4,
+};
+
+std::string WQ_QUEUE_STATE_text(WQ_QUEUE_STATE value);
+
+
+enum class WQ_PUSH_OP
+{
+    BACK        = 0,
+    FRONT       = 1,
+    FRESH       = 2,
+    CONFLATE    = 3,    // replaces the pending item of the same key in place, else BACK
+};
+
+
+
+
+/*
+ * Container policies
+ *
+ * The queue keeps the newest item at the front and drains from the back. A
+ * container provides emplace_front / emplace_back / back / pop_back / size /
+ * empty / clear / swap like std::deque, plus full(): pushes are rejected (and
+ * counted as dropped) while it returns true.
+ */
+
+template <typename T>
+class WQDequeContainer : public std::deque<T>
+{
+    public:
+        bool    full() const        { return false; }
+};
+
+
+/**
+ * @brief Bounded circular deque, no allocation once the slot array exists.
+ *
+ * The slot array is allocated on the first push, so an empty instance (such as
+ * the one WorkQueue swaps the content into on PushFresh) costs nothing.
+ *
+ * @tparam Capacity Slot count, a power of two
+ */
+template <typename T, size_t Capacity>
+class WQRingDeque
+{
+    static_assert(Capacity > 0 && 0 == (Capacity & (Capacity - 1)), "WQRingDeque capacity must be a power of two");
+
+    public:
+        WQRingDeque() = default;
+        ~WQRingDeque()                          { clear(); }
+
+        WQRingDeque(const WQRingDeque &) = delete;
+        WQRingDeque &operator=(const WQRingDeque &) = delete;
+
+        template <typename... TArgs>
+        T&          emplace_front(TArgs&&... args)
+        {
+            Reserve();
+            _head = (_head - 1) & MASK;
+            ++_size;
+            return *new (Slot(_head)) T(std::forward<TArgs>(args)...);
+        }
+
+        template <typename... TArgs>
+        T&          emplace_back(TArgs&&... args)
+        {
+            Reserve();
+            return *new (Slot(_head + _size++)) T(std::forward<TArgs>(args)...);
+        }
+
+        T&          back()                      { return *Item(_head + _size - 1);  }
+        void        pop_back()                  { Item(_head + --_size)->~T();      }
+
+        size_t      size() const                { return _size;                     }
+        bool        empty() const               { return 0 == _size;                }
+        bool        full() const                { return Capacity == _size;         }
+        void        clear()                     { while (_size > 0) pop_back();     }
+
+        void        swap(WQRingDeque &other)
+        {
+            std::swap(_slots, other._slots);
+            std::swap(_head,  other._head);
+            std::swap(_size,  other._size);
+        }
+
+    private:
+        static constexpr size_t MASK = Capacity - 1;
+
+        struct Storage { alignas(T) unsigned char _buf[sizeof(T)]; };
+
+        void       *Slot(size_t idx)            { return _slots[idx & MASK]._buf;   }
+        T*          Item(size_t idx)            { return std::launder(reinterpret_cast<T *>(Slot(idx))); }
+        void        Reserve()                   { if (nullptr == _slots) _slots = std::make_unique<Storage[]>(Capacity); }
+
+        std::unique_ptr<Storage[]>  _slots;
+        size_t                      _head = 0;
+        size_t                      _size = 0;
+};
+
+
+template <size_t Capacity>
+struct WQRingContainer
+{
+    template <typename T>
+    using type = WQRingDeque<T, Capacity>;
+};
+
+
+
+
+/*
+ * Lock policies: anything usable with std::lock_guard / std::unique_lock.
+ */
+
+/**
+ * @brief Test-and-test-and-set spin lock, for critical sections of a few instructions.
+ */
+class WQSpinLock
+{
+    public:
+        void    lock()
+        {
+            while (_locked.exchange(true, std::memory_order_acquire))
+                while (_locked.load(std::memory_order_relaxed))
+                {
+#if defined(__x86_64__) || defined(__i386__)
+                    __builtin_ia32_pause();
+#endif
+                }
+        }
+        bool    try_lock()      { return false == _locked.exchange(true, std::memory_order_acquire); }
+        void    unlock()        { _locked.store(false, std::memory_order_release); }
+
+    private:
+        std::atomic_bool    _locked {false};
+};
+
+
+
+
+/*
+ * Wake policies: how the Listener sleeps until work or a state change shows up.
+ * Wait() is entered and left with the queue lock held, Notify() is called after
+ * the change was made under that lock. WaitUntil() also returns once deadlineNs
+ * (CLOCK_MONOTONIC) passed.
+ */
+
+class WQCondWake
+{
+    public:
+        template <typename TLock>
+        static constexpr bool Supports()    { return std::is_same<TLock, std::mutex>::value; }
+
+        template <typename TLock, typename TPred>
+        void    Wait(std::unique_lock<TLock> &lck, TPred pred)  { _cond.wait(lck, pred); }
+        template <typename TLock, typename TPred>
+        void    WaitUntil(std::unique_lock<TLock> &lck, uint64_t deadlineNs, TPred pred)
+        {
+            _cond.wait_until(lck, std::chrono::steady_clock::time_point(std::chrono::nanoseconds(deadlineNs)), pred);
+        }
+        void    Notify()                                        { _cond.notify_one();    }
+
+    private:
+        std::condition_variable     _cond;
+};
+
+
+class WQCondAnyWake
+{
+    public:
+        template <typename TLock>
+        static constexpr bool Supports()    { return true; }
+
+        template <typename TLock, typename TPred>
+        void    Wait(std::unique_lock<TLock> &lck, TPred pred)  { _cond.wait(lck, pred); }
+        template <typename TLock, typename TPred>
+        void    WaitUntil(std::unique_lock<TLock> &lck, uint64_t deadlineNs, TPred pred)
+        {
+            _cond.wait_until(lck, std::chrono::steady_clock::time_point(std::chrono::nanoseconds(deadlineNs)), pred);
+        }
+        void    Notify()                                        { _cond.notify_one();    }
+
+    private:
+        std::condition_variable_any _cond;
+};
+
+
+/**
+ * @brief Sequence-counter futex; Notify() skips the syscall when nobody sleeps.
+ */
+class WQFutexWake
+{
+    public:
+        template <typename TLock>
+        static constexpr bool Supports()    { return true; }
+
+        template <typename TLock, typename TPred>
+        void    Wait(std::unique_lock<TLock> &lck, TPred pred)
+        {
+            while (false == pred())
+            {
+                _waiters.fetch_add(1);
+                uint32_t seq = _seq.load();
+                lck.unlock();
+                FutexWait(_seq, seq);
+                lck.lock();
+                _waiters.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        template <typename TLock, typename TPred>
+        void    WaitUntil(std::unique_lock<TLock> &lck, uint64_t deadlineNs, TPred pred)
+        {
+            while (false == pred())
+            {
+                uint64_t now = ClockMonotonic::Now();
+                if (now >= deadlineNs)
+                    return;
+
+                timespec left = TimespecFromNs(deadlineNs - now);
+                _waiters.fetch_add(1);
+                uint32_t seq = _seq.load();
+                lck.unlock();
+                FutexWait(_seq, seq, &left);
+                lck.lock();
+                _waiters.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        void    Notify()
+        {
+            _seq.fetch_add(1);
+            if (0 != _waiters.load())
+                FutexWake(_seq, 1);
+        }
+
+    private:
+        std::atomic<uint32_t>       _seq     {0};
+        std::atomic<uint32_t>       _waiters {0};
+};
+
+
+/**
+ * @brief Busy polling, the Listener never sleeps: lowest latency at the cost of a core.
+ */
+class WQSpinWake
+{
+    public:
+        template <typename TLock>
+        static constexpr bool Supports()    { return true; }
+
+        template <typename TLock, typename TPred>
+        void    Wait(std::unique_lock<TLock> &lck, TPred pred)
+        {
+            while (false == pred())
+            {
+                lck.unlock();
+                std::this_thread::yield();
+                lck.lock();
+            }
+        }
+
+        template <typename TLock, typename TPred>
+        void    WaitUntil(std::unique_lock<TLock> &lck, uint64_t deadlineNs, TPred pred)
+        {
+            while (false == pred() && ClockMonotonic::Now() < deadlineNs)
+            {
+                lck.unlock();
+                std::this_thread::yield();
+                lck.lock();
+            }
+        }
+        void    Notify()        {}
+};
+
+
+/**
+ * @brief eventfd backed wake-up: the fd is readable while the queue has pending work.
+ *
+ * Lets a queue without its own worker (WorkQueue::InitExternal) be consumed from
+ * an epoll / poll loop: register Fd() for EPOLLIN (level triggered) and call
+ * WorkQueue::TryDrain() when it fires. Notify() only writes the fd on the first
+ * push after a Reset(), so a burst costs one syscall; TryDrain() resets it once
+ * the container is empty. State changes signal it as well. Notify() and Reset()
+ * both run under the queue lock. The Listener thread, when there is one, sleeps
+ * in poll().
+ */
+class WQEventFdWake
+{
+    public:
+        WQEventFdWake()     : _fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))  {}
+        ~WQEventFdWake()                                        { if (_fd >= 0) close(_fd); }
+
+        WQEventFdWake(const WQEventFdWake &) = delete;
+        WQEventFdWake &operator=(const WQEventFdWake &) = delete;
+
+        template <typename TLock>
+        static constexpr bool Supports()    { return true; }
+
+        template <typename TLock, typename TPred>
+        void    Wait(std::unique_lock<TLock> &lck, TPred pred)  { WaitUntil(lck, UINT64_MAX, pred); }
+
+        template <typename TLock, typename TPred>
+        void    WaitUntil(std::unique_lock<TLock> &lck, uint64_t deadlineNs, TPred pred)
+        {
+            while (false == pred())
+            {
+                //Reset under the lock, then recheck: a Notify() after it writes the fd again
+                Reset();
+                if (pred())
+                    return;
+
+                uint64_t now = ClockMonotonic::Now();
+                if (now >= deadlineNs)
+                    return;
+
+                timespec left = TimespecFromNs(deadlineNs - now);
+                pollfd   pfd {_fd, POLLIN, 0};
+                lck.unlock();
+                ppoll(&pfd, 1, UINT64_MAX == deadlineNs ? nullptr : &left, nullptr);
+                lck.lock();
+            }
+        }
+
+        //Called with the queue lock held, like Reset(), so the flag and the fd change together
+        void    Notify()
+        {
+            uint64_t one = 1;
+            if (false == _signaled.exchange(true))
+                (void)!write(_fd, &one, sizeof(one));
+        }
+
+        //Makes the fd unreadable until the next Notify(), the caller rechecks the queue afterwards.
+        //The read is unconditional: a write that ever got ahead of the flag is drained here too
+        void    Reset()
+        {
+            uint64_t count;
+            _signaled.store(false);
+            (void)!read(_fd, &count, sizeof(count));
+        }
+
+        int     Fd() const                                      { return _fd; }
+
+    private:
+        int                 _fd;
+        std::atomic_bool    _signaled {false};
+};
+
+
+
+
+/*
+ * Drain buffer policies: where the Listener moves a batch before running Pop()
+ * outside the lock. The buffer is reused across batches, std::vector keeps its
+ * capacity, std::list allocates a node per item.
+ */
+
+template <typename T>
+using WQListDrain   = std::list<T>;
+
+template <typename T>
+using WQVectorDrain = std::vector<T>;
+
+
+
+
+/*
+ * State policies: queue state and PAUSE poll period.
+ */
+
+class WQStateShared
+{
+    public:
+        WQ_QUEUE_STATE  Get() const
+        {
+            std::shared_lock<std::shared_mutex> lck(_lock);
+            return _state;
+        }
+
+        WQ_QUEUE_STATE  Exchange(WQ_QUEUE_STATE state)
+        {
+            std::scoped_lock lck(_lock);
+            std::swap(_state, state);
+            return state;
+        }
+
+        timespec        WaitTime() const
+        {
+            std::shared_lock<std::shared_mutex> lck(_lock);
+            return _waitTime;
+        }
+
+        void            SetWaitTime(const timespec &tmsp)
+        {
+            std::scoped_lock lck(_lock);
+            _waitTime = tmsp;
+        }
+
+    private:
+        mutable std::shared_mutex   _lock;
+        WQ_QUEUE_STATE              _state = WQ_QUEUE_STATE::EXITING_WAIT;
+        timespec                    _waitTime {1,0};
+};
+
+
+class WQStateAtomic
+{
+    public:
+        WQ_QUEUE_STATE  Get() const                             { return _state.load(std::memory_order_acquire);    }
+        WQ_QUEUE_STATE  Exchange(WQ_QUEUE_STATE state)          { return _state.exchange(state);                    }
+        timespec        WaitTime() const                        { return TimespecFromNs(_waitNs.load(std::memory_order_relaxed)); }
+        void            SetWaitTime(const timespec &tmsp)       { _waitNs.store(uint64_t(TimespecToNs(tmsp)), std::memory_order_relaxed); }
+
+    private:
+        std::atomic<WQ_QUEUE_STATE> _state  {WQ_QUEUE_STATE::EXITING_WAIT};
+        std::atomic<uint64_t>       _waitNs {uint64_t(SEC_TO_NS(1))};
+};
+
+
+
+
+/*
+ * Feature policies: the optional machinery of a queue (TPolicy::Features). A
+ * feature left out costs nothing: its queue members and per item fields become
+ * empty [[no_unique_address]] stand-ins (WQField), the code around them is
+ * discarded with if constexpr, and its setup call fails a static_assert.
+ */
+
+enum WQ_FEATURE : uint32_t
+{
+    WQ_FEATURE_NONE     = 0,
+    WQ_FEATURE_JOURNAL  = 1 << 0,   // EnableJournal
+    WQ_FEATURE_RATE     = 1 << 1,   // SetRateLimit
+    WQ_FEATURE_RETRY    = 1 << 2,   // SetRetryPolicy
+    WQ_FEATURE_CONFLATE = 1 << 3,   // PushConflate
+    WQ_FEATURE_TUNING   = 1 << 4,   // SetBatchTuning
+    WQ_FEATURE_EXPIRY   = 1 << 5,   // PushExpiring
+    WQ_FEATURE_CALL     = 1 << 6,   // PushCall, Submit, Schedule (and the pool's ParallelFor)
+    WQ_FEATURE_ALL      = (1 << 7) - 1,
+};
+
+
+/**
+ * @brief Stand-in of a field whose feature is left out: no storage, reads as T(), writes are dropped.
+ *
+ * Tagged with its feature, empty members of one type could not share an address.
+ */
+template <typename T, uint32_t TFeature = WQ_FEATURE_NONE>
+struct WQNoField
+{
+    WQNoField() = default;
+    template <typename TArg>
+    WQNoField(TArg &&)                          {}
+    template <typename TArg>
+    WQNoField  &operator=(TArg &&)              { return *this; }
+    operator T() const                          { return T();   }
+};
+
+//T if TFeatures has TFeature, else its empty stand-in
+template <uint32_t TFeatures, uint32_t TFeature, typename T>
+using WQField = std::conditional_t<0 != (TFeatures & TFeature), T, WQNoField<T, TFeature>>;
+
+
+
+
+/**
+ * @brief Bundle of the compile-time choices behind a WorkQueue.
+ *
+ * Usage example:
+ * @code
+ * // single producer, latency critical: spin lock, busy Listener, vector batches, lock-free state
+ * class Fast : public WorkQueue<Msg, Fast, WQLowLatencyPolicy> { ... };
+ *
+ * // at most 4096 queued items, no allocation on the push path
+ * class Bounded : public WorkQueue<Msg, Bounded, WQBoundedPolicy<4096>> { ... };
+ *
+ * // plain data items only: no journal, rate limit, retry lane, conflation, tuning, deadlines or callbacks
+ * class Lean : public WorkQueue<Msg, Lean, WQFeaturePolicy<WQLowLatencyPolicy, WQ_FEATURE_NONE>> { ... };
+ * @endcode
+ *
+ * Incompatible combinations fail a static_assert in WorkQueue: WQCondWake waits only on std::mutex,
+ * InitExternal rules out rate limits and retries.
+ */
+template <template <typename> class TContainer = WQDequeContainer,
+          typename                  TLock      = std::mutex,
+          typename                  TWake      = WQCondWake,
+          template <typename> class TDrain     = WQListDrain,
+          typename                  TState     = WQStateShared>
+struct WQPolicy
+{
+    template <typename T>
+    using Container = TContainer<T>;
+    using Lock      = TLock;
+    using Wake      = TWake;
+    template <typename T>
+    using Drain     = TDrain<T>;
+    using State     = TState;
+
+    //Alignment of the independently written field groups of a WorkQueue
+    static constexpr size_t Align = WQ_CACHE_LINE;
+    //Optional machinery compiled in, WQ_FEATURE bits (see WQFeaturePolicy)
+    static constexpr uint32_t Features = WQ_FEATURE_ALL;
+};
+
+
+/**
+ * @brief TBase with another field group alignment, e.g. to pack many idle queues tighter.
+ */
+template <typename TBase, size_t TAlign>
+struct WQAlignPolicy : TBase
+{
+    static constexpr size_t Align = TAlign;
+};
+
+
+/**
+ * @brief TBase with only the optional machinery in TFeatures (WQ_FEATURE bits) compiled in.
+ */
+template <typename TBase, uint32_t TFeatures>
+struct WQFeaturePolicy : TBase
+{
+    static_assert(0 == (TFeatures & ~uint32_t(WQ_FEATURE_ALL)), "WQFeaturePolicy: unknown WQ_FEATURE bits");
+
+    static constexpr uint32_t Features = TFeatures;
+};
+
+
+using WQDefaultPolicy       = WQPolicy<>;
+using WQLowLatencyPolicy    = WQPolicy<WQDequeContainer, WQSpinLock, WQSpinWake, WQVectorDrain, WQStateAtomic>;
+
+template <size_t Capacity>
+using WQBoundedPolicy       = WQPolicy<WQRingContainer<Capacity>::template type, std::mutex, WQFutexWake, WQVectorDrain, WQStateAtomic>;
+
+//eventfd readiness for queues consumed from an epoll loop (WorkQueue::InitExternal, WQReactor); no rate
+//limit or retry lane, the loop thread must not sleep for tokens or backoffs
+using WQEventFdPolicy       = WQFeaturePolicy<WQPolicy<WQDequeContainer, std::mutex, WQEventFdWake, WQVectorDrain, WQStateAtomic>,
+                                              WQ_FEATURE_ALL & ~(WQ_FEATURE_RATE | WQ_FEATURE_RETRY)>;
+
+//Default machinery without cache line padding between the field groups: smaller, for many mostly idle queues
+using WQCompactPolicy       = WQAlignPolicy<WQDefaultPolicy, alignof(std::max_align_t)>;
+
+
+
+
+#endif // __WORK_QUEUE_POLICY_H__
+
+// clang-format on
@@ -0,0 +1,75 @@
+
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_PROBE_H__
+#define __WORK_QUEUE_PROBE_H__
+
+
+/**
+ * USDT (user statically defined tracing) probes on the WorkQueue hot paths.
+ *
+ * Built with -DWORKQUEUE_USDT (CMake option WORKQUEUE_USDT=ON, needs <sys/sdt.h>)
+ * every probe compiles to a single nop plus an ELF note, and can be attached
+ * at runtime by perf, bpftrace or SystemTap under the provider "workqueue":
+ *
+ *   bpftrace -e 'usdt:./app:workqueue:pop_end { @[str(arg0)] = hist(arg1); }'
+ *
+ * Probe                   Arguments
+ *   push                  queue name, size after push, op (0 back, 1 front, 2 fresh, 3 conflate)
+ *   drop                  queue name, size, state
+ *   drain_start           queue name, items moved to the worker batch (fired after the move)
+ *   pop_start             queue name, wait time in ns
+ *   pop_end               queue name, service time in ns
+ *   state                 queue name, old state, new state
+ *   tick                  TickThread address, tick count
+ *   tick_overrun          TickThread address, tick count, Tick() duration in ns, interval in ns
+ *
+ * Every probe has a semaphore (defined in WorkQueueProbe.cpp) that the tracer
+ * raises while it is attached; WQ_PROBE_ENABLED(name) reads it, so arguments that
+ * cost something to compute are only computed for an attached probe:
+ *
+ *   if (WQ_PROBE_ENABLED(tick_overrun)) { ... WQ_PROBE4(tick_overrun, ...); }
+ *
+ * Without WORKQUEUE_USDT the macros expand to nothing, WQ_PROBE_ENABLED to false.
+ */
+
+#if defined(WORKQUEUE_USDT)
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+extern "C"
+{
+extern unsigned short workqueue_push_semaphore;
+extern unsigned short workqueue_drop_semaphore;
+extern unsigned short workqueue_drain_start_semaphore;
+extern unsigned short workqueue_pop_start_semaphore;
+extern unsigned short workqueue_pop_end_semaphore;
+extern unsigned short workqueue_state_semaphore;
+extern unsigned short workqueue_tick_semaphore;
+extern unsigned short workqueue_tick_overrun_semaphore;
+}
+
+#define WQ_PROBE_ENABLED(name)                  __builtin_expect(0 != *static_cast<volatile unsigned short *>(&workqueue_##name##_semaphore), 0)
+
+#define WQ_PROBE1(name, a1)                     DTRACE_PROBE1(workqueue, name, a1)
+#define WQ_PROBE2(name, a1, a2)                 DTRACE_PROBE2(workqueue, name, a1, a2)
+#define WQ_PROBE3(name, a1, a2, a3)             DTRACE_PROBE3(workqueue, name, a1, a2, a3)
+#define WQ_PROBE4(name, a1, a2, a3, a4)         DTRACE_PROBE4(workqueue, name, a1, a2, a3, a4)
+
+#else
+
+#define WQ_PROBE_ENABLED(name)                  false
+
+#define WQ_PROBE1(name, a1)                     do {} while (0)
+#define WQ_PROBE2(name, a1, a2)                 do {} while (0)
+#define WQ_PROBE3(name, a1, a2, a3)             do {} while (0)
+#define WQ_PROBE4(name, a1, a2, a3, a4)         do {} while (0)
+
+#endif
+
+
+#endif // __WORK_QUEUE_PROBE_H__
+
+// clang-format on
@@ -0,0 +1,94 @@
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_RATE_H__
+#define __WORK_QUEUE_RATE_H__
+
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+
+
+
+
+enum class WQ_RATE_UNIT
+{
+    ITEM    = 0,    // one token per Pop
+    BATCH   = 1,    // one token per drained batch
+};
+
+
+/**
+ * @brief Lock-free token bucket (GCRA form), shareable by several worker threads.
+ *
+ * The bucket is kept as a single "theoretical arrival time": taking n tokens
+ * pushes it n intervals forward, a burst of `burst` tokens may be taken ahead of
+ * it. Reserve() always takes the tokens and tells how long the caller must wait
+ * before using them, so concurrent consumers are paced in the order they reserved
+ * and nobody polls. Acquire() only takes what is available now, for a consumer
+ * that sizes its work by the tokens it got (the WorkQueue Listener).
+ */
+class WQTokenBucket
+{
+    public:
+        WQTokenBucket(double ratePerSec, double burst = 1.0)
+            : _intervalNs(1e9 / std::max(ratePerSec, 1e-9))
+            , _burstNs(uint64_t(std::max(burst, 1.0) * _intervalNs))
+        {
+        }
+
+        //Takes `tokens`, returns the nanoseconds (WQNowNs() clock) to wait before they are available
+        uint64_t    Reserve(uint64_t tokens, uint64_t nowNs)
+        {
+            uint64_t cost = uint64_t(double(tokens) * _intervalNs + 0.5);
+            uint64_t tat  = _tat.load(std::memory_order_relaxed);
+            uint64_t next;
+            do
+            {
+                next = std::max(tat, nowNs) + cost;
+            }
+            while (false == _tat.compare_exchange_weak(tat, next, std::memory_order_relaxed));
+
+            uint64_t allowAt = next > _burstNs ? next - _burstNs : 0;
+            return allowAt > nowNs ? allowAt - nowNs : 0;
+        }
+
+        //Takes up to maxTokens of the tokens available at nowNs and returns their count. When none is,
+        //takes nothing, returns 0 and sets waitNs to the nanoseconds until the next one
+        uint64_t    Acquire(uint64_t maxTokens, uint64_t nowNs, uint64_t &waitNs)
+        {
+            waitNs = 0;
+            if (0 == maxTokens)
+                return 0;
+
+            uint64_t tat = _tat.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                uint64_t base = std::max(tat, nowNs);
+                uint64_t one  = uint64_t(_intervalNs + 0.5);
+                if (base + one > nowNs + _burstNs)
+                {
+                    waitNs = base + one - _burstNs - nowNs;
+                    return 0;
+                }
+
+                uint64_t count = std::max<uint64_t>(1, std::min<uint64_t>(maxTokens, uint64_t(double(nowNs + _burstNs - base) / _intervalNs)));
+                if (_tat.compare_exchange_weak(tat, base + uint64_t(double(count) * _intervalNs + 0.5), std::memory_order_relaxed))
+                    return count;
+            }
+        }
+
+        double      RatePerSec() const      { return 1e9 / _intervalNs; }
+
+    private:
+        const double            _intervalNs;
+        const uint64_t          _burstNs;
+        std::atomic<uint64_t>   _tat {0};
+};
+
+
+
+
+#endif // __WORK_QUEUE_RATE_H__
+
+// clang-format on
@@ -0,0 +1,108 @@
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_REACTOR_H__
+#define __WORK_QUEUE_REACTOR_H__
+
+#include "WorkQueue.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <sys/epoll.h>
+
+
+
+
+/**
+ * @brief epoll event loop thread that serves file descriptors and WorkQueues together.
+ *
+ * The reactor variant of the WorkQueue Listener: one epoll_wait() covers the
+ * registered descriptors and the eventfd of each attached queue, so socket I/O
+ * and queued work run on the same thread with no hand-off in between. Attached
+ * queues use WQEventFdWake (WQEventFdPolicy) and are started with InitExternal();
+ * each wake-up drains at most maxBatch items, the eventfd stays readable while
+ * more are pending, so ready descriptors get their turn between batches. Such
+ * a policy has no rate limit or retry lane (WQ_FEATURE), nothing is ever due
+ * without an event, so the loop sleeps in epoll_wait() with no timeout.
+ *
+ * Handlers run on the reactor thread. Remove() and Detach() from another thread
+ * may race with a handler call already in flight; call them from a handler, or
+ * after Release(), to be sure no call follows.
+ *
+ * Usage example:
+ * @code
+ * class Work : public WorkQueue<Msg, Work, WQEventFdPolicy> { ... };
+ *
+ * Work       work;
+ * WQReactor  reactor;
+ * work.InitExternal(WQ_QUEUE_STATE::WORKING, "work");
+ * reactor.Init("net");
+ * reactor.Attach(work);
+ * reactor.Add(sock, EPOLLIN, [&](uint32_t events) { OnReadable(sock); });
+ * ...
+ * reactor.Release();      // stops the loop
+ * work.Release();         // drains what is left on this thread
+ * @endcode
+ */
+class WQReactor : public Thread<WQReactor>
+{
+    public:
+        using Handler = std::function<void(uint32_t events)>;
+
+        ~WQReactor()                                        { Release(); }
+
+        int         Init(const std::string &name = "");
+        void        Release();
+
+        //Runs handler(epoll events) on the reactor thread while fd reports any of events (level triggered)
+        int         Add(int fd, uint32_t events, Handler handler);
+        int         Remove(int fd);
+
+        //Consumes an InitExternal queue with a WQEventFdWake policy on the reactor thread
+        template <typename TQueue>
+        int         Attach(TQueue &que, size_t maxBatch = 64);
+        template <typename TQueue>
+        int         Detach(TQueue &que)                     { return Remove(que.EventFd()); }
+
+        const std::string &Name() const                     { return _name; }
+        uint64_t    Wakeups() const                         { return _wakeups.load(std::memory_order_relaxed); }
+
+        //From Thread
+        void        Run();
+
+    private:
+        struct Entry
+        {
+            Handler                     _handler;
+        };
+
+        std::string                 _name;
+        int                         _epfd   = -1;
+        int                         _stopFd = -1;
+        std::atomic_bool            _quit   {false};
+        std::atomic<uint64_t>       _wakeups{0};
+
+        std::mutex                  _lock;
+        std::unordered_map<int, std::shared_ptr<Entry>> _entries;
+};
+
+
+template <typename TQueue>
+int WQReactor::Attach(TQueue &que, size_t maxBatch /*= 64*/)
+{
+    TQueue *pQue = &que;
+    return Add(que.EventFd(), EPOLLIN, [pQue, maxBatch](uint32_t) { pQue->TryDrain(maxBatch); });
+}
+
+
+
+
+#endif // __WORK_QUEUE_REACTOR_H__
+
+// clang-format on
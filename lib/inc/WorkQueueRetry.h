@@ -0,0 +1,45 @@
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_RETRY_H__
+#define __WORK_QUEUE_RETRY_H__
+
+#include "TimeFrame.h"
+
+#include <algorithm>
+#include <stdint.h>
+
+
+
+
+/**
+ * @brief Retry lane settings of a WorkQueue whose Pop() returns int.
+ *
+ * A non-zero Pop() result reschedules the item after BackoffNs(attempt), growing
+ * by _multiplier from _backoffNs up to _maxBackoffNs. After _maxAttempts failed
+ * Pop() calls the item is dead lettered. _maxAttempts = 0 keeps the lane off and
+ * the Pop() result ignored.
+ */
+struct WQRetryPolicy
+{
+    uint32_t    _maxAttempts    = 0;
+    uint64_t    _backoffNs      = MS_TO_NS(10);
+    uint64_t    _maxBackoffNs   = SEC_TO_NS(10);
+    double      _multiplier     = 2.0;
+
+    //Delay before attempt + 1, attempt counts the failed Pop() calls so far (>= 1)
+    uint64_t    BackoffNs(uint32_t attempt) const
+    {
+        double ns = double(_backoffNs);
+        for (uint32_t i = 1; i < attempt && ns < double(_maxBackoffNs); ++i)
+            ns *= _multiplier;
+        return std::min(uint64_t(ns), _maxBackoffNs);
+    }
+};
+
+
+
+
+#endif // __WORK_QUEUE_RETRY_H__
+
+// clang-format on
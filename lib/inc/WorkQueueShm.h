@@ -0,0 +1,592 @@
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_SHM_H__
+#define __WORK_QUEUE_SHM_H__
+
+#include "Futex.h"
+#include "WorkQueue.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+
+
+
+
+//Shared memory helpers (WorkQueueShm.cpp). WQShmMap creates the named object when `create`
+//is set and it does not exist yet (zero filled, `created` tells), otherwise attaches to it.
+void   *WQShmMap(const std::string &name, size_t bytes, bool create, bool &created);
+void    WQShmUnmap(void *base, size_t bytes);
+int     WQShmUnlink(const std::string &name);
+bool    WQProcessAlive(int32_t pid);
+
+
+
+
+/**
+ * @brief Layout of the shared memory object behind ShmWorkQueue / ShmWorkQueueProducer.
+ *
+ * A bounded multi-producer ring (per cell sequence numbers): a producer claims a
+ * position with a CAS on _head, copies its item into the cell and publishes it by
+ * advancing the cell sequence; the single consumer reads cells in order from _tail.
+ * Everything is address-free atomics, so each process may map it anywhere.
+ *
+ * _dataSeq is the consumer's futex word. Producers only touch it (and only make
+ * a syscall) while the consumer announced it is going to sleep through _waiting.
+ */
+template <typename TData, size_t Capacity>
+struct WQShmSegment
+{
+    static_assert(std::is_trivially_copyable<TData>::value, "shared memory queues need a trivially copyable TData");
+    static_assert(Capacity > 0 && 0 == (Capacity & (Capacity - 1)), "shared memory queue capacity must be a power of two");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory queues need lock-free 64 bit atomics");
+
+    static constexpr uint32_t   MAGIC           = 0x4d485157;   // "WQHM"
+    static constexpr uint32_t   VERSION         = 1;
+    static constexpr size_t     MAX_PRODUCERS   = 64;
+    static constexpr uint64_t   MASK            = Capacity - 1;
+
+    struct alignas(64) Producer
+    {
+        std::atomic<int32_t>    _pid;
+        std::atomic<uint64_t>   _inflight;      // position + 1 being claimed / written, 0 when idle
+        std::atomic<uint64_t>   _pushed;
+    };
+
+    struct Cell
+    {
+        std::atomic<uint64_t>   _seq;           // position: free for it, position + 1: published
+        uint64_t                _tsPush;        // WQNowNs(), comparable across processes
+        TData                   _data;
+    };
+
+    std::atomic<uint32_t>       _magic;         // stored last by the creator
+    uint32_t                    _version;
+    uint32_t                    _itemSize;
+    uint32_t                    _capacity;
+    std::atomic<int32_t>        _consumerPid;
+    std::atomic<uint32_t>       _state;         // WQ_QUEUE_STATE of the consumer
+    std::atomic<uint64_t>       _rejected;
+
+    alignas(64) std::atomic<uint64_t>   _head;
+    alignas(64) std::atomic<uint64_t>   _tail;
+    alignas(64) std::atomic<uint32_t>   _dataSeq;
+    std::atomic<uint32_t>               _waiting;
+
+    Producer                    _producers[MAX_PRODUCERS];
+    Cell                        _cells[Capacity];
+
+    bool    WaitReady() const
+    {
+        for (int retry = 0; MAGIC != _magic.load(std::memory_order_acquire); ++retry)
+        {
+            if (retry >= 10'000)
+                return false;
+            usleep(100);
+        }
+        return VERSION == _version && sizeof(TData) == _itemSize && Capacity == _capacity;
+    }
+
+    WQ_QUEUE_STATE  State() const       { return WQ_QUEUE_STATE(_state.load(std::memory_order_acquire)); }
+};
+
+
+
+
+/**
+ * @brief Consumer side of a WorkQueue whose ring lives in a named POSIX shared memory object.
+ *
+ * Same life cycle as WorkQueue: TDerived provides Begin(), End() and Pop(TData*),
+ * Init() starts the worker thread, SetState() drives it and Release() stops it.
+ * Producers in any process push through ShmWorkQueueProducer with atomics only;
+ * the worker sleeps on a process-shared futex when the ring is empty.
+ *
+ * Crash handling:
+ * - the ring outlives the processes, Init() on an existing object whose consumer
+ *   died takes it over together with the items still queued (the items being
+ *   popped by the dead consumer are lost);
+ * - a producer dying between claiming a cell and publishing it would block the
+ *   ring: once the cell stalled for SetStallTimeout() and its claimer is gone, the
+ *   worker skips it and counts it in Stats()._dropped;
+ * - producers see a dead consumer through ConsumerAlive().
+ *
+ * Usage example:
+ * @code
+ * class Sink : public ShmWorkQueue<Order, Sink> { ... Pop(Order *pData) ... };
+ * Sink sink;
+ * sink.Init(WQ_QUEUE_STATE::WORKING, "/orders");
+ *
+ * // other process
+ * ShmWorkQueueProducer<Order> orders;
+ * orders.Attach("/orders");
+ * orders.Push(order);
+ * @endcode
+ *
+ * @tparam TData Trivially copyable item type
+ * @tparam TDerived The derived class type (CRTP pattern)
+ * @tparam Capacity Ring cells, a power of two, must match on both sides
+ */
+template <typename TData, typename TDerived, size_t Capacity = 4096>
+class ShmWorkQueue : public Thread<ShmWorkQueue<TData, TDerived, Capacity>>
+{
+    public:
+        using TSegment = WQShmSegment<TData, Capacity>;
+
+        virtual ~ShmWorkQueue();
+
+        int                 Init(WQ_QUEUE_STATE state, const std::string &name);
+        void                Release(bool bForce = false);
+        static int          Unlink(const std::string &name)     { return WQShmUnlink(name); }
+
+        void                SetState(WQ_QUEUE_STATE stat);
+        WQ_QUEUE_STATE      GetState() const;
+        void                SetWaitTime(const timespec &tmsp)   { _waitTime.SetWaitTime(tmsp); }
+        timespec            GetWaitTime() const                 { return _waitTime.WaitTime(); }
+        void                SetStallTimeout(uint64_t ns)        { _stallTimeoutNs = ns; }
+
+        size_t              Size() const;
+        const std::string&  Name() const                        { return _name; }
+        const WorkQueueStats& Stats() const                     { return _stats; }
+
+        //Form Thread
+        void                Run();
+
+    private:
+        struct Item
+        {
+            TData       _data;
+            uint64_t    _tsPush;
+        };
+
+        void                Listener();
+        size_t              Drain();
+        void                Sleep();
+        bool                SkipDeadCell(uint64_t pos);
+
+        std::string         _name;
+        TSegment           *_seg = nullptr;
+        WQStateAtomic       _waitTime;              // only its wait time is used, the state lives in _seg
+        uint64_t            _stallTimeoutNs = MS_TO_NS(100);
+        uint64_t            _stallSince     = 0;
+        std::vector<Item>   _batch;
+        WorkQueueStats      _stats;
+};
+
+
+template <typename TData, typename TDerived, size_t Capacity>
+ShmWorkQueue<TData, TDerived, Capacity>::~ShmWorkQueue()
+{
+    Release();
+}
+
+
+template <typename TData, typename TDerived, size_t Capacity>
+int ShmWorkQueue<TData, TDerived, Capacity>::Init(WQ_QUEUE_STATE state, const std::string &name)
+{
+    if (nullptr != _seg)
+        return -1;
+
+    bool created = false;
+    auto *seg = static_cast<TSegment *>(WQShmMap(name, sizeof(TSegment), true, created));
+    if (nullptr == seg)
+        return -1;
+
+    if (created)
+    {
+        seg->_version  = TSegment::VERSION;
+        seg->_itemSize = uint32_t(sizeof(TData));
+        seg->_capacity = uint32_t(Capacity);
+        for (uint64_t pos = 0; pos < Capacity; ++pos)
+            seg->_cells[pos]._seq.store(pos, std::memory_order_relaxed);
+        seg->_magic.store(TSegment::MAGIC, std::memory_order_release);
+    }
+
+    //One consumer at a time, a dead one is replaced
+    int32_t owner = 0;
+    bool ready = seg->WaitReady();
+    while (ready && false == seg->_consumerPid.compare_exchange_strong(owner, int32_t(getpid())))
+        ready = (false == WQProcessAlive(owner));
+    if (false == ready)
+    {
+        WQShmUnmap(seg, sizeof(TSegment));
+        return -1;
+    }
+
+    _name = name;
+    _seg  = seg;
+    _batch.reserve(Capacity);
+    WQClock::Calibrate();
+    SetState(state);
+    this->Start();
+    return 0;
+}
+
+
+template <typename TData, typename TDerived, size_t Capacity>
+void ShmWorkQueue<TData, TDerived, Capacity>::Release(bool bForce /*= false*/)
+{
+    if (nullptr == _seg)
+        return;
+
+    SetState(bForce ? WQ_QUEUE_STATE::EXITING_FORCE : WQ_QUEUE_STATE::EXITING_WAIT);
+    this->Join();
+
+    //Items left by a forced exit stay in the ring for the next consumer
+    SetState(WQ_QUEUE_STATE::NA);
+    _seg->_consumerPid.store(0);
+    WQShmUnmap(_seg, sizeof(TSegment));
+    _seg = nullptr;
+}
+
+
+template <typename TData, typename TDerived, size_t Capacity>
+void ShmWorkQueue<TData, TDerived, Capacity>::SetState(WQ_QUEUE_STATE stat)
+{
+    _seg->_state.store(uint32_t(stat));
+    _seg->_dataSeq.fetch_add(1);
+    FutexWake(_seg->_dataSeq, 1, true);
+}
+
+
+template <typename TData, typename TDerived, size_t Capacity>
+WQ_QUEUE_STATE ShmWorkQueue<TData, TDerived, Capacity>::GetState() const
+{
+    return (nullptr == _seg) ? WQ_QUEUE_STATE::NA : _seg->State();
+}
+
+
+template <typename TData, typename TDerived, size_t Capacity>
+size_t ShmWorkQueue<TData, TDerived, Capacity>::Size() const
+{
+    if (nullptr == _seg)
+        return 0;
+    uint64_t tail = _seg->_tail.load(std::memory_order_acquire);
+    uint64_t head = _seg->_head.load(std::memory_order_acquire);
+    return head > tail ? size_t(head - tail) : 0;
+}
+
+
+template <typename TData, typename TDerived, size_t Capacity>
+void ShmWorkQueue<TData, TDerived, Capacity>::Run()
+{
+    static_cast<TDerived*>(this)->Begin();
+    Listener();
+    static_cast<TDerived*>(this)->End();
+}
+
+
+template <typename TData, typename TDerived, size_t Capacity>
+void ShmWorkQueue<TData, TDerived, Capacity>::Listener()
+{
+    for (;;)
+    {
+        switch (GetState())
+        {
+            case WQ_QUEUE_STATE::PAUSE :
+            {
+                timespec waitTime = GetWaitTime();
+                clock_nanosleep(CLOCK_MONOTONIC, 0, &waitTime, NULL);
+                continue;
+            }
+
+            case WQ_QUEUE_STATE::WORKING :
+            case WQ_QUEUE_STATE::EXITING_WAIT :
+                break;
+
+            default :
+                return;
+        }
+
+        if (0 != Drain())
+            continue;
+
+        if (WQ_QUEUE_STATE::EXITING_WAIT == GetState() && 0 == Size())
+            return;
+
+        Sleep();
+    }
+}
+
+
+template <typename TData, typename TDerived, size_t Capacity>
+size_t ShmWorkQueue<TData, TDerived, Capacity>::Drain()
+{
+    //Copy the published cells out and hand them back to the producers before running Pop
+    _batch.clear();
+    uint64_t tail = _seg->_tail.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        auto &cell = _seg->_cells[tail & TSegment::MASK];
+        if (cell._seq.load(std::memory_order_acquire) != tail + 1)
+            break;
+
+        _batch.push_back(Item{cell._data, cell._tsPush});
+        cell._seq.store(tail + Capacity, std::memory_order_release);
+        _seg->_tail.store(++tail, std::memory_order_release);
+    }
+
+    if (_batch.empty())
+        return 0;
+
+    _stallSince = 0;
+    uint64_t tsNow = WQNowNs();
+    for (auto &item : _batch)
+    {
+        if (WQ_QUEUE_STATE::EXITING_FORCE == GetState())
+        {
+            _stats._dropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        _stats._waitNs.Record(tsNow > item._tsPush ? tsNow - item._tsPush : 0);
+        static_cast<TDerived*>(this)->Pop(&item._data);
+
+        uint64_t tsEnd = WQNowNs();
+        _stats._serviceNs.Record(tsEnd - tsNow);
+        WorkQueueStats::Inc(_stats._popped);
+        tsNow = tsEnd;
+    }
+    return _batch.size();
+}
+
+
+template <typename TData, typename TDerived, size_t Capacity>
+void ShmWorkQueue<TData, TDerived, Capacity>::Sleep()
+{
+    uint64_t tail     = _seg->_tail.load(std::memory_order_relaxed);
+    bool     claimed  = _seg->_head.load(std::memory_order_acquire) != tail;
+
+    //A claimed but unpublished cell: either a producer is writing it right now or it died doing so
+    if (claimed)
+    {
+        uint64_t now = WQNowNs();
+        if (0 == _stallSince)
+            _stallSince = now;
+        else if (now - _stallSince >= _stallTimeoutNs && SkipDeadCell(tail))
+            return;
+    }
+
+    //Pairs with the fence in ShmWorkQueueProducer::Push: either we see its cell or it sees _waiting
+    _seg->_waiting.store(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t       seq   = _seg->_dataSeq.load();
+    WQ_QUEUE_STATE state = GetState();
+    auto          &cell  = _seg->_cells[tail & TSegment::MASK];
+    if (cell._seq.load(std::memory_order_acquire) != tail + 1 &&
+        (WQ_QUEUE_STATE::WORKING == state || WQ_QUEUE_STATE::EXITING_WAIT == state))
+    {
+        timespec stallPoll {0, long(MS_TO_NS(1))};
+        FutexWait(_seg->_dataSeq, seq, claimed ? &stallPoll : nullptr, true);
+    }
+    _seg->_waiting.store(0, std::memory_order_relaxed);
+}
+
+
+template <typename TData, typename TDerived, size_t Capacity>
+bool ShmWorkQueue<TData, TDerived, Capacity>::SkipDeadCell(uint64_t pos)
+{
+    //A producer that lost the CAS for pos and died before withdrawing leaves a stale claim next to
+    //the winner's; a live claim on pos is the winner still writing, however slow it is
+    bool dead = false;
+    for (auto &producer : _seg->_producers)
+    {
+        int32_t pid = producer._pid.load();
+        if (0 == pid || pos + 1 != producer._inflight.load())
+            continue;
+        if (WQProcessAlive(pid))
+            return false;
+        dead = true;
+    }
+    if (false == dead)
+        return false;
+
+    //Checked after the scan: the winner publishes before it withdraws its claim
+    auto &cell = _seg->_cells[pos & TSegment::MASK];
+    if (cell._seq.load(std::memory_order_acquire) == pos + 1)
+        return false;                                           // published after all
+
+    cell._seq.store(pos + Capacity, std::memory_order_release);
+    _seg->_tail.store(pos + 1, std::memory_order_release);
+    for (auto &producer : _seg->_producers)
+    {
+        if (pos + 1 != producer._inflight.load())
+            continue;
+        producer._inflight.store(0);
+        producer._pid.store(0);
+    }
+    _stats._dropped.fetch_add(1, std::memory_order_relaxed);
+    _stallSince = 0;
+    return true;
+}
+
+
+
+
+/**
+ * @brief Producer side of a ShmWorkQueue, usable from any process.
+ *
+ * Attach() takes one of the segment's producer slots (a slot of a dead process is
+ * reused). One instance per producing thread; Push() is a CAS and a copy, plus a
+ * futex wake only when the consumer sleeps.
+ */
+template <typename TData, size_t Capacity = 4096>
+class ShmWorkQueueProducer
+{
+    public:
+        using TSegment = WQShmSegment<TData, Capacity>;
+
+        ShmWorkQueueProducer() = default;
+        ~ShmWorkQueueProducer()                 { Detach(); }
+
+        ShmWorkQueueProducer(const ShmWorkQueueProducer &) = delete;
+        ShmWorkQueueProducer &operator=(const ShmWorkQueueProducer &) = delete;
+
+        int                 Attach(const std::string &name);
+        void                Detach();
+
+        //false when not attached, the consumer is not WORKING or the ring is full
+        bool                Push(const TData &data);
+
+        bool                ConsumerAlive() const;
+        size_t              Size() const;
+        uint64_t            Pushed() const      { return nullptr == _slot ? 0 : _slot->_pushed.load(std::memory_order_relaxed); }
+
+    private:
+        TSegment                       *_seg  = nullptr;
+        typename TSegment::Producer    *_slot = nullptr;
+};
+
+
+template <typename TData, size_t Capacity>
+int ShmWorkQueueProducer<TData, Capacity>::Attach(const std::string &name)
+{
+    if (nullptr != _seg)
+        return -1;
+
+    bool created = false;
+    auto *seg = static_cast<TSegment *>(WQShmMap(name, sizeof(TSegment), false, created));
+    if (nullptr == seg)
+        return -1;
+
+    if (seg->WaitReady())
+    {
+        int32_t  self = int32_t(getpid());
+        uint64_t tail = seg->_tail.load();
+        for (auto &producer : seg->_producers)
+        {
+            //Free, or left by a dead process that was not in the middle of a push
+            int32_t  pid      = producer._pid.load();
+            uint64_t inflight = producer._inflight.load();
+            bool     reusable = (0 == pid) || (false == WQProcessAlive(pid) && (0 == inflight || inflight <= tail));
+            if (reusable && producer._pid.compare_exchange_strong(pid, self))
+            {
+                producer._inflight.store(0);
+                producer._pushed.store(0, std::memory_order_relaxed);
+                _seg  = seg;
+                _slot = &producer;
+                return 0;
+            }
+        }
+    }
+
+    WQShmUnmap(seg, sizeof(TSegment));
+    return -1;
+}
+
+
+template <typename TData, size_t Capacity>
+void ShmWorkQueueProducer<TData, Capacity>::Detach()
+{
+    if (nullptr == _seg)
+        return;
+
+    _slot->_pid.store(0);
+    WQShmUnmap(_seg, sizeof(TSegment));
+    _seg  = nullptr;
+    _slot = nullptr;
+}
+
+
+template <typename TData, size_t Capacity>
+bool ShmWorkQueueProducer<TData, Capacity>::Push(const TData &data)
+{
+    if (nullptr == _seg || WQ_QUEUE_STATE::WORKING != _seg->State())
+    {
+        if (nullptr != _seg)
+            _seg->_rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    uint64_t pos = _seg->_head.load(std::memory_order_relaxed);
+    typename TSegment::Cell *cell;
+    for (;;)
+    {
+        cell = &_seg->_cells[pos & TSegment::MASK];
+        int64_t diff = int64_t(cell->_seq.load(std::memory_order_acquire) - pos);
+        if (0 == diff)
+        {
+            //Announce the claim first, the consumer must find it if we die before publishing
+            _slot->_inflight.store(pos + 1);
+            if (_seg->_head.compare_exchange_weak(pos, pos + 1))
+                break;
+            //Lost the cell: withdraw the claim, a stale one could make the consumer skip the winner's cell
+            _slot->_inflight.store(0);
+        }
+        else if (diff < 0)
+        {
+            _slot->_inflight.store(0, std::memory_order_relaxed);
+            _seg->_rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            pos = _seg->_head.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->_tsPush = WQNowNs();
+    cell->_data   = data;
+    cell->_seq.store(pos + 1, std::memory_order_release);
+    _slot->_inflight.store(0, std::memory_order_relaxed);
+    WorkQueueStats::Inc(_slot->_pushed);
+
+    //Pairs with the consumer's _waiting store / _dataSeq load
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (0 != _seg->_waiting.load(std::memory_order_relaxed))
+    {
+        _seg->_dataSeq.fetch_add(1);
+        FutexWake(_seg->_dataSeq, 1, true);
+    }
+    return true;
+}
+
+
+template <typename TData, size_t Capacity>
+bool ShmWorkQueueProducer<TData, Capacity>::ConsumerAlive() const
+{
+    return nullptr != _seg && WQProcessAlive(_seg->_consumerPid.load());
+}
+
+
+template <typename TData, size_t Capacity>
+size_t ShmWorkQueueProducer<TData, Capacity>::Size() const
+{
+    if (nullptr == _seg)
+        return 0;
+    uint64_t tail = _seg->_tail.load(std::memory_order_acquire);
+    uint64_t head = _seg->_head.load(std::memory_order_acquire);
+    return head > tail ? size_t(head - tail) : 0;
+}
+
+
+
+
+#endif // __WORK_QUEUE_SHM_H__
+
+// clang-format on
@@ -0,0 +1,189 @@
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_SPSC_H__
+#define __WORK_QUEUE_SPSC_H__
+
+#include "Futex.h"
+#include "TimeFrame.h"
+#include "WorkQueueLayout.h"
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+
+/**
+ * @brief Bounded single-producer / single-consumer ring.
+ *
+ * Capacity is rounded up to a power of two. Head and tail live on their own
+ * cache lines and each side keeps a cached copy of the other's index, so the
+ * shared lines are only touched when the cached view says full / empty.
+ *
+ * Items are moved in and consumed in place: Consume() hands the slot to the
+ * callback and destroys it afterwards, nothing is copied on the way through.
+ */
+template <typename T>
+class WQSpscRing
+{
+    public:
+        explicit WQSpscRing(size_t capacity);
+        ~WQSpscRing();
+
+        WQSpscRing(const WQSpscRing &) = delete;
+        WQSpscRing &operator=(const WQSpscRing &) = delete;
+
+        //Producer side. The item is left untouched when the ring is full
+        bool        TryPush(T &&item);
+        bool        Full() const;
+
+        //Consumer side. fn(T&) runs on the slot, which is freed when fn returns
+        template <typename F>
+        bool        Consume(F &&fn);
+        bool        Empty() const;
+
+        size_t      Capacity() const        { return _mask + 1; }
+
+    private:
+        struct Slot
+        {
+            alignas(T) unsigned char _buf[sizeof(T)];
+            T*  Item()                      { return std::launder(reinterpret_cast<T *>(_buf)); }
+        };
+
+        alignas(WQ_CACHE_LINE) std::atomic<size_t>  _head {0};      // next slot to consume
+        size_t                                      _tailCache = 0; // consumer's view of _tail
+        alignas(WQ_CACHE_LINE) std::atomic<size_t>  _tail {0};      // next slot to fill
+        size_t                                      _headCache = 0; // producer's view of _head
+        alignas(WQ_CACHE_LINE) size_t               _mask = 0;
+        std::unique_ptr<Slot[]>                     _slots;
+};
+
+
+template <typename T>
+WQSpscRing<T>::WQSpscRing(size_t capacity)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+    _mask  = size - 1;
+    _slots = std::make_unique<Slot[]>(size);
+}
+
+
+template <typename T>
+WQSpscRing<T>::~WQSpscRing()
+{
+    for (size_t idx = _head.load(); idx != _tail.load(); ++idx)
+        _slots[idx & _mask].Item()->~T();
+}
+
+
+template <typename T>
+bool WQSpscRing<T>::TryPush(T &&item)
+{
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _headCache > _mask)
+    {
+        _headCache = _head.load(std::memory_order_acquire);
+        if (tail - _headCache > _mask)
+            return false;
+    }
+
+    new (_slots[tail & _mask]._buf) T(std::move(item));
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+
+template <typename T>
+bool WQSpscRing<T>::Full() const
+{
+    return _tail.load(std::memory_order_relaxed) - _head.load(std::memory_order_acquire) > _mask;
+}
+
+
+template <typename T>
+template <typename F>
+bool WQSpscRing<T>::Consume(F &&fn)
+{
+    size_t head = _head.load(std::memory_order_relaxed);
+    if (head == _tailCache)
+    {
+        _tailCache = _tail.load(std::memory_order_acquire);
+        if (head == _tailCache)
+            return false;
+    }
+
+    T *item = _slots[head & _mask].Item();
+    fn(*item);
+    item->~T();
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+
+template <typename T>
+bool WQSpscRing<T>::Empty() const
+{
+    return _head.load(std::memory_order_relaxed) == _tail.load(std::memory_order_acquire);
+}
+
+
+
+
+/**
+ * @brief Futex parking spot for one thread (or a few sharing the same reason to wait).
+ *
+ * Park(ready) announces the waiter, re-checks ready() and sleeps; Unpark() only
+ * issues the wake syscall when someone announced itself. The seq_cst fences on
+ * both sides close the window between the waiter's re-check and the waker's
+ * state change. The sleep is bounded by `timeout`, callers loop on their condition.
+ */
+class WQParker
+{
+    public:
+        template <typename F>
+        void        Park(F &&ready, uint64_t timeoutNs = MS_TO_NS(10));
+        void        Unpark();
+
+    private:
+        std::atomic<uint32_t>   _parked {0};
+};
+
+
+template <typename F>
+void WQParker::Park(F &&ready, uint64_t timeoutNs /*= MS_TO_NS(10)*/)
+{
+    _parked.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (false == ready())
+    {
+        timespec timeout {time_t(timeoutNs / SEC_TO_NS(1)), long(timeoutNs % SEC_TO_NS(1))};
+        FutexWait(_parked, 1, &timeout);
+    }
+    _parked.store(0, std::memory_order_relaxed);
+}
+
+
+inline void WQParker::Unpark()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (0 != _parked.load(std::memory_order_relaxed))
+    {
+        _parked.store(0, std::memory_order_relaxed);
+        FutexWake(_parked);
+    }
+}
+
+
+
+
+#endif // __WORK_QUEUE_SPSC_H__
+
+// clang-format on
@@ -0,0 +1,156 @@
+
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_STATS_H__
+#define __WORK_QUEUE_STATS_H__
+
+#include "TimeFrame.h"
+#include "WorkQueueLayout.h"
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <stdint.h>
+#include <time.h>
+
+
+
+
+/**
+ * @brief Clock used to stamp queued items; differences are converted with WQClock::ToNs().
+ */
+using WQClock = ClockTsc;
+
+
+/**
+ * @brief Nanoseconds between two WQClock readings, clamped at zero against cross-core skew.
+ */
+inline uint64_t WQClockDiffNs(uint64_t from, uint64_t to)
+{
+    int64_t ns = WQClock::ToNs(int64_t(to - from));
+    return ns > 0 ? uint64_t(ns) : 0;
+}
+
+
+/**
+ * @brief Monotonic time in nanoseconds, for the infrequent (reporting side) readings.
+ */
+inline uint64_t WQNowNs()
+{
+    return ClockMonotonic::Now();
+}
+
+
+/**
+ * @brief text escaped for a JSON string literal (quotes, backslashes, control characters), without the quotes.
+ *
+ * Queue names are user supplied; every JSON export (metrics, traces, bench report) goes through this.
+ */
+std::string WQEscapeJson(const std::string &text);
+
+
+
+
+/**
+ * @brief Plain copy of a WQHistogram, taken by readers.
+ */
+struct WQHistogramSnapshot
+{
+    static constexpr size_t BUCKET_COUNT = 64;
+
+    std::array<uint64_t, BUCKET_COUNT>  _buckets {};
+    uint64_t                            _count = 0;
+    uint64_t                            _sum   = 0;
+
+    double  Percentile(double pct) const;
+    double  Mean() const    { return _count ? double(_sum) / _count : 0.0; }
+
+    WQHistogramSnapshot operator - (const WQHistogramSnapshot &rhs) const;
+};
+
+
+/**
+ * @brief Log2 bucketed latency histogram with a single writer and any number of readers.
+ *
+ * Bucket b counts the values in [2^(b-1), 2^b) nanoseconds. Record() is meant to be
+ * called from one thread only (the queue worker), so the counters are advanced with
+ * relaxed load/store pairs instead of locked read-modify-write instructions.
+ * Readers never block the writer; a snapshot may be off by the record in flight.
+ */
+class WQHistogram
+{
+    public:
+        void                Record(uint64_t ns);
+        WQHistogramSnapshot Snapshot() const;
+        uint64_t            Count() const           { return _count.load(std::memory_order_relaxed); }
+
+        static size_t       Bucket(uint64_t ns)     { return ns ? size_t(64 - __builtin_clzll(ns)) : 0; }
+
+    private:
+        std::array<std::atomic<uint64_t>, WQHistogramSnapshot::BUCKET_COUNT> _buckets {};
+        std::atomic<uint64_t>   _count {0};
+        std::atomic<uint64_t>   _sum   {0};
+};
+
+
+inline void WQHistogram::Record(uint64_t ns)
+{
+    size_t bucket = std::min(Bucket(ns), WQHistogramSnapshot::BUCKET_COUNT - 1);
+
+    _buckets[bucket].store(_buckets[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    _sum.store  (_sum.load  (std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+    _count.store(_count.load(std::memory_order_relaxed) + 1,  std::memory_order_relaxed);
+}
+
+
+
+
+/**
+ * @brief Counters and latency distributions of a single WorkQueue.
+ *
+ * pushed / popped / dropped are monotonic. _waitNs is the time an item spent in the
+ * queue (PushXxx to the start of Pop), _serviceNs is the duration of Pop itself.
+ * _throttledNs is the time the worker waited for rate limit tokens. _expired and
+ * _cancelled count PushExpiring items discarded before Pop (not part of _dropped).
+ * _retried counts failed Pop calls that rescheduled an item, _deadLettered the items
+ * that failed every attempt (neither is part of _popped); _retryNs is push to final
+ * outcome of the items that needed a retry. _rehomed counts pending items moved to
+ * other workers of a pool (WorkQueuePool::Rehome), they complete here as they leave.
+ * _inlined counts the items PushOrRun popped on a pushing thread, pending ones it
+ * ran ahead of its own included (they are part of _pushed and _popped as well).
+ *
+ * Counters bumped on the push path and those written by the worker sit on separate
+ * cache lines.
+ */
+struct WorkQueueStats
+{
+    //Producer side
+    alignas(WQ_CACHE_LINE) std::atomic<uint64_t> _pushed {0};
+    std::atomic<uint64_t>   _dropped     {0};
+    std::atomic<uint64_t>   _rehomed     {0};
+    std::atomic<uint64_t>   _inlined     {0};
+
+    //Worker side
+    alignas(WQ_CACHE_LINE) std::atomic<uint64_t> _popped {0};
+    std::atomic<uint64_t>   _throttledNs {0};
+    std::atomic<uint64_t>   _expired     {0};
+    std::atomic<uint64_t>   _cancelled   {0};
+    std::atomic<uint64_t>   _retried     {0};
+    std::atomic<uint64_t>   _deadLettered{0};
+
+    WQHistogram             _waitNs;
+    WQHistogram             _serviceNs;
+    WQHistogram             _retryNs;
+
+    //Single writer helper, see WQHistogram
+    static void Inc(std::atomic<uint64_t> &counter, uint64_t val = 1)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+    }
+};
+
+
+#endif // __WORK_QUEUE_STATS_H__
+
+// clang-format on
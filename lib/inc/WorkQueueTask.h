@@ -0,0 +1,251 @@
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_TASK_H__
+#define __WORK_QUEUE_TASK_H__
+
+#include "WorkQueue.h"
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+
+
+/**
+ * @brief Move-only type-erased `void()` callable stored inline in Capacity bytes.
+ *
+ * Callables that fit (size, alignment and a noexcept move) live in the object
+ * itself; anything larger is moved into a heap block and only the pointer is
+ * kept inline. FitsInline<F>() tells at compile time which path a callable takes.
+ *
+ * @tparam Capacity Inline storage in bytes, at least sizeof(void*)
+ */
+template <size_t Capacity = 64>
+class WQTask
+{
+    static_assert(Capacity >= sizeof(void *), "WQTask capacity must hold at least a pointer");
+
+    public:
+        template <typename F>
+        static constexpr bool FitsInline()
+        {
+            return sizeof(F) <= Capacity && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible<F>::value;
+        }
+
+        WQTask() = default;
+
+        template <typename F, typename = std::enable_if_t<false == std::is_same<std::decay_t<F>, WQTask>::value>>
+        WQTask(F &&fn);
+
+        WQTask(WQTask &&other) noexcept                 { MoveFrom(other);                          }
+        WQTask &operator=(WQTask &&other) noexcept      { if (this != &other) { Reset(); MoveFrom(other); } return *this; }
+        ~WQTask()                                       { Reset();                                  }
+
+        WQTask(const WQTask &) = delete;
+        WQTask &operator=(const WQTask &) = delete;
+
+        void        operator()()                        { if (nullptr != _ops) _ops->_invoke(_buf); }
+        explicit    operator bool() const               { return nullptr != _ops;                   }
+        bool        IsInline() const                    { return nullptr != _ops && _ops->_inline;  }
+        void        Reset()                             { if (nullptr != _ops) { _ops->_destroy(_buf); _ops = nullptr; } }
+
+    private:
+        struct Ops
+        {
+            void    (*_invoke) (void *buf);
+            void    (*_move)   (void *dst, void *src);     // move constructs dst from src and destroys src
+            void    (*_destroy)(void *buf);
+            bool    _inline;
+        };
+
+        template <typename F>
+        struct InlineOps
+        {
+            static F*   Get(void *buf)                  { return std::launder(reinterpret_cast<F *>(buf)); }
+            static void Invoke(void *buf)               { (*Get(buf))(); }
+            static void Move(void *dst, void *src)      { new (dst) F(std::move(*Get(src))); Get(src)->~F(); }
+            static void Destroy(void *buf)              { Get(buf)->~F(); }
+
+            static constexpr Ops _ops {&Invoke, &Move, &Destroy, true};
+        };
+
+        template <typename F>
+        struct HeapOps
+        {
+            static F*&  Get(void *buf)                  { return *std::launder(reinterpret_cast<F **>(buf)); }
+            static void Invoke(void *buf)               { (*Get(buf))(); }
+            static void Move(void *dst, void *src)      { new (dst) F*(Get(src)); }
+            static void Destroy(void *buf)              { delete Get(buf); }
+
+            static constexpr Ops _ops {&Invoke, &Move, &Destroy, false};
+        };
+
+        void        MoveFrom(WQTask &other)
+        {
+            _ops = other._ops;
+            if (nullptr != _ops)
+                _ops->_move(_buf, other._buf);
+            other._ops = nullptr;
+        }
+
+        alignas(std::max_align_t) unsigned char _buf[Capacity];
+        const Ops                              *_ops = nullptr;
+};
+
+
+template <size_t Capacity>
+template <typename F, typename>
+WQTask<Capacity>::WQTask(F &&fn)
+{
+    using TFn = std::decay_t<F>;
+    if constexpr (FitsInline<TFn>())
+    {
+        new (_buf) TFn(std::forward<F>(fn));
+        _ops = &InlineOps<TFn>::_ops;
+    }
+    else
+    {
+        new (_buf) TFn*(new TFn(std::forward<F>(fn)));
+        _ops = &HeapOps<TFn>::_ops;
+    }
+}
+
+
+
+
+/**
+ * @brief Ready-made WorkQueue running WQTask callables, one queue for heterogeneous work.
+ *
+ * The default policy keeps up to 4096 pending tasks in a ring and drains them in
+ * vector batches: it allocates only the ring, on the first Post, after which a
+ * Post that fits Capacity never allocates; a Post finding the ring full is dropped
+ * and counted in Stats()._dropped. BoundedTaskQueue picks another ring size.
+ * UnboundedTaskQueue never drops for lack of room, at the price of a list node
+ * per Post (plus deque blocks as the backlog grows).
+ *
+ * Usage example:
+ * @code
+ * TaskQueue<> que;
+ * que.Init(WQ_QUEUE_STATE::WORKING, "tasks");
+ * que.Post([buf = std::move(buf)]() { Write(buf); });
+ * @endcode
+ *
+ * HeapFallbacks() counts the tasks run here that did not fit Capacity.
+ */
+template <size_t Capacity = 64, typename TPolicy = WQBoundedPolicy<4096>>
+class TaskQueue : public WorkQueue<WQTask<Capacity>, TaskQueue<Capacity, TPolicy>, TPolicy>
+{
+    public:
+        using TTask = WQTask<Capacity>;
+
+        void        Begin()                 {}
+        void        End()                   {}
+        void        Pop(TTask *task);
+
+        template <typename F>
+        size_t      Post(F &&fn, WQ_PUSH_OP op = WQ_PUSH_OP::BACK);
+
+        uint64_t    HeapFallbacks() const   { return _heapFallbacks.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t>   _heapFallbacks {0};
+};
+
+
+template <size_t Capacity, typename TPolicy>
+void TaskQueue<Capacity, TPolicy>::Pop(TTask *task)
+{
+    //Counted when run, so posts the queue rejected do not show up
+    if (false == task->IsInline())
+        _heapFallbacks.fetch_add(1, std::memory_order_relaxed);
+    (*task)();
+}
+
+
+template <size_t Capacity, typename TPolicy>
+template <typename F>
+size_t TaskQueue<Capacity, TPolicy>::Post(F &&fn, WQ_PUSH_OP op /*= WQ_PUSH_OP::BACK*/)
+{
+    switch (op)
+    {
+        case WQ_PUSH_OP::FRONT :    return this->PushFront(TTask(std::forward<F>(fn)));
+        case WQ_PUSH_OP::FRESH :    return this->PushFresh(TTask(std::forward<F>(fn)));
+        default :                   return this->PushBack (TTask(std::forward<F>(fn)));
+    }
+}
+
+
+
+
+/**
+ * @brief WorkQueuePool running WQTask callables on the least loaded worker.
+ *
+ * Post() returns the index of the worker queue that took the task, -1 if none.
+ * Like TaskQueue each worker keeps its pending tasks in a ring of 4096 by default,
+ * BoundedTaskPool picks another size and UnboundedTaskPool allocates per Post instead.
+ */
+template <size_t Capacity = 64, typename TPolicy = WQBoundedPolicy<4096>>
+class TaskPool : public WorkQueuePool<WQTask<Capacity>, TaskPool<Capacity, TPolicy>, TPolicy>
+{
+    public:
+        using TTask = WQTask<Capacity>;
+
+        TaskPool(size_t queCount) : WorkQueuePool<WQTask<Capacity>, TaskPool<Capacity, TPolicy>, TPolicy>(queCount) {}
+
+        void        Begin()                 {}
+        void        End()                   {}
+        void        Pop(TTask *task);
+
+        template <typename F>
+        int         Post(F &&fn);
+
+        uint64_t    HeapFallbacks() const   { return _heapFallbacks.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t>   _heapFallbacks {0};
+};
+
+
+template <size_t Capacity, typename TPolicy>
+void TaskPool<Capacity, TPolicy>::Pop(TTask *task)
+{
+    if (false == task->IsInline())
+        _heapFallbacks.fetch_add(1, std::memory_order_relaxed);
+    (*task)();
+}
+
+
+template <size_t Capacity, typename TPolicy>
+template <typename F>
+int TaskPool<Capacity, TPolicy>::Post(F &&fn)
+{
+    return this->PushBack(TTask(std::forward<F>(fn)));
+}
+
+
+
+
+//Bounded presets: Slots pending tasks per queue in a ring, the only allocation, made on the first Post
+template <size_t Capacity = 64, size_t Slots = 4096>
+using BoundedTaskQueue    = TaskQueue<Capacity, WQBoundedPolicy<Slots>>;
+
+template <size_t Capacity = 64, size_t Slots = 4096>
+using BoundedTaskPool     = TaskPool<Capacity, WQBoundedPolicy<Slots>>;
+
+//Unbounded presets: no Post is dropped for lack of room, each one allocates a list node
+template <size_t Capacity = 64>
+using UnboundedTaskQueue  = TaskQueue<Capacity, WQDefaultPolicy>;
+
+template <size_t Capacity = 64>
+using UnboundedTaskPool   = TaskPool<Capacity, WQDefaultPolicy>;
+
+
+
+
+#endif // __WORK_QUEUE_TASK_H__
+
+// clang-format on
@@ -0,0 +1,81 @@
+
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_TRACE_H__
+#define __WORK_QUEUE_TRACE_H__
+
+#include "WorkQueueStats.h"
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+
+
+
+enum class WQ_TRACE_EVENT : uint8_t
+{
+    PUSH    = 1,    // producer, lock wait + insert, per sampled item
+    DRAIN   = 2,    // consumer, container drained into the local batch
+    POP     = 3,    // consumer, Pop() of a sampled item
+};
+
+
+/**
+ * @brief Opt-in, sampled lifecycle tracing of queued items.
+ *
+ * When enabled, every N-th item of each queue is traced: its push (including the
+ * time spent acquiring _thLockQue), the drain that moved it to the worker and its
+ * Pop. Events are written by the producing thread into its own lock-free ring
+ * buffer (oldest events are overwritten), so tracing never adds contention between
+ * threads. A ring outlives its thread and is handed to the next thread that
+ * starts tracing, so thread churn does not grow memory. DumpChrome() renders all rings as Chrome trace-event JSON, loadable in
+ * Perfetto or chrome://tracing; push and Pop of the same item are linked by a flow
+ * arrow.
+ *
+ * When disabled the hot path pays one relaxed load per push, drain and Pop.
+ *
+ * Usage example:
+ * @code
+ * WQTrace::Enable(100);                // 1 in 100 items
+ * ...
+ * WQTrace::DumpChrome("/tmp/wq.json");
+ * @endcode
+ */
+class WQTrace
+{
+    public:
+        static void         Enable(uint32_t sampleEvery = 1, size_t ringSize = 1 << 16);
+        static void         Disable();
+        static bool         Enabled()           { return s_enabled.load(std::memory_order_relaxed); }
+        static void         Clear();
+        //Per-thread rings allocated so far, rings of exited threads are reused
+        static size_t       RingCount();
+
+        static uint32_t     RegisterQueue(const std::string &name);
+        static uint64_t     ItemId(uint32_t queueId, std::atomic<uint64_t> &seq);
+
+        static void         Record(WQ_TRACE_EVENT type, uint32_t queueId, uint64_t itemId, uint64_t ts, uint64_t tsEnd, uint32_t arg = 0);
+
+        static std::string  DumpChrome();
+        static int          DumpChrome(const std::string &path);
+
+    private:
+        static std::atomic_bool     s_enabled;
+        static std::atomic<uint32_t> s_sampleEvery;
+};
+
+
+inline uint64_t WQTrace::ItemId(uint32_t queueId, std::atomic<uint64_t> &seq)
+{
+    uint64_t num = seq.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (0 != (num % s_sampleEvery.load(std::memory_order_relaxed)))
+        return 0;
+    return (uint64_t(queueId) << 40) | (num & ((uint64_t(1) << 40) - 1));
+}
+
+
+#endif // __WORK_QUEUE_TRACE_H__
+
+// clang-format on
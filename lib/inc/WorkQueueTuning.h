@@ -0,0 +1,100 @@
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_TUNING_H__
+#define __WORK_QUEUE_TUNING_H__
+
+#include "TimeFrame.h"
+#include "WorkQueueStats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+
+
+
+
+/**
+ * @brief Adaptive batching settings of a WorkQueue Listener, see WorkQueue::SetBatchTuning.
+ */
+struct WQBatchTuning
+{
+    uint64_t    _sloNs          = MS_TO_NS(1);  // target push to end of Pop() latency of the slowest item of a batch
+    size_t      _minBatch       = 1;
+    size_t      _maxBatch       = 1024;
+    uint64_t    _maxLingerNs    = 0;            // longest extra wait for an underfilled batch, 0 never lingers
+};
+
+
+/**
+ * @brief Batch size and linger controller of one Listener, fed after every batch.
+ *
+ * Over the SLO the batch cap and the linger are halved. Under it, a batch the cap
+ * cut short grows the cap by an eighth, and an underfilled batch with more than
+ * half the SLO to spare doubles the linger (bounded by _maxLingerNs and half of that
+ * headroom), so a lightly loaded queue collects more items per wake-up; with less
+ * headroom the linger decays. It starts at _maxBatch without linger, which is the
+ * untuned Listener. Batch() and LingerNs() are the current decisions and may be read
+ * from any thread.
+ */
+class WQBatchTuner
+{
+    public:
+        void        Configure(const WQBatchTuning &cfg)
+        {
+            _cfg = cfg;
+            _cfg._minBatch = std::max<size_t>(_cfg._minBatch, 1);
+            _cfg._maxBatch = std::max(_cfg._maxBatch, _cfg._minBatch);
+            _batch.store(_cfg._maxBatch, std::memory_order_relaxed);
+            _lingerNs.store(0, std::memory_order_relaxed);
+        }
+
+        //taken: items of the batch, worstNs: its slowest push to end of Pop() latency
+        void        Update(size_t taken, uint64_t worstNs)
+        {
+            size_t   batch  = Batch();
+            uint64_t linger = LingerNs();
+            if (worstNs > _cfg._sloNs)
+            {
+                batch  = std::max(_cfg._minBatch, batch / 2);
+                linger = linger / 2;
+            }
+            else if (taken >= batch)
+            {
+                batch  = std::min(_cfg._maxBatch, batch + std::max<size_t>(1, batch / 8));
+            }
+            else if (_cfg._sloNs - worstNs > _cfg._sloNs / 2)
+            {
+                linger = std::min({_cfg._maxLingerNs, (_cfg._sloNs - worstNs) / 2, std::max<uint64_t>(linger * 2, US_TO_NS(1))});
+            }
+            else
+            {
+                linger = linger - linger / 4;
+            }
+
+            _batch.store(batch, std::memory_order_relaxed);
+            _lingerNs.store(linger, std::memory_order_relaxed);
+            WorkQueueStats::Inc(_wakeups);
+            WorkQueueStats::Inc(_items, taken);
+        }
+
+        const WQBatchTuning &Config() const     { return _cfg; }
+        size_t      Batch() const               { return _batch.load(std::memory_order_relaxed);    }
+        uint64_t    LingerNs() const            { return _lingerNs.load(std::memory_order_relaxed); }
+        uint64_t    Wakeups() const             { return _wakeups.load(std::memory_order_relaxed);  }
+        uint64_t    Items() const               { return _items.load(std::memory_order_relaxed);    }
+
+    private:
+        WQBatchTuning           _cfg;
+        std::atomic<size_t>     _batch    {SIZE_MAX};
+        std::atomic<uint64_t>   _lingerNs {0};
+        std::atomic<uint64_t>   _wakeups  {0};      // batches fed to Update()
+        std::atomic<uint64_t>   _items    {0};
+};
+
+
+
+
+#endif // __WORK_QUEUE_TUNING_H__
+
+// clang-format on
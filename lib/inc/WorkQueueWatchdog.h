@@ -0,0 +1,224 @@
+// clang-format off
+
+
+#ifndef __WORK_QUEUE_WATCHDOG_H__
+#define __WORK_QUEUE_WATCHDOG_H__
+
+#include "WorkQueue.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+
+
+
+enum class WQ_WATCHDOG_EVENT
+{
+    STALL       = 0,    // a worker has been inside one Pop() longer than _popBudgetNs
+    RECOVERED   = 1,    // a stalled worker finished that Pop()
+    BACKLOG     = 2,    // a worker's pending items exceeded _backlogBudget
+    GROWTH      = 3,    // a worker's backlog grew faster than _growthBudget
+};
+
+
+inline const char *WQ_WATCHDOG_EVENT_text(WQ_WATCHDOG_EVENT event)
+{
+    switch (event)
+    {
+        case WQ_WATCHDOG_EVENT::STALL     : return "STALL";
+        case WQ_WATCHDOG_EVENT::RECOVERED : return "RECOVERED";
+        case WQ_WATCHDOG_EVENT::BACKLOG   : return "BACKLOG";
+        case WQ_WATCHDOG_EVENT::GROWTH    : return "GROWTH";
+    }
+    return "UNKNOWN";
+}
+
+
+struct WQWatchdogConfig
+{
+    uint64_t    _popBudgetNs    = SEC_TO_NS(1); // a Pop() running longer stalls its worker, 0 off
+    size_t      _backlogBudget  = 0;            // pending items of one worker, 0 off
+    double      _growthBudget   = 0;            // backlog growth of one worker in items/s between two ticks, 0 off
+    bool        _rehome         = false;        // move the pending items of stalled workers to healthy ones
+};
+
+
+struct WQWatchdogEvent
+{
+    WQ_WATCHDOG_EVENT   _event;
+    size_t              _worker;
+    uint64_t            _popNs;         // how long the current Pop() has been running
+    size_t              _backlog;       // pending items
+    double              _growth;        // items/s since the previous tick
+    size_t              _rehomed;       // items moved away on this tick
+};
+
+
+/**
+ * @brief TickThread that watches the workers of a WorkQueuePool for hung Pop() calls and backlog.
+ *
+ * Each tick reads every worker's current Pop() runtime (WorkQueue::PopRunningNs, fed
+ * by one relaxed store per item) and pending count. A worker is stalled once its Pop()
+ * exceeded the budget on two ticks in a row, so a torn read can not raise an alarm.
+ * Events are edge triggered: STALL / BACKLOG / GROWTH when a budget starts being
+ * exceeded, RECOVERED when a stalled worker moves on. With _rehome set, a stalled
+ * worker is parked (WorkQueuePool::ParkQue), so the least loaded routing keeps new
+ * pushes away from it, and its pending items go to the healthy ones on every tick
+ * (WorkQueuePool::Rehome). Recovery or Release() unparks it.
+ *
+ * The callback runs on the watchdog thread.
+ *
+ * Usage example:
+ * @code
+ * WQWatchdogConfig cfg;
+ * cfg._popBudgetNs = MS_TO_NS(500);
+ * cfg._rehome      = true;
+ * WQWatchdog<MyPool> watchdog(pool, cfg, [](const WQWatchdogEvent &ev) { Alert(ev); });
+ * watchdog.Init(MS_TO_NS(100));
+ * @endcode
+ *
+ * @tparam TPool WorkQueuePool (QueCount, QueSize, QuePopRunningNs, ParkQue and Rehome)
+ */
+template <typename TPool>
+class WQWatchdog : public TickThread<WQWatchdog<TPool>>
+{
+    public:
+        using Callback = std::function<void(const WQWatchdogEvent &event)>;
+
+        WQWatchdog(TPool &pool, const WQWatchdogConfig &cfg = WQWatchdogConfig(), Callback callback = nullptr)
+            : _pool(pool)
+            , _cfg(cfg)
+            , _callback(std::move(callback))
+        {
+        }
+        ~WQWatchdog()                                       { Release(); }
+
+        int         Init(uint64_t intervalNs = MS_TO_NS(100))
+        {
+            _workers.assign(_pool.QueCount(), Worker());
+            _stalled = std::make_unique<std::atomic_bool[]>(_pool.QueCount());
+            _lastNs  = WQNowNs();
+            this->SetInterval(intervalNs);
+            this->Start();
+            return 0;
+        }
+        void        Release();
+
+        bool        Stalled(size_t idx) const               { return _stalled && _stalled[idx].load(std::memory_order_relaxed); }
+        uint64_t    Events() const                          { return _events.load(std::memory_order_relaxed);  }
+        uint64_t    Rehomed() const                         { return _rehomed.load(std::memory_order_relaxed); }
+
+        //From TickThread
+        bool        OnBegin()                               { return true; }
+        void        OnEnd()                                 {}
+        void        Tick();
+
+    private:
+        struct Worker
+        {
+            uint32_t    _overTicks = 0;     // consecutive ticks with Pop() over budget
+            size_t      _lastSize  = 0;
+            bool        _stalled   = false;
+            bool        _backlog   = false;
+            bool        _growth    = false;
+        };
+
+        void        Fire(WQ_WATCHDOG_EVENT event, size_t idx, uint64_t popNs, size_t backlog, double growth, size_t rehomed)
+        {
+            _events.fetch_add(1, std::memory_order_relaxed);
+            if (_callback)
+                _callback(WQWatchdogEvent{event, idx, popNs, backlog, growth, rehomed});
+        }
+
+        TPool                          &_pool;
+        const WQWatchdogConfig          _cfg;
+        Callback                        _callback;
+
+        std::vector<Worker>             _workers;       // watchdog thread only
+        std::unique_ptr<std::atomic_bool[]> _stalled;
+        uint64_t                        _lastNs = 0;
+        std::atomic<uint64_t>           _events  {0};
+        std::atomic<uint64_t>           _rehomed {0};
+};
+
+
+template <typename TPool>
+void WQWatchdog<TPool>::Release()
+{
+    this->Stop();
+
+    //Nobody would unpark a worker that recovers from now on
+    for (size_t idx = 0; idx < _workers.size(); ++idx)
+    {
+        if (_workers[idx]._stalled && _cfg._rehome)
+            _pool.ParkQue(idx, false);
+        _workers[idx]._stalled = false;
+        _stalled[idx].store(false, std::memory_order_relaxed);
+    }
+}
+
+
+template <typename TPool>
+void WQWatchdog<TPool>::Tick()
+{
+    uint64_t now = WQNowNs();
+    double   sec = NS_TO_SEC(double(now - _lastNs));
+    _lastNs = now;
+
+    size_t count = _workers.size();
+    std::vector<uint64_t> popNs(count);
+    std::vector<size_t>   healthy;
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        Worker &w = _workers[idx];
+        popNs[idx] = _pool.QuePopRunningNs(idx);
+        w._overTicks = (0 != _cfg._popBudgetNs && popNs[idx] > _cfg._popBudgetNs) ? w._overTicks + 1 : 0;
+        if (w._overTicks < 2)
+            healthy.push_back(idx);
+    }
+
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        Worker &w       = _workers[idx];
+        bool   stalled  = w._overTicks >= 2;
+        size_t rehomed  = 0;
+        if (stalled && _cfg._rehome && false == healthy.empty() && _pool.QueSize(idx) > 0)
+        {
+            rehomed = _pool.Rehome(idx, healthy);
+            _rehomed.fetch_add(rehomed, std::memory_order_relaxed);
+        }
+
+        size_t size   = _pool.QueSize(idx);
+        double growth = sec > 0 ? (double(size) - double(w._lastSize)) / sec : 0.0;
+        w._lastSize = size;
+
+        if (stalled != w._stalled)
+        {
+            w._stalled = stalled;
+            _stalled[idx].store(stalled, std::memory_order_relaxed);
+            if (_cfg._rehome)
+                _pool.ParkQue(idx, stalled);
+            Fire(stalled ? WQ_WATCHDOG_EVENT::STALL : WQ_WATCHDOG_EVENT::RECOVERED, idx, popNs[idx], size, growth, rehomed);
+        }
+
+        bool backlog = 0 != _cfg._backlogBudget && size > _cfg._backlogBudget;
+        if (backlog && false == w._backlog)
+            Fire(WQ_WATCHDOG_EVENT::BACKLOG, idx, popNs[idx], size, growth, rehomed);
+        w._backlog = backlog;
+
+        bool fast = _cfg._growthBudget > 0 && growth > _cfg._growthBudget;
+        if (fast && false == w._growth)
+            Fire(WQ_WATCHDOG_EVENT::GROWTH, idx, popNs[idx], size, growth, rehomed);
+        w._growth = fast;
+    }
+}
+
+
+
+
+#endif // __WORK_QUEUE_WATCHDOG_H__
+
+// clang-format on
@@ -0,0 +1,355 @@
+
+// clang-format off
+
+
+#include <MetricsReporter.h>
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+
+
+//Prometheus label values escape only backslash, quote and newline; JSON goes through WQEscapeJson
+static std::string EscapeLabel(const std::string &text)
+{
+    std::string res;
+    res.reserve(text.size());
+    for (char ch : text)
+    {
+        switch (ch)
+        {
+            case '\\' : res += "\\\\";  break;
+            case '"'  : res += "\\\"";  break;
+            case '\n' : res += "\\n";   break;
+            default   : res += ch;      break;
+        }
+    }
+    return res;
+}
+
+
+
+
+MetricsReporter::MetricsReporter()
+{
+    SetInterval(SEC_TO_NS(1));
+}
+
+
+MetricsReporter::~MetricsReporter()
+{
+    if (_sockFd != -1)
+    {
+        close(_sockFd);
+        unlink(_sockPath.c_str());
+    }
+}
+
+
+void MetricsReporter::AddSource(const void *owner, const std::string *name, const WorkQueueStats *stats, std::function<size_t()> size)
+{
+    Source src;
+    src._owner          = owner;
+    src._name           = name;
+    src._stats          = stats;
+    src._size           = std::move(size);
+    src._lastWait       = stats->_waitNs.Snapshot();
+    src._lastService    = stats->_serviceNs.Snapshot();
+    src._lastRetry      = stats->_retryNs.Snapshot();
+    src._lastPopped     = stats->_popped.load(std::memory_order_relaxed);
+    src._lastTs         = WQNowNs();
+
+    std::lock_guard<std::mutex> lck{_lock};
+    _sources.push_back(std::move(src));
+}
+
+
+void MetricsReporter::Unregister(const void *owner)
+{
+    std::lock_guard<std::mutex> lck{_lock};
+    for (auto it = _sources.begin(); it != _sources.end(); )
+        it = (it->_owner == owner) ? _sources.erase(it) : it + 1;
+}
+
+
+void MetricsReporter::SetFormat(WQ_METRICS_FORMAT fmt)
+{
+    std::lock_guard<std::mutex> lck{_lock};
+    _format = fmt;
+}
+
+
+int MetricsReporter::SetOutputFile(const std::string &path)
+{
+    std::lock_guard<std::mutex> lck{_lock};
+    _filePath = path;
+    return 0;
+}
+
+
+int MetricsReporter::SetOutputSocket(const std::string &path)
+{
+    sockaddr_un addr {};
+    if (path.size() >= sizeof(addr.sun_path))
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return -1;
+
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(path.c_str());
+
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) == -1 || listen(fd, 16) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+
+    //Tick may be publishing on the old socket
+    std::lock_guard<std::mutex> pubLck{_publishLock};
+    std::lock_guard<std::mutex> lck{_lock};
+    if (_sockFd != -1)
+    {
+        close(_sockFd);
+        unlink(_sockPath.c_str());
+    }
+    _sockFd   = fd;
+    _sockPath = path;
+    return 0;
+}
+
+
+std::string MetricsReporter::Snapshot()
+{
+    std::vector<Sample> samples;
+    WQ_METRICS_FORMAT   format;
+    {
+        std::lock_guard<std::mutex> lck{_lock};
+        format = _format;
+        samples.reserve(_sources.size());
+
+        uint64_t ts = WQNowNs();
+        for (auto &src : _sources)
+        {
+            Sample smp;
+            smp._name           = *src._name;
+            smp._depth          = src._size();
+            smp._pushed         = src._stats->_pushed.load(std::memory_order_relaxed);
+            smp._popped         = src._stats->_popped.load(std::memory_order_relaxed);
+            smp._dropped        = src._stats->_dropped.load(std::memory_order_relaxed);
+            smp._throttledNs    = src._stats->_throttledNs.load(std::memory_order_relaxed);
+            smp._expired        = src._stats->_expired.load(std::memory_order_relaxed);
+            smp._cancelled      = src._stats->_cancelled.load(std::memory_order_relaxed);
+            smp._retried        = src._stats->_retried.load(std::memory_order_relaxed);
+            smp._deadLettered   = src._stats->_deadLettered.load(std::memory_order_relaxed);
+            smp._rehomed        = src._stats->_rehomed.load(std::memory_order_relaxed);
+            smp._inlined        = src._stats->_inlined.load(std::memory_order_relaxed);
+            smp._waitTotal      = src._stats->_waitNs.Snapshot();
+            smp._serviceTotal   = src._stats->_serviceNs.Snapshot();
+            smp._retryTotal     = src._stats->_retryNs.Snapshot();
+            smp._wait           = smp._waitTotal    - src._lastWait;
+            smp._service        = smp._serviceTotal - src._lastService;
+            smp._retry          = smp._retryTotal   - src._lastRetry;
+
+            double sec   = NS_TO_SEC(double(ts - src._lastTs));
+            smp._popRate = sec > 0 ? (smp._popped - src._lastPopped) / sec : 0.0;
+
+            src._lastWait       = smp._waitTotal;
+            src._lastService    = smp._serviceTotal;
+            src._lastRetry      = smp._retryTotal;
+            src._lastPopped     = smp._popped;
+            src._lastTs         = ts;
+
+            samples.push_back(std::move(smp));
+        }
+    }
+
+    return (format == WQ_METRICS_FORMAT::JSON) ? RenderJson(samples) : RenderPrometheus(samples);
+}
+
+
+std::string MetricsReporter::RenderPrometheus(const std::vector<Sample> &samples) const
+{
+    std::ostringstream os;
+    os << std::setprecision(9);
+
+    auto family = [&os, &samples](const char *name, const char *type, const char *help, auto value)
+    {
+        os << "# HELP " << name << " " << help << "\n";
+        os << "# TYPE " << name << " " << type << "\n";
+        for (const auto &smp : samples)
+            os << name << "{queue=\"" << EscapeLabel(smp._name) << "\"} " << value(smp) << "\n";
+    };
+
+    auto summary = [&os, &samples](const char *name, const char *help, auto window, auto total)
+    {
+        os << "# HELP " << name << " " << help << "\n";
+        os << "# TYPE " << name << " summary\n";
+        for (const auto &smp : samples)
+        {
+            const WQHistogramSnapshot &win = window(smp);
+            const WQHistogramSnapshot &all = total(smp);
+            std::string label = EscapeLabel(smp._name);
+            for (double q : {0.5, 0.9, 0.99})
+                os << name << "{queue=\"" << label << "\",quantile=\"" << q << "\"} " << NS_TO_SEC(win.Percentile(q * 100.0)) << "\n";
+            os << name << "_sum{queue=\""   << label << "\"} " << NS_TO_SEC(double(all._sum)) << "\n";
+            os << name << "_count{queue=\"" << label << "\"} " << all._count << "\n";
+        }
+    };
+
+    family("workqueue_depth",           "gauge",   "Items waiting in the queue.",                       [](const Sample &s) { return s._depth;   });
+    family("workqueue_pushed_total",    "counter", "Items accepted by PushBack/PushFront/PushFresh.",   [](const Sample &s) { return s._pushed;  });
+    family("workqueue_popped_total",    "counter", "Items processed by Pop.",                           [](const Sample &s) { return s._popped;  });
+    family("workqueue_dropped_total",   "counter", "Items rejected, superseded or discarded on exit.", [](const Sample &s) { return s._dropped; });
+    family("workqueue_pop_rate",        "gauge",   "Items popped per second over the last interval.",  [](const Sample &s) { return s._popRate; });
+    family("workqueue_throttled_seconds_total", "counter", "Time the worker waited for rate limit tokens.",
+           [](const Sample &s) { return NS_TO_SEC(double(s._throttledNs)); });
+    family("workqueue_expired_total",   "counter", "Items discarded before Pop, deadline passed.",     [](const Sample &s) { return s._expired;   });
+    family("workqueue_cancelled_total", "counter", "Items discarded before Pop, token cancelled.",      [](const Sample &s) { return s._cancelled; });
+    family("workqueue_retried_total",   "counter", "Failed Pop calls that rescheduled the item.",       [](const Sample &s) { return s._retried;   });
+    family("workqueue_dead_lettered_total", "counter", "Items that failed every retry.",
+           [](const Sample &s) { return s._deadLettered; });
+    family("workqueue_rehomed_total",   "counter", "Pending items moved to other pool workers.",       [](const Sample &s) { return s._rehomed;   });
+    family("workqueue_inlined_total",   "counter", "Items popped on the pushing thread by PushOrRun.",  [](const Sample &s) { return s._inlined;   });
+
+    summary("workqueue_wait_seconds",    "Time from push to the start of Pop.",
+            [](const Sample &s) -> const WQHistogramSnapshot & { return s._wait;    },
+            [](const Sample &s) -> const WQHistogramSnapshot & { return s._waitTotal; });
+    summary("workqueue_service_seconds", "Duration of Pop.",
+            [](const Sample &s) -> const WQHistogramSnapshot & { return s._service; },
+            [](const Sample &s) -> const WQHistogramSnapshot & { return s._serviceTotal; });
+    summary("workqueue_retry_seconds",   "Time from push to the final outcome of retried items.",
+            [](const Sample &s) -> const WQHistogramSnapshot & { return s._retry;   },
+            [](const Sample &s) -> const WQHistogramSnapshot & { return s._retryTotal; });
+
+    return os.str();
+}
+
+
+std::string MetricsReporter::RenderJson(const std::vector<Sample> &samples) const
+{
+    std::ostringstream os;
+    os << std::setprecision(9);
+
+    auto latency = [&os](const WQHistogramSnapshot &hist)
+    {
+        os << "{\"count\":" << hist._count
+           << ",\"mean\":"  << hist.Mean()
+           << ",\"p50\":"   << hist.Percentile(50.0)
+           << ",\"p90\":"   << hist.Percentile(90.0)
+           << ",\"p99\":"   << hist.Percentile(99.0)
+           << "}";
+    };
+
+    os << "{\"timestamp\":\"" << TimeFrame::TimeStampText(TimeFrame().TimeStamp()) << "\",\"queues\":[";
+    for (size_t idx = 0; idx < samples.size(); ++idx)
+    {
+        const Sample &smp = samples[idx];
+        os << (idx ? "," : "")
+           << "{\"name\":\""    << WQEscapeJson(smp._name) << "\""
+           << ",\"depth\":"     << smp._depth
+           << ",\"pushed\":"    << smp._pushed
+           << ",\"popped\":"    << smp._popped
+           << ",\"dropped\":"   << smp._dropped
+           << ",\"pop_rate\":"  << smp._popRate
+           << ",\"throttled_ns\":" << smp._throttledNs
+           << ",\"expired\":"   << smp._expired
+           << ",\"cancelled\":" << smp._cancelled
+           << ",\"retried\":"   << smp._retried
+           << ",\"dead_lettered\":" << smp._deadLettered
+           << ",\"rehomed\":"   << smp._rehomed
+           << ",\"inlined\":"   << smp._inlined
+           << ",\"wait_ns\":";
+        latency(smp._wait);
+        os << ",\"service_ns\":";
+        latency(smp._service);
+        os << ",\"retry_ns\":";
+        latency(smp._retry);
+        os << "}";
+    }
+    os << "]}\n";
+
+    return os.str();
+}
+
+
+void MetricsReporter::PublishFile(const std::string &path, const std::string &text)
+{
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::trunc);
+        if (false == file.is_open())
+            return;
+        file << text;
+    }
+    rename(tmp.c_str(), path.c_str());
+}
+
+
+void MetricsReporter::PublishSocket(int sockFd, const std::string &text)
+{
+    for (;;)
+    {
+        int fd = accept4(sockFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd == -1)
+            break;
+
+        timeval tv { 0, 100'000 };
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+        size_t off = 0;
+        while (off < text.size())
+        {
+            ssize_t len = send(fd, text.data() + off, text.size() - off, MSG_NOSIGNAL);
+            if (len <= 0)
+                break;
+            off += len;
+        }
+        close(fd);
+    }
+}
+
+
+bool MetricsReporter::OnBegin()
+{
+    return true;
+}
+
+
+void MetricsReporter::Tick()
+{
+    std::string text = Snapshot();
+
+    //Slow readers hold up only the publishing, not Register / Unregister of queues
+    std::lock_guard<std::mutex> pubLck{_publishLock};
+    std::string filePath;
+    int         sockFd;
+    {
+        std::lock_guard<std::mutex> lck{_lock};
+        filePath = _filePath;
+        sockFd   = _sockFd;
+    }
+    if (false == filePath.empty())
+        PublishFile(filePath, text);
+    if (sockFd != -1)
+        PublishSocket(sockFd, text);
+}
+
+
+void MetricsReporter::OnEnd()
+{
+}
+
+
+// clang-format on
@@ -120,28 +120,95 @@ timespec TimespecFromNs(uint64_t ns)
 }
 
 
-timespec TimeFrame::Elaps() const
+timespec ClockMonotonic::ToRealtime(uint64_t ticks)
 {
-    return TimeSpecDif(_stop, _start);
+    //Offset between the two clocks is taken now, so wall clock steps since Start() are honored
+    timespec rt, mono;
+    clock_gettime(CLOCK_REALTIME,  &rt);
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+
+    int64_t ns = TimespecToNs(rt) - (TimespecToNs(mono) - int64_t(ticks));
+    return TimespecFromNs(uint64_t(ns));
+}
+
+
+bool ClockTsc::Available()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (0 == __get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007)
+        return false;
+    if (0 == __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+        return false;
+    return 0 != (edx & (1 << 8));       // Invariant TSC
+#else
+    return false;
+#endif
+}
+
+
+const ClockTsc::Calibration &ClockTsc::Calibrate()
+{
+    static const Calibration s_cal = []()
+    {
+        Calibration cal;
+        cal._tsc = false;
+#if defined(__x86_64__) || defined(__i386__)
+        cal._tsc = Available();
+#endif
+        if (false == cal._tsc)
+            return cal;
+
+#if defined(__x86_64__) || defined(__i386__)
+        //Busy wait ~2ms between two (counter, monotonic) pairs
+        uint64_t mono0 = ClockMonotonic::Now();
+        uint64_t tick0 = __rdtsc();
+        uint64_t mono1 = mono0;
+        while (mono1 - mono0 < MS_TO_NS(2))
+            mono1 = ClockMonotonic::Now();
+        uint64_t tick1 = __rdtsc();
+
+        cal._nsPerTick  = double(mono1 - mono0) / double(tick1 - tick0);
+        cal._tickBase   = tick1;
+        cal._monoBase   = mono1;
+#endif
+        return cal;
+    }();
+
+    return s_cal;
 }
 
 
-int64_t TimeFrame::ElapsNs() const
+uint64_t ClockTsc::FromMonotonic(uint64_t ns)
 {
-    timespec ts = Elaps();
-    return TimespecToNs(ts);
-    //return ts.tv_sec * SC_TO_NS + ts.tv_nsec;
+    const Calibration &cal = Calibrate();
+    if (false == cal._tsc)
+        return ns;
+
+    //Times before calibration (e.g. deadlines already in the past) count back from the base, never below 0
+    double ticks = (int64_t(ns) - int64_t(cal._monoBase)) / cal._nsPerTick;
+    if (ticks < 0)
+    {
+        uint64_t back = uint64_t(-ticks);
+        return back >= cal._tickBase ? 0 : cal._tickBase - back;
+    }
+    return cal._tickBase + uint64_t(ticks);
 }
 
 
-std::string  TimeFrame::ElapsText() const
+timespec ClockTsc::ToRealtime(uint64_t ticks)
 {
-    timespec ts = Elaps();
-    return TimespecText(ts);
+    if (false == Calibrate()._tsc)
+        return ClockMonotonic::ToRealtime(ticks);
+
+    timespec rt;
+    clock_gettime(CLOCK_REALTIME, &rt);
+    int64_t ns = TimespecToNs(rt) - ToNs(int64_t(Now() - ticks));
+    return TimespecFromNs(uint64_t(ns));
 }
 
 
-std::string TimeFrame::TimeStampText(const timespec &ts)
+std::string TimeFrameBase::TimeStampText(const timespec &ts)
 {
     struct tm tm;
     localtime_r(&ts.tv_sec, &tm);
@@ -156,7 +223,7 @@ std::string TimeFrame::TimeStampText(const timespec &ts)
 }
 
 
-timespec TimeFrame::TimeSpecAdd(const timespec &t1, const timespec &t2)
+timespec TimeFrameBase::TimeSpecAdd(const timespec &t1, const timespec &t2)
 {
     timespec ts;
     ts.tv_sec  = t2.tv_sec + t1.tv_sec  ;
@@ -171,7 +238,7 @@ timespec TimeFrame::TimeSpecAdd(const timespec &t1, const timespec &t2)
 }
 
 
-timespec TimeFrame::TimeSpecDif(const timespec &t1, const timespec &t2)
+timespec TimeFrameBase::TimeSpecDif(const timespec &t1, const timespec &t2)
 {
     timespec diff = {   .tv_sec  = t1.tv_sec  - t2.tv_sec,
                         .tv_nsec = t1.tv_nsec - t2.tv_nsec      };
@@ -185,7 +252,7 @@ timespec TimeFrame::TimeSpecDif(const timespec &t1, const timespec &t2)
 }
 
 
-timespec TimeFrame::TimeSpecDiv (const timespec &ts, double val)
+timespec TimeFrameBase::TimeSpecDiv (const timespec &ts, double val)
 {
     uint64_t ns = TimespecToNs(ts);
     ns /= val;
@@ -208,7 +275,7 @@ timespec TimeFrame::TimeSpecDif(const timespec &ts1, const timespec &ts2)
 */
 
 
-int TimeFrame::TimeSpecCmp(const timespec& lhs, const timespec& rhs)
+int TimeFrameBase::TimeSpecCmp(const timespec& lhs, const timespec& rhs)
 {
     if (lhs.tv_sec == rhs.tv_sec)
     {
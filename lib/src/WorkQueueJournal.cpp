@@ -0,0 +1,432 @@
+// clang-format off
+
+
+#include <WorkQueueJournal.h>
+
+#include <algorithm>
+#include <vector>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+
+
+namespace
+{
+
+constexpr uint32_t  JOURNAL_MAGIC   = 0x314a5157;   // "WQJ1"
+constexpr uint32_t  JOURNAL_VERSION = 1;
+constexpr size_t    HEADER_BYTES    = 64;
+
+constexpr uint32_t  RECORD_EMPTY    = 0;
+constexpr uint32_t  RECORD_WRITTEN  = 1;
+constexpr uint32_t  RECORD_ACKED    = 2;
+
+
+struct SegmentHeader
+{
+    uint32_t    _magic;
+    uint32_t    _version;
+    uint32_t    _recordSize;
+    uint32_t    _segmentRecords;
+    uint64_t    _index;
+};
+
+
+struct RecordHeader
+{
+    std::atomic<uint32_t>   _state;
+    uint32_t                _checksum;
+};
+
+
+static_assert(sizeof(SegmentHeader) <= HEADER_BYTES, "segment header too large");
+static_assert(sizeof(RecordHeader) == 8, "record header must stay 8 bytes");
+
+
+//FNV-1a, detects records torn by a machine crash between two msyncs
+uint32_t Checksum(const void *data, size_t size)
+{
+    auto *bytes = static_cast<const uint8_t *>(data);
+    uint32_t hash = 2166136261u;
+    for (size_t idx = 0; idx < size; ++idx)
+        hash = (hash ^ bytes[idx]) * 16777619u;
+    return hash;
+}
+
+
+RecordHeader *Header(uint8_t *record)
+{
+    return reinterpret_cast<RecordHeader *>(record);
+}
+
+
+bool ParseSegmentName(const char *name, uint64_t &idx)
+{
+    char tail[8] = {};
+    unsigned long long value = 0;
+    if (strlen(name) != 20 || 2 != sscanf(name, "%16llx%7s", &value, tail) || 0 != strcmp(tail, ".wqj"))
+        return false;
+    idx = value;
+    return true;
+}
+
+
+//<segment>.wqj.tmp, a segment left by a crash before its header was written
+bool IsSegmentTemp(const char *name)
+{
+    uint64_t idx;
+    size_t   len = strlen(name);
+    return len == 24 && 0 == strcmp(name + 20, ".tmp") && ParseSegmentName(std::string(name, 20).c_str(), idx);
+}
+
+}
+
+
+
+
+struct WQJournal::Segment
+{
+    uint8_t                *_base  = nullptr;
+    uint64_t                _index = 0;
+    std::atomic<uint32_t>   _done  {0};         // acknowledged slots, plus slots that will never be written
+};
+
+
+WQJournal::WQJournal(const std::string &dir, uint32_t recordSize, const WQJournalConfig &cfg /*= WQJournalConfig()*/)
+    : _dir(dir)
+    , _recordSize(recordSize)
+    , _stride((sizeof(RecordHeader) + recordSize + 7) & ~uint32_t(7))
+    , _cfg(cfg)
+    , _segmentBytes(HEADER_BYTES + size_t(_stride) * cfg._segmentRecords)
+{
+}
+
+
+WQJournal::~WQJournal()
+{
+    Close();
+}
+
+
+std::string WQJournal::SegmentPath(uint64_t idx) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.wqj", (unsigned long long)idx);
+    return _dir + name;
+}
+
+
+uint8_t *WQJournal::Record(Segment *seg, uint32_t slot) const
+{
+    return seg->_base + HEADER_BYTES + size_t(_stride) * slot;
+}
+
+
+std::atomic<WQJournal::Segment *> &WQJournal::Slot(uint64_t idx) const
+{
+    return _table[idx % _cfg._maxSegments];
+}
+
+
+WQJournal::Segment *WQJournal::MapSegment(uint64_t idx, bool create)
+{
+    //A new segment is sized and stamped under a temporary name, Open never sees one without its header
+    std::string path = SegmentPath(idx);
+    std::string temp = path + ".tmp";
+    int fd = create ? open(temp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)
+                    : open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st;
+    bool sized = create ? (0 == ftruncate(fd, off_t(_segmentBytes)))
+                        : (0 == fstat(fd, &st) && size_t(st.st_size) == _segmentBytes);
+    void *base = sized ? mmap(nullptr, _segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+
+    if (MAP_FAILED == base)
+    {
+        if (create)
+            unlink(temp.c_str());
+        return nullptr;
+    }
+
+    auto *header = static_cast<SegmentHeader *>(base);
+    if (create)
+    {
+        *header = SegmentHeader{JOURNAL_MAGIC, JOURNAL_VERSION, _recordSize, _cfg._segmentRecords, idx};
+        if (0 != rename(temp.c_str(), path.c_str()))
+        {
+            munmap(base, _segmentBytes);
+            unlink(temp.c_str());
+            return nullptr;
+        }
+    }
+    else if (header->_magic != JOURNAL_MAGIC || header->_version != JOURNAL_VERSION || header->_recordSize != _recordSize ||
+             header->_segmentRecords != _cfg._segmentRecords || header->_index != idx)
+    {
+        munmap(base, _segmentBytes);
+        return nullptr;
+    }
+
+    auto *seg = new Segment;
+    seg->_base  = static_cast<uint8_t *>(base);
+    seg->_index = idx;
+    return seg;
+}
+
+
+bool WQJournal::IsBlankSegment(uint64_t idx) const
+{
+    //Sync() makes the header durable with the first records of a segment, so after a machine crash
+    //a segment may lack its header only when none of its records was synced either
+    int fd = open(SegmentPath(idx).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    bool  blank = 0 == fstat(fd, &st) && (0 == st.st_size || size_t(st.st_size) == _segmentBytes);
+    void *base  = (blank && 0 != st.st_size) ? mmap(nullptr, _segmentBytes, PROT_READ, MAP_SHARED, fd, 0) : nullptr;
+    close(fd);
+    if (MAP_FAILED == base)
+        return false;
+    if (nullptr == base)
+        return blank;
+
+    auto *bytes = static_cast<const uint8_t *>(base);
+    blank = std::all_of(bytes, bytes + sizeof(SegmentHeader), [](uint8_t byte) { return 0 == byte; });
+    for (uint32_t slot = 0; blank && slot < _cfg._segmentRecords; ++slot)
+    {
+        auto *record = reinterpret_cast<const RecordHeader *>(bytes + HEADER_BYTES + size_t(_stride) * slot);
+        blank = RECORD_WRITTEN != record->_state.load(std::memory_order_relaxed);
+    }
+    munmap(base, _segmentBytes);
+    return blank;
+}
+
+
+void WQJournal::UnmapSegment(Segment *seg, bool unlinkFile)
+{
+    munmap(seg->_base, _segmentBytes);
+    if (unlinkFile)
+        unlink(SegmentPath(seg->_index).c_str());
+    delete seg;
+}
+
+
+int WQJournal::Open(const TPendingFn &onPending)
+{
+    if (_open || 0 == _recordSize || 0 == _cfg._segmentRecords || 0 == _cfg._maxSegments)
+        return -1;
+
+    if (0 != mkdir(_dir.c_str(), 0755) && EEXIST != errno)
+        return -1;
+
+    DIR *dir = opendir(_dir.c_str());
+    if (nullptr == dir)
+        return -1;
+
+    std::vector<uint64_t>    indexes;
+    std::vector<std::string> temps;
+    while (dirent *entry = readdir(dir))
+    {
+        uint64_t idx;
+        if (ParseSegmentName(entry->d_name, idx))
+            indexes.push_back(idx);
+        else if (IsSegmentTemp(entry->d_name))
+            temps.push_back(_dir + "/" + entry->d_name);
+    }
+    closedir(dir);
+    std::sort(indexes.begin(), indexes.end());
+
+    //Segments that never got their header hold nothing to recover
+    for (const std::string &temp : temps)
+        unlink(temp.c_str());
+    indexes.erase(std::remove_if(indexes.begin(), indexes.end(), [this](uint64_t idx)
+                  {
+                      return IsBlankSegment(idx) && 0 == unlink(SegmentPath(idx).c_str());
+                  }), indexes.end());
+
+    _table = std::make_unique<std::atomic<Segment *>[]>(_cfg._maxSegments);
+
+    //Map everything first, a segment that does not match the configuration fails the whole recovery
+    std::vector<Segment *> segments;
+    for (uint64_t idx : indexes)
+    {
+        Segment *seg = MapSegment(idx, false);
+        if (nullptr == seg || nullptr != Slot(idx).load())
+        {
+            if (nullptr != seg)
+                UnmapSegment(seg, false);
+            for (Segment *mapped : segments)
+                UnmapSegment(mapped, false);
+            _table.reset();
+            return -1;
+        }
+        Slot(idx).store(seg);
+        segments.push_back(seg);
+    }
+
+    for (Segment *seg : segments)
+    {
+        uint32_t done = 0;
+        for (uint32_t slot = 0; slot < _cfg._segmentRecords; ++slot)
+        {
+            uint8_t *record = Record(seg, slot);
+            bool pending = RECORD_WRITTEN == Header(record)->_state.load(std::memory_order_acquire) &&
+                           Header(record)->_checksum == Checksum(record + sizeof(RecordHeader), _recordSize);
+            if (false == pending)
+            {
+                ++done;
+                continue;
+            }
+            onPending(seg->_index * _cfg._segmentRecords + slot + 1, record + sizeof(RecordHeader));
+        }
+
+        seg->_done.store(done);
+        if (done == _cfg._segmentRecords)
+        {
+            Slot(seg->_index).store(nullptr);
+            UnmapSegment(seg, true);
+        }
+    }
+
+    _nextRecord = indexes.empty() ? 0 : (indexes.back() + 1) * _cfg._segmentRecords;
+    _appended.store(_nextRecord);
+    _synced.store(_nextRecord);
+    _current = nullptr;
+    _open    = true;
+    return 0;
+}
+
+
+void WQJournal::Close()
+{
+    if (false == _open)
+        return;
+
+    Sync();
+
+    //A partly filled segment never reaches its last acknowledgement, drop it if nothing in it is pending
+    //(a full one retired itself on its last Ack, _current may already be gone)
+    uint32_t written = uint32_t(_nextRecord % _cfg._segmentRecords);
+    if (nullptr != _current && 0 != written && _current->_done.load() == written)
+    {
+        Slot(_current->_index).store(nullptr);
+        UnmapSegment(_current, true);
+    }
+
+    _open    = false;
+    _current = nullptr;
+    for (uint32_t idx = 0; idx < _cfg._maxSegments; ++idx)
+    {
+        Segment *seg = _table[idx].exchange(nullptr);
+        if (nullptr != seg)
+            UnmapSegment(seg, false);
+    }
+    _table.reset();
+}
+
+
+uint64_t WQJournal::Append(const void *record)
+{
+    if (false == _open)
+        return 0;
+
+    uint64_t segIdx = _nextRecord / _cfg._segmentRecords;
+    uint32_t slot   = uint32_t(_nextRecord % _cfg._segmentRecords);
+
+    if (nullptr == _current || 0 == slot)
+    {
+        std::lock_guard<std::mutex> lck(_segLock);
+        if (nullptr != Slot(segIdx).load())
+            return 0;                                   // every segment slot holds unacknowledged records
+
+        Segment *seg = MapSegment(segIdx, true);
+        if (nullptr == seg)
+            return 0;
+        Slot(segIdx).store(seg);
+        _current = seg;
+    }
+
+    uint8_t *dst = Record(_current, slot);
+    memcpy(dst + sizeof(RecordHeader), record, _recordSize);
+    Header(dst)->_checksum = Checksum(record, _recordSize);
+    Header(dst)->_state.store(RECORD_WRITTEN, std::memory_order_release);
+
+    ++_nextRecord;
+    _appended.store(_nextRecord, std::memory_order_release);
+    return _nextRecord;
+}
+
+
+void WQJournal::Ack(uint64_t seq)
+{
+    uint64_t rec  = seq - 1;
+    Segment *seg  = Slot(rec / _cfg._segmentRecords).load(std::memory_order_acquire);
+    if (nullptr == seg)
+        return;
+
+    Header(Record(seg, uint32_t(rec % _cfg._segmentRecords)))->_state.store(RECORD_ACKED, std::memory_order_relaxed);
+
+    //The last acknowledgement of a segment retires it, appends are past it by then
+    if (seg->_done.fetch_add(1, std::memory_order_acq_rel) + 1 == _cfg._segmentRecords)
+    {
+        std::lock_guard<std::mutex> lck(_segLock);
+        Slot(seg->_index).store(nullptr);
+        UnmapSegment(seg, true);
+    }
+}
+
+
+bool WQJournal::SyncDue() const
+{
+    return 0 != _cfg._syncEvery &&
+           _appended.load(std::memory_order_relaxed) - _synced.load(std::memory_order_relaxed) >= _cfg._syncEvery;
+}
+
+
+int WQJournal::Sync()
+{
+    std::lock_guard<std::mutex> syncLck(_syncLock);
+    uint64_t from = _synced.load(std::memory_order_relaxed);
+    uint64_t upTo = _appended.load(std::memory_order_acquire);
+    if (upTo <= from)
+        return 0;
+
+    static const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+
+    int ret = 0;
+    std::lock_guard<std::mutex> segLck(_segLock);
+    for (uint64_t rec = from; rec < upTo; )
+    {
+        uint64_t segIdx = rec / _cfg._segmentRecords;
+        uint64_t segEnd = std::min(upTo, (segIdx + 1) * _cfg._segmentRecords);
+        Segment *seg    = Slot(segIdx).load();
+
+        //A retired segment was fully acknowledged, nothing left to make durable
+        if (nullptr != seg)
+        {
+            uint32_t first = uint32_t(rec % _cfg._segmentRecords);
+            size_t   begin = (0 == first) ? 0 : HEADER_BYTES + size_t(_stride) * first;
+            size_t   end   = HEADER_BYTES + size_t(_stride) * (segEnd - segIdx * _cfg._segmentRecords);
+            begin -= begin % pageSize;
+            if (0 != msync(seg->_base + begin, end - begin, MS_SYNC))
+                ret = -1;
+        }
+        rec = segEnd;
+    }
+
+    _synced.store(upTo, std::memory_order_relaxed);
+    return ret;
+}
+
+
+// clang-format on
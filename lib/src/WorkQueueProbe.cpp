@@ -0,0 +1,29 @@
+// clang-format off
+
+
+#include <WorkQueueProbe.h>
+
+
+
+
+#if defined(WORKQUEUE_USDT)
+
+//Probe semaphores, the tracer raises one while it is attached to its probe (see WQ_PROBE_ENABLED)
+#define WQ_PROBE_SEMAPHORE(name)    __extension__ unsigned short workqueue_##name##_semaphore __attribute__((unused)) __attribute__((section(".probes")))
+
+extern "C"
+{
+WQ_PROBE_SEMAPHORE(push);
+WQ_PROBE_SEMAPHORE(drop);
+WQ_PROBE_SEMAPHORE(drain_start);
+WQ_PROBE_SEMAPHORE(pop_start);
+WQ_PROBE_SEMAPHORE(pop_end);
+WQ_PROBE_SEMAPHORE(state);
+WQ_PROBE_SEMAPHORE(tick);
+WQ_PROBE_SEMAPHORE(tick_overrun);
+}
+
+#endif
+
+
+// clang-format on
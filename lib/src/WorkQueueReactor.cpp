@@ -0,0 +1,147 @@
+// clang-format off
+
+
+#include <WorkQueueReactor.h>
+
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+
+
+
+namespace
+{
+
+constexpr int   REACTOR_EVENTS  = 64;   // epoll events taken per wake-up
+
+}
+
+
+
+
+int WQReactor::Init(const std::string &name /*= ""*/)
+{
+    if (_epfd >= 0)
+        return -1;
+
+    _name   = name;
+    _epfd   = epoll_create1(EPOLL_CLOEXEC);
+    _stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_epfd < 0 || _stopFd < 0)
+    {
+        Release();
+        return -1;
+    }
+
+    epoll_event ev {};
+    ev.events  = EPOLLIN;
+    ev.data.fd = _stopFd;
+    if (0 != epoll_ctl(_epfd, EPOLL_CTL_ADD, _stopFd, &ev))
+    {
+        Release();
+        return -1;
+    }
+
+    _quit = false;
+    Start();
+    return 0;
+}
+
+
+void WQReactor::Release()
+{
+    if (_stopFd >= 0)
+    {
+        _quit = true;
+        uint64_t one = 1;
+        (void)!write(_stopFd, &one, sizeof(one));
+    }
+    Join();
+
+    if (_epfd >= 0)
+        close(_epfd);
+    if (_stopFd >= 0)
+        close(_stopFd);
+    _epfd   = -1;
+    _stopFd = -1;
+
+    std::lock_guard<std::mutex> lck{_lock};
+    _entries.clear();
+}
+
+
+int WQReactor::Add(int fd, uint32_t events, Handler handler)
+{
+    if (_epfd < 0 || fd < 0)
+        return -1;
+
+    std::lock_guard<std::mutex> lck{_lock};
+    if (_entries.count(fd))
+        return -1;
+
+    epoll_event ev {};
+    ev.events  = events;
+    ev.data.fd = fd;
+    if (0 != epoll_ctl(_epfd, EPOLL_CTL_ADD, fd, &ev))
+        return -1;
+
+    auto entry = std::make_shared<Entry>();
+    entry->_handler = std::move(handler);
+    _entries.emplace(fd, std::move(entry));
+    return 0;
+}
+
+
+int WQReactor::Remove(int fd)
+{
+    std::lock_guard<std::mutex> lck{_lock};
+    if (0 == _entries.erase(fd))
+        return -1;
+
+    if (_epfd >= 0)
+        epoll_ctl(_epfd, EPOLL_CTL_DEL, fd, nullptr);
+    return 0;
+}
+
+
+void WQReactor::Run()
+{
+    epoll_event events[REACTOR_EVENTS];
+    std::vector<std::pair<std::shared_ptr<Entry>, uint32_t>> ready;
+    ready.reserve(REACTOR_EVENTS);
+
+    while (false == _quit.load())
+    {
+        int count = epoll_wait(_epfd, events, REACTOR_EVENTS, -1);
+        if (count < 0 && EINTR != errno)
+            break;
+        _wakeups.fetch_add(1, std::memory_order_relaxed);
+
+        //Handlers run unlocked, they may Add or Remove descriptors
+        ready.clear();
+        {
+            std::lock_guard<std::mutex> lck{_lock};
+            for (int idx = 0; idx < count; ++idx)
+            {
+                int fd = events[idx].data.fd;
+                if (fd == _stopFd)
+                {
+                    uint64_t value;
+                    (void)!read(_stopFd, &value, sizeof(value));
+                    continue;
+                }
+                auto it = _entries.find(fd);
+                if (_entries.end() != it)
+                    ready.emplace_back(it->second, uint32_t(events[idx].events));
+            }
+        }
+
+        for (auto &call : ready)
+            if (false == _quit.load())
+                call.first->_handler(call.second);
+    }
+}
+
+
+// clang-format on
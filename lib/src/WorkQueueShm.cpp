@@ -0,0 +1,77 @@
+// clang-format off
+
+
+#include <WorkQueueShm.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+
+
+
+void *WQShmMap(const std::string &name, size_t bytes, bool create, bool &created)
+{
+    created = false;
+
+    int fd = create ? shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600) : -1;
+    if (fd >= 0)
+    {
+        created = true;
+        if (0 != ftruncate(fd, off_t(bytes)))
+        {
+            close(fd);
+            shm_unlink(name.c_str());
+            return nullptr;
+        }
+    }
+    else
+    {
+        if (create && EEXIST != errno)
+            return nullptr;
+
+        fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0600);
+        if (fd < 0)
+            return nullptr;
+
+        //The creator may not have sized the object yet
+        struct stat st;
+        for (int retry = 0; 0 == fstat(fd, &st) && 0 == st.st_size && retry < 1000; ++retry)
+            usleep(100);
+        if (0 != fstat(fd, &st) || size_t(st.st_size) != bytes)
+        {
+            close(fd);
+            return nullptr;
+        }
+    }
+
+    void *base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return (MAP_FAILED == base) ? nullptr : base;
+}
+
+
+void WQShmUnmap(void *base, size_t bytes)
+{
+    if (nullptr != base)
+        munmap(base, bytes);
+}
+
+
+int WQShmUnlink(const std::string &name)
+{
+    return shm_unlink(name.c_str());
+}
+
+
+bool WQProcessAlive(int32_t pid)
+{
+    return pid > 0 && (0 == kill(pid_t(pid), 0) || EPERM == errno);
+}
+
+
+// clang-format on
@@ -0,0 +1,93 @@
+
+// clang-format off
+
+
+#include <WorkQueueStats.h>
+
+#include <cmath>
+#include <stdio.h>
+
+
+
+WQHistogramSnapshot WQHistogram::Snapshot() const
+{
+    WQHistogramSnapshot snap;
+    for (size_t idx = 0; idx < WQHistogramSnapshot::BUCKET_COUNT; ++idx)
+        snap._buckets[idx] = _buckets[idx].load(std::memory_order_relaxed);
+    snap._count = _count.load(std::memory_order_relaxed);
+    snap._sum   = _sum.load(std::memory_order_relaxed);
+    return snap;
+}
+
+
+WQHistogramSnapshot WQHistogramSnapshot::operator - (const WQHistogramSnapshot &rhs) const
+{
+    WQHistogramSnapshot res;
+    for (size_t idx = 0; idx < BUCKET_COUNT; ++idx)
+        res._buckets[idx] = _buckets[idx] - rhs._buckets[idx];
+    res._count = _count - rhs._count;
+    res._sum   = _sum   - rhs._sum;
+    return res;
+}
+
+
+double WQHistogramSnapshot::Percentile(double pct) const
+{
+    uint64_t total = 0;
+    for (uint64_t val : _buckets)
+        total += val;
+    if (0 == total)
+        return 0.0;
+
+    double   rank = (pct / 100.0) * total;
+    uint64_t seen = 0;
+    for (size_t idx = 0; idx < BUCKET_COUNT; ++idx)
+    {
+        if (0 == _buckets[idx])
+            continue;
+
+        if (seen + _buckets[idx] >= rank)
+        {
+            //Linear interpolation inside [2^(idx-1), 2^idx)
+            double lo   = idx ? std::ldexp(1.0, int(idx) - 1) : 0.0;
+            double hi   = std::ldexp(1.0, int(idx));
+            double frac = (rank - seen) / _buckets[idx];
+            return lo + (hi - lo) * frac;
+        }
+        seen += _buckets[idx];
+    }
+    return std::ldexp(1.0, BUCKET_COUNT - 1);
+}
+
+
+std::string WQEscapeJson(const std::string &text)
+{
+    std::string res;
+    res.reserve(text.size());
+    for (char ch : text)
+    {
+        switch (ch)
+        {
+            case '"'  : res += "\\\"";  break;
+            case '\\' : res += "\\\\";  break;
+            case '\n' : res += "\\n";   break;
+            case '\r' : res += "\\r";   break;
+            case '\t' : res += "\\t";   break;
+            default :
+                if (static_cast<unsigned char>(ch) < 0x20)
+                {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", unsigned(static_cast<unsigned char>(ch)));
+                    res += buf;
+                }
+                else
+                {
+                    res += ch;
+                }
+        }
+    }
+    return res;
+}
+
+
+// clang-format on
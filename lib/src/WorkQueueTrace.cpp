@@ -0,0 +1,311 @@
+
+// clang-format off
+
+
+#include <WorkQueueTrace.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+
+
+
+std::atomic_bool        WQTrace::s_enabled      {false};
+std::atomic<uint32_t>   WQTrace::s_sampleEvery  {1};
+
+
+
+
+namespace
+{
+
+/**
+ * @brief One event, written under a per-slot sequence number (seqlock) so that the
+ *        dumping thread can detect and skip slots being overwritten.
+ */
+struct TraceSlot
+{
+    std::atomic<uint64_t>   _seq  {0};
+    std::atomic<uint64_t>   _ts   {0};
+    std::atomic<uint64_t>   _dur  {0};
+    std::atomic<uint64_t>   _item {0};
+    std::atomic<uint64_t>   _meta {0};      // queueId << 32 | type << 24 | arg (24 bits)
+    std::atomic<uint64_t>   _tid  {0};      // writer, a ring outlives its thread
+};
+
+
+struct TraceRing
+{
+    explicit TraceRing(size_t size)
+        : _slots(size)
+        , _mask(size - 1)
+    {
+    }
+
+    std::vector<TraceSlot>  _slots;
+    uint64_t                _mask;
+    std::atomic<uint64_t>   _head    {0};
+    std::atomic<uint64_t>   _cleared {0};
+};
+
+
+struct TraceRegistry
+{
+    std::mutex                              _lock;
+    std::vector<std::shared_ptr<TraceRing>> _rings;
+    std::vector<TraceRing *>                _free;          // rings of exited threads, events kept until reused
+    std::vector<std::string>                _names {""};    // queueId 0 is unused
+    size_t                                  _ringSize = 1 << 16;
+};
+
+
+TraceRegistry &Registry()
+{
+    static TraceRegistry s_registry;
+    return s_registry;
+}
+
+
+/**
+ * @brief The calling thread's ring; handed back to the registry when the thread exits,
+ *        so thread churn reuses rings instead of growing the registry.
+ */
+struct LocalRingOwner
+{
+    ~LocalRingOwner()
+    {
+        if (nullptr == _ring)
+            return;
+
+        TraceRegistry &reg = Registry();
+        std::lock_guard<std::mutex> lck{reg._lock};
+        reg._free.push_back(_ring);
+    }
+
+    TraceRing  *_ring = nullptr;
+    uint64_t    _tid  = 0;
+};
+
+
+thread_local LocalRingOwner t_ring;
+
+
+TraceRing *LocalRing()
+{
+    if (nullptr == t_ring._ring)
+    {
+        TraceRegistry &reg = Registry();
+        std::lock_guard<std::mutex> lck{reg._lock};
+
+        //Reuse a ring of an exited thread; one of an older Enable() ring size is released instead
+        while (false == reg._free.empty() && nullptr == t_ring._ring)
+        {
+            TraceRing *ring = reg._free.back();
+            reg._free.pop_back();
+            if (ring->_slots.size() == reg._ringSize)
+                t_ring._ring = ring;
+            else
+                reg._rings.erase(std::find_if(reg._rings.begin(), reg._rings.end(), [ring](const std::shared_ptr<TraceRing> &own) { return own.get() == ring; }));
+        }
+        if (nullptr == t_ring._ring)
+        {
+            reg._rings.push_back(std::make_shared<TraceRing>(reg._ringSize));
+            t_ring._ring = reg._rings.back().get();
+        }
+        t_ring._tid = uint64_t(gettid());
+    }
+    return t_ring._ring;
+}
+
+
+struct TraceEvent
+{
+    pid_t           _tid;
+    uint64_t        _ts;
+    uint64_t        _dur;
+    uint64_t        _item;
+    uint32_t        _queueId;
+    WQ_TRACE_EVENT  _type;
+    uint32_t        _arg;
+};
+
+} // namespace
+
+
+
+
+void WQTrace::Enable(uint32_t sampleEvery /*= 1*/, size_t ringSize /*= 1 << 16*/)
+{
+    size_t size = 1;
+    while (size < ringSize)
+        size <<= 1;
+
+    {
+        TraceRegistry &reg = Registry();
+        std::lock_guard<std::mutex> lck{reg._lock};
+        reg._ringSize = size;
+    }
+
+    WQClock::Calibrate();
+    s_sampleEvery.store(std::max(sampleEvery, 1U), std::memory_order_relaxed);
+    s_enabled.store(true, std::memory_order_relaxed);
+}
+
+
+void WQTrace::Disable()
+{
+    s_enabled.store(false, std::memory_order_relaxed);
+}
+
+
+void WQTrace::Clear()
+{
+    TraceRegistry &reg = Registry();
+    std::lock_guard<std::mutex> lck{reg._lock};
+    for (auto &ring : reg._rings)
+        ring->_cleared.store(ring->_head.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+
+size_t WQTrace::RingCount()
+{
+    TraceRegistry &reg = Registry();
+    std::lock_guard<std::mutex> lck{reg._lock};
+    return reg._rings.size();
+}
+
+
+uint32_t WQTrace::RegisterQueue(const std::string &name)
+{
+    TraceRegistry &reg = Registry();
+    std::lock_guard<std::mutex> lck{reg._lock};
+    reg._names.push_back(name);
+    return uint32_t(reg._names.size() - 1);
+}
+
+
+void WQTrace::Record(WQ_TRACE_EVENT type, uint32_t queueId, uint64_t itemId, uint64_t ts, uint64_t tsEnd, uint32_t arg /*= 0*/)
+{
+    TraceRing *ring = LocalRing();
+    uint64_t   idx  = ring->_head.load(std::memory_order_relaxed);
+    TraceSlot &slot = ring->_slots[idx & ring->_mask];
+
+    slot._seq.store(2 * idx + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot._ts.store  (ts,            std::memory_order_relaxed);
+    slot._dur.store (tsEnd - ts,    std::memory_order_relaxed);
+    slot._item.store(itemId,        std::memory_order_relaxed);
+    slot._meta.store((uint64_t(queueId) << 32) | (uint64_t(type) << 24) | (arg & 0xFFFFFF), std::memory_order_relaxed);
+    slot._tid.store (t_ring._tid,   std::memory_order_relaxed);
+
+    slot._seq.store(2 * idx + 2, std::memory_order_release);
+    ring->_head.store(idx + 1, std::memory_order_release);
+}
+
+
+std::string WQTrace::DumpChrome()
+{
+    std::vector<TraceEvent>  events;
+    std::vector<std::string> names;
+    {
+        TraceRegistry &reg = Registry();
+        std::lock_guard<std::mutex> lck{reg._lock};
+        names = reg._names;
+
+        for (auto &ring : reg._rings)
+        {
+            uint64_t head = ring->_head.load(std::memory_order_acquire);
+            uint64_t low  = head > ring->_slots.size() ? head - ring->_slots.size() : 0;
+            low = std::max(low, ring->_cleared.load(std::memory_order_relaxed));
+
+            for (uint64_t idx = low; idx < head; ++idx)
+            {
+                TraceSlot &slot = ring->_slots[idx & ring->_mask];
+
+                uint64_t seq1 = slot._seq.load(std::memory_order_acquire);
+                TraceEvent ev;
+                ev._tid     = pid_t(slot._tid.load(std::memory_order_relaxed));
+                ev._ts      = slot._ts.load  (std::memory_order_relaxed);
+                ev._dur     = slot._dur.load (std::memory_order_relaxed);
+                ev._item    = slot._item.load(std::memory_order_relaxed);
+                uint64_t meta = slot._meta.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                uint64_t seq2 = slot._seq.load(std::memory_order_relaxed);
+
+                if (seq1 != seq2 || seq1 != 2 * idx + 2)
+                    continue;   // overwritten while reading
+
+                ev._queueId = uint32_t(meta >> 32);
+                ev._type    = WQ_TRACE_EVENT((meta >> 24) & 0xFF);
+                ev._arg     = uint32_t(meta & 0xFFFFFF);
+                events.push_back(ev);
+            }
+        }
+    }
+
+    std::sort(events.begin(), events.end(), [](const TraceEvent &a, const TraceEvent &b) { return a._ts < b._ts; });
+    uint64_t base = events.empty() ? 0 : events.front()._ts;
+
+    auto usec = [base](uint64_t ts)    { return WQClock::ToNs(int64_t(ts - base)) / 1000.0; };
+    auto udur = [](uint64_t ticks)     { return WQClock::ToNs(int64_t(ticks)) / 1000.0;     };
+
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(3);
+    os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    os << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << getpid() << ",\"args\":{\"name\":\"WorkQueue\"}}";
+
+    for (const TraceEvent &ev : events)
+    {
+        const std::string name  = WQEscapeJson(ev._queueId < names.size() ? names[ev._queueId] : "");
+        const char       *label = "";
+        switch (ev._type)
+        {
+            case WQ_TRACE_EVENT::PUSH  : label = "push";  break;
+            case WQ_TRACE_EVENT::DRAIN : label = "drain"; break;
+            case WQ_TRACE_EVENT::POP   : label = "pop";   break;
+        }
+
+        os << ",{\"name\":\"" << label << "\",\"cat\":\"wq\",\"ph\":\"X\""
+           << ",\"ts\":"  << usec(ev._ts) << ",\"dur\":" << udur(ev._dur)
+           << ",\"pid\":" << getpid() << ",\"tid\":" << ev._tid
+           << ",\"args\":{\"queue\":\"" << name << "\"";
+        if (ev._type == WQ_TRACE_EVENT::DRAIN)
+            os << ",\"count\":" << ev._arg;
+        else
+            os << ",\"item\":" << ev._item;
+        os << "}}";
+
+        //Flow arrow from the push of an item to its Pop
+        if (ev._type == WQ_TRACE_EVENT::PUSH || ev._type == WQ_TRACE_EVENT::POP)
+        {
+            os << ",{\"name\":\"item\",\"cat\":\"wq\",\"ph\":\"" << (ev._type == WQ_TRACE_EVENT::PUSH ? "s" : "f") << "\""
+               << (ev._type == WQ_TRACE_EVENT::POP ? ",\"bp\":\"e\"" : "")
+               << ",\"id\":"  << ev._item
+               << ",\"ts\":"  << usec(ev._ts)
+               << ",\"pid\":" << getpid() << ",\"tid\":" << ev._tid << "}";
+        }
+    }
+    os << "]}\n";
+
+    return os.str();
+}
+
+
+int WQTrace::DumpChrome(const std::string &path)
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (false == file.is_open())
+        return -1;
+
+    file << DumpChrome();
+    return file.good() ? 0 : -1;
+}
+
+
+// clang-format on
@@ -0,0 +1,28 @@
+// clang-format off
+
+
+#ifndef __TEST_UTIL_H__
+#define __TEST_UTIL_H__
+
+#include <WorkQueueStats.h>
+
+#include <stdint.h>
+#include <unistd.h>
+
+
+
+
+//Polls pred every millisecond until it holds or timeoutNs passed, returns its last value
+template <typename TPred>
+inline bool WaitFor(TPred pred, uint64_t timeoutNs = SEC_TO_NS(5))
+{
+    uint64_t deadline = WQNowNs() + timeoutNs;
+    while (false == pred() && WQNowNs() < deadline)
+        usleep(1000);
+    return pred();
+}
+
+
+#endif // __TEST_UTIL_H__
+
+// clang-format on
@@ -0,0 +1,196 @@
+// clang-format off
+
+
+#include <WorkQueueBatch.h>
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+
+
+struct BatchItem
+{
+    uint32_t    _producer;
+    uint32_t    _seq;
+};
+
+
+class BatchQueue : public WorkQueue<BatchItem, BatchQueue>
+{
+    public:
+        void Begin()                {}
+        void End()                  {}
+        void Pop(BatchItem *pData)
+        {
+            if (pData->_seq != _next[pData->_producer])
+                ++_outOfOrder;
+            _next[pData->_producer] = pData->_seq + 1;
+            ++_count;
+        }
+
+        uint32_t            _next[8]    {};
+        uint32_t            _outOfOrder = 0;
+        std::atomic<int>    _count      {0};
+};
+
+
+TEST(test_batch, bt_range)
+{
+    BatchQueue que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "BatchRange");
+
+    std::vector<BatchItem> items;
+    for (uint32_t seq = 0; seq < 100; ++seq)
+        items.push_back(BatchItem{0, seq});
+    EXPECT_EQ(que.PushRange(items.begin(), items.end()), 100u);
+    que.Flush();
+
+    que.SetState(WQ_QUEUE_STATE::PAUSE);
+    EXPECT_EQ(que.PushRange(items.begin(), items.end()), 0u);
+    que.Release();
+
+    EXPECT_EQ(que._count, 100);
+    EXPECT_EQ(que._outOfOrder, 0u);
+    EXPECT_EQ(que.Stats()._pushed.load(), 100u);
+    EXPECT_EQ(que.Stats()._dropped.load(), 100u);
+}
+
+
+TEST(test_batch, bt_producers)
+{
+    BatchQueue que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "BatchProducers");
+
+    //Size triggered flushes from several producers, each in its own order
+    std::vector<std::thread> threads;
+    for (uint32_t producer = 0; producer < 4; ++producer)
+        threads.emplace_back([&que, producer]()
+        {
+            WQBatchProducer<BatchQueue> batch(que, 32);
+            for (uint32_t seq = 0; seq < 1000; ++seq)
+                batch.Push(BatchItem{producer, seq});
+            EXPECT_EQ(batch.Flushes(), 31u);
+            EXPECT_EQ(batch.Buffered(), 8u);
+        });
+    for (auto &th : threads)
+        th.join();
+    que.Release();
+
+    EXPECT_EQ(que._count, 4000);
+    EXPECT_EQ(que._outOfOrder, 0u);
+}
+
+
+TEST(test_batch, bt_linger)
+{
+    WQLingerFlusher flusher;
+    flusher.Init(MS_TO_NS(1));
+
+    BatchQueue que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "BatchLinger");
+
+    //Below the size threshold, only the linger deadline moves the items
+    WQBatchProducer<BatchQueue> batch(que, 1000, MS_TO_NS(5), &flusher);
+    batch.Push(BatchItem{0, 0});
+    batch.Push(BatchItem{0, 1});
+    EXPECT_EQ(batch.Buffered(), 2u);
+
+    uint64_t deadline = WQNowNs() + SEC_TO_NS(5);
+    while (que._count < 2 && WQNowNs() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_EQ(que._count, 2);
+    EXPECT_EQ(batch.Buffered(), 0u);
+
+    batch.Push(BatchItem{0, 2});
+    EXPECT_EQ(batch.Flush(), 1u);
+    que.Flush();
+    EXPECT_EQ(que._count, 3);
+
+    flusher.Release();
+    que.Release();
+    EXPECT_EQ(que._outOfOrder, 0u);
+}
+
+
+TEST(test_batch, bt_dropped)
+{
+    class Blocked : public WorkQueue<BatchItem, Blocked, WQBoundedPolicy<4>>
+    {
+        public:
+            void Begin()                {}
+            void End()                  {}
+            void Pop(BatchItem *)
+            {
+                _entered = true;
+                while (false == _go.load())
+                    usleep(100);
+                ++_count;
+            }
+
+            std::atomic_bool    _entered {false};
+            std::atomic_bool    _go      {false};
+            std::atomic<int>    _count   {0};
+    };
+
+    Blocked que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "BatchDropped");
+    que.PushBack(BatchItem{0, 0});
+    while (false == que._entered.load())
+        usleep(100);
+
+    //The ring takes four of the six, the other two are dropped and not reported as flushed
+    WQBatchProducer<Blocked> batch(que, 1000);
+    for (uint32_t seq = 1; seq <= 6; ++seq)
+        batch.Push(BatchItem{0, seq});
+    EXPECT_EQ(batch.Flush(), 4u);
+    EXPECT_EQ(batch.Dropped(), 2u);
+    EXPECT_EQ(batch.Buffered(), 0u);
+    EXPECT_EQ(que.Stats()._dropped.load(), 2u);
+
+    que._go = true;
+    que.Release();
+    EXPECT_EQ(que._count, 5);
+}
+
+
+TEST(test_batch, bt_pool)
+{
+    class BatchPool : public WorkQueuePool<BatchItem, BatchPool>
+    {
+        public:
+            BatchPool(size_t queCount) : WorkQueuePool<BatchItem, BatchPool>(queCount) {}
+
+            void Begin()                {}
+            void End()                  {}
+            void Pop(BatchItem *)       { ++_count; }
+
+            std::atomic<int>    _count {0};
+    };
+
+    BatchPool pool(3);
+    pool.Init(WQ_QUEUE_STATE::WORKING, "BatchPool");
+    {
+        WQBatchProducer<BatchPool> batch(pool, 16);
+        for (uint32_t seq = 0; seq < 100; ++seq)
+            batch.Push(BatchItem{0, seq});
+        EXPECT_EQ(batch.Flush(), 4u);
+        EXPECT_EQ(batch.Dropped(), 0u);
+
+        //Paused workers accept nothing
+        pool.SetState(WQ_QUEUE_STATE::PAUSE);
+        batch.Push(BatchItem{0, 100});
+        EXPECT_EQ(batch.Flush(), 0u);
+        EXPECT_EQ(batch.Dropped(), 1u);
+        pool.SetState(WQ_QUEUE_STATE::WORKING);
+    }
+    pool.Flush();
+    pool.Release();
+
+    EXPECT_EQ(pool._count, 100);
+}
+
+
+// clang-format on
@@ -0,0 +1,160 @@
+// clang-format off
+
+
+#include <WorkQueue.h>
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+
+struct Quote
+{
+    uint64_t    _id;
+    int         _price;
+};
+
+
+class QuoteQueue : public WorkQueue<Quote, QuoteQueue>
+{
+    public:
+        void Begin()                {}
+        void End()                  {}
+        void Pop(Quote *pData)
+        {
+            //The gate item parks the consumer so the following pushes stay queued
+            if (kGate == pData->_id)
+            {
+                _parked = true;
+                while (_hold)
+                    std::this_thread::yield();
+                return;
+            }
+            std::lock_guard<std::mutex> lck{_lock};
+            _popped.push_back(*pData);
+        }
+
+        void Park()
+        {
+            _hold = true;
+            PushBack(Quote{kGate, 0});
+            while (false == _parked)
+                std::this_thread::yield();
+            _parked = false;
+        }
+
+        static constexpr uint64_t kGate = UINT64_MAX;
+
+        std::atomic<bool>   _hold   {false};
+        std::atomic<bool>   _parked {false};
+        std::mutex          _lock;
+        std::vector<Quote>  _popped;
+};
+
+
+TEST(test_conflate, cf_position)
+{
+    QuoteQueue que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "QuoteQueue");
+    que.Park();
+
+    EXPECT_EQ(que.PushConflate(1, Quote{1, 10}), 1u);
+    EXPECT_EQ(que.PushConflate(2, Quote{2, 20}), 2u);
+    que.PushBack(Quote{0, 0});
+    EXPECT_EQ(que.PushConflate(1, Quote{1, 11}), 3u);
+    EXPECT_EQ(que.PushConflate(1, Quote{1, 12}), 3u);
+    que.PushConflate(3, Quote{3, 30});
+
+    que._hold = false;
+    que.Flush();
+
+    //Newest value at the oldest position, plain pushes are never conflated
+    ASSERT_EQ(que._popped.size(), 4u);
+    EXPECT_EQ(que._popped[0]._id, 1u);
+    EXPECT_EQ(que._popped[0]._price, 12);
+    EXPECT_EQ(que._popped[1]._price, 20);
+    EXPECT_EQ(que._popped[2]._id, 0u);
+    EXPECT_EQ(que._popped[3]._price, 30);
+    EXPECT_EQ(que.Stats()._dropped.load(), 2u);
+
+    //Once popped, a key queues again
+    que.PushConflate(1, Quote{1, 13});
+    que.Flush();
+    ASSERT_EQ(que._popped.size(), 5u);
+    EXPECT_EQ(que._popped[4]._price, 13);
+
+    que.Release();
+}
+
+
+TEST(test_conflate, cf_fresh)
+{
+    QuoteQueue que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "QuoteFresh");
+    que.Park();
+
+    que.PushConflate(1, Quote{1, 10});
+    que.PushFresh(Quote{0, 0});
+    //The index does not outlive the items PushFresh cleared
+    que.PushConflate(1, Quote{1, 11});
+    EXPECT_EQ(que.Stats()._dropped.load(), 1u);
+
+    que._hold = false;
+    EXPECT_EQ(que.WaitIdle(SEC_TO_NS(5)), 0);
+    que.Release();
+
+    ASSERT_EQ(que._popped.size(), 2u);
+    EXPECT_EQ(que._popped[1]._price, 11);
+}
+
+
+TEST(test_conflate, cf_pool)
+{
+    class QuotePool : public WorkQueuePool<Quote, QuotePool>
+    {
+        public:
+            QuotePool(size_t queCount) : WorkQueuePool<Quote, QuotePool>(queCount) {}
+
+            void Begin()            {}
+            void End()              {}
+            void Pop(Quote *pData)
+            {
+                std::lock_guard<std::mutex> lck{_lock};
+                if (pData->_price < _last[pData->_id])
+                    ++_regressed;
+                _last[pData->_id] = pData->_price;
+                ++_count;
+            }
+
+            std::mutex                  _lock;
+            std::map<uint64_t, int>     _last;
+            int                         _regressed = 0;
+            std::atomic<int>            _count {0};
+    };
+
+    QuotePool pool(3);
+    pool.Init(WQ_QUEUE_STATE::WORKING, "QuotePool");
+
+    //A key always maps to the same worker, so its updates stay ordered
+    for (int price = 1; price <= 1000; ++price)
+        for (uint64_t id = 0; id < 8; ++id)
+            EXPECT_EQ(pool.PushConflate(id, Quote{id, price}), int(id % 3));
+    pool.Flush();
+    pool.Release();
+
+    EXPECT_EQ(pool._regressed, 0);
+    for (uint64_t id = 0; id < 8; ++id)
+        EXPECT_EQ(pool._last[id], 1000);
+
+    uint64_t dropped = 0;
+    for (size_t i = 0; i < 3; ++i)
+        dropped += pool.QueStats(i)._dropped.load();
+    EXPECT_EQ(uint64_t(pool._count) + dropped, 8000u);
+}
+
+
+// clang-format on
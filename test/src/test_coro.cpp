@@ -0,0 +1,196 @@
+// clang-format off
+
+
+#include <WorkQueue.h>
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+
+
+
+class CoroQue : public WorkQueue<int, CoroQue>
+{
+    public:
+        void Begin()            { _tid = std::this_thread::get_id(); }
+        void End()              {}
+        void Pop(int *)         { while (_block) std::this_thread::yield(); ++_pops; }
+
+        std::thread::id     _tid;
+        std::atomic<int>    _pops  {0};
+        std::atomic_bool    _block {false};
+};
+
+
+class CoroTicker : public TickThread<CoroTicker>
+{
+    public:
+        bool OnBegin()          { _tid = std::this_thread::get_id(); return true; }
+        void OnEnd()            {}
+        void Tick()             {}
+
+        std::thread::id     _tid;
+};
+
+
+struct CallRecord
+{
+    std::atomic<int>    _run       {0};
+    std::atomic<int>    _cancelled {0};
+    std::thread::id     _tid;
+
+    static void Call(void *ctx, bool cancelled)
+    {
+        auto *rec = static_cast<CallRecord *>(ctx);
+        rec->_tid = std::this_thread::get_id();
+        ++(cancelled ? rec->_cancelled : rec->_run);
+    }
+};
+
+
+TEST(test_coro, co_pushcall)
+{
+    CoroQue que;
+    que.SetWaitTime({0, long(MS_TO_NS(1))});
+    que.Init(WQ_QUEUE_STATE::WORKING, "CoroQue");
+
+    CallRecord rec;
+    EXPECT_EQ(que.PushCall(&CallRecord::Call, &rec), 0);
+    que.PushBack(1);
+    while (que._pops < 1)
+        std::this_thread::yield();
+    EXPECT_EQ(rec._run, 1);
+    EXPECT_EQ(rec._tid, que._tid);
+
+    //PushFresh cancels the queued call on the pushing thread
+    que._block = true;
+    que.PushBack(2);
+    while (que.Size() > 0)
+        std::this_thread::yield();
+    EXPECT_EQ(que.PushCall(&CallRecord::Call, &rec), 0);
+    que.PushFresh(3);
+    EXPECT_EQ(rec._cancelled, 1);
+    EXPECT_EQ(rec._tid, std::this_thread::get_id());
+    que._block = false;
+
+    //Paused queue rejects without calling back
+    que.SetState(WQ_QUEUE_STATE::PAUSE);
+    EXPECT_EQ(que.PushCall(&CallRecord::Call, &rec), -1);
+
+    que.SetState(WQ_QUEUE_STATE::WORKING);
+    que.Release();
+    EXPECT_EQ(rec._run, 1);
+    EXPECT_EQ(rec._cancelled, 1);
+    EXPECT_EQ(que._pops, 3);
+}
+
+
+TEST(test_coro, co_timer)
+{
+    CoroTicker ticker;
+    ticker.SetInterval(MS_TO_NS(1));
+
+    CallRecord early, late;
+    EXPECT_EQ(ticker.AddTimer(MS_TO_NS(2), &CallRecord::Call, &early), 0);
+    EXPECT_EQ(ticker.AddTimer(SEC_TO_NS(60), &CallRecord::Call, &late), 0);
+    ticker.Start();
+
+    while (early._run == 0)
+        std::this_thread::yield();
+    EXPECT_EQ(early._tid, ticker._tid);
+
+    ticker.Stop();
+    EXPECT_EQ(late._run, 0);
+    EXPECT_EQ(late._cancelled, 1);
+    EXPECT_EQ(ticker.AddTimer(0, &CallRecord::Call, &late), -1);
+}
+
+
+
+
+#if defined(__cpp_impl_coroutine)
+
+static WQDetachedTask HopTask(CoroQue &que, CoroTicker &ticker, std::atomic<int> &step,
+                              std::thread::id &queTid, std::thread::id &tickTid)
+{
+    bool ok = co_await que.Schedule();
+    if (false == ok)
+        co_return;
+    queTid = std::this_thread::get_id();
+    ++step;
+
+    ok = co_await ticker.After(MS_TO_NS(2));
+    if (false == ok)
+        co_return;
+    tickTid = std::this_thread::get_id();
+    ++step;
+}
+
+
+static WQDetachedTask RejectTask(CoroQue &que, std::atomic<int> &result)
+{
+    bool ok = co_await que.Schedule();
+    result  = ok ? 1 : -1;
+}
+
+
+class CoroPool : public WorkQueuePool<int, CoroPool>
+{
+    public:
+        CoroPool(size_t queCount) : WorkQueuePool<int, CoroPool>(queCount) {}
+
+        void Begin()            {}
+        void End()              {}
+        void Pop(int *)         {}
+};
+
+
+static WQDetachedTask PoolTask(CoroPool &pool, std::atomic<int> &done)
+{
+    for (size_t idx = 0; idx < 3; ++idx)
+    {
+        bool ok = co_await pool.Schedule(idx);
+        done += ok;
+    }
+    bool ok = co_await pool.Schedule();
+    done += ok;
+}
+
+
+TEST(test_coro, co_schedule)
+{
+    CoroQue que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "CoroQue");
+    CoroTicker ticker;
+    ticker.SetInterval(MS_TO_NS(1));
+    ticker.Start();
+
+    std::atomic<int> step {0};
+    std::thread::id  queTid, tickTid;
+    HopTask(que, ticker, step, queTid, tickTid);
+    while (step < 2)
+        std::this_thread::yield();
+    EXPECT_EQ(queTid,  que._tid);
+    EXPECT_EQ(tickTid, ticker._tid);
+
+    ticker.Stop();
+    que.Release();
+
+    //Not WORKING any more: resumed inline with false
+    std::atomic<int> result {0};
+    RejectTask(que, result);
+    EXPECT_EQ(result, -1);
+
+    CoroPool pool(3);
+    pool.Init(WQ_QUEUE_STATE::WORKING, "CoroPool");
+    std::atomic<int> done {0};
+    PoolTask(pool, done);
+    while (done < 4)
+        std::this_thread::yield();
+    pool.Release();
+}
+
+#endif // __cpp_impl_coroutine
+
+
+// clang-format on
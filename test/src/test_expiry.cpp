@@ -0,0 +1,156 @@
+// clang-format off
+
+
+#include <WorkQueue.h>
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+
+
+
+class ExpiryQueue : public WorkQueue<int, ExpiryQueue>
+{
+    public:
+        void Begin()                {}
+        void End()                  {}
+        void Pop(int *pData)
+        {
+            //A negative item parks the consumer so the following pushes stay queued
+            if (*pData < 0)
+            {
+                _parked = true;
+                while (_hold)
+                    std::this_thread::yield();
+                return;
+            }
+            _sum += *pData;
+            ++_popped;
+        }
+        void OnExpired(int *pData, WQ_EXPIRE_REASON reason)
+        {
+            _expiredSum += *pData;
+            ++_reasons[int(reason)];
+        }
+
+        void Park()
+        {
+            _hold = true;
+            PushBack(-1);
+            while (false == _parked)
+                std::this_thread::yield();
+            _parked = false;
+        }
+
+        std::atomic<bool>   _hold       {false};
+        std::atomic<bool>   _parked     {false};
+        std::atomic<int>    _sum        {0};
+        std::atomic<int>    _popped     {0};
+        std::atomic<int>    _expiredSum {0};
+        std::atomic<int>    _reasons[3] {};
+};
+
+
+TEST(test_expiry, ex_token)
+{
+    WQCancelToken empty;
+    EXPECT_FALSE(bool(empty));
+    empty.Cancel();
+    EXPECT_FALSE(empty.IsCancelled());
+
+    WQCancelToken token = WQCancelToken::Create();
+    WQCancelToken copy  = token;
+    EXPECT_FALSE(copy.IsCancelled());
+    token.Cancel();
+    EXPECT_TRUE(copy.IsCancelled());
+
+    EXPECT_STREQ(WQ_EXPIRE_REASON_text(WQ_EXPIRE_REASON::CANCELLED), "CANCELLED");
+}
+
+
+TEST(test_expiry, ex_deadline)
+{
+    ExpiryQueue que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "ExpiryQueue");
+    que.Park();
+
+    que.PushExpiring(1, WQItemLimit::Ttl(MS_TO_NS(1)));
+    que.PushExpiring(2, WQItemLimit::Ttl(SEC_TO_NS(60)));
+    que.PushExpiring(4, WQItemLimit::Deadline(WQNowNs() - 1));
+    que.PushBack(8);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    que._hold = false;
+    que.Flush();
+    que.Release();
+
+    EXPECT_EQ(que._sum, 10);
+    EXPECT_EQ(que._expiredSum, 5);
+    EXPECT_EQ(que._reasons[int(WQ_EXPIRE_REASON::DEADLINE)], 2);
+    EXPECT_EQ(que.Stats()._expired.load(), 2u);
+    EXPECT_EQ(que.Stats()._cancelled.load(), 0u);
+    EXPECT_EQ(que.Stats()._dropped.load(), 0u);
+}
+
+
+TEST(test_expiry, ex_cancel)
+{
+    ExpiryQueue que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "ExpiryCancel");
+    que.Park();
+
+    //One token for a whole request, cancelled in bulk while its items are still pending
+    WQCancelToken request = WQCancelToken::Create();
+    for (int i = 0; i < 100; ++i)
+        que.PushExpiring(1, WQItemLimit::Token(request));
+    que.PushExpiring(1000, WQItemLimit::Token(WQCancelToken::Create()));
+    request.Cancel();
+
+    //Discarded items still count for the WaitIdle barrier
+    que.PushBack(5);
+    que._hold = false;
+    EXPECT_EQ(que.WaitIdle(SEC_TO_NS(5)), 0);
+    que.Release();
+
+    EXPECT_EQ(que._sum, 1005);
+    EXPECT_EQ(que._reasons[int(WQ_EXPIRE_REASON::CANCELLED)], 100);
+    EXPECT_EQ(que.Stats()._cancelled.load(), 100u);
+    EXPECT_EQ(que.Stats()._popped.load() + que.Stats()._cancelled.load(), que.Stats()._pushed.load());
+}
+
+
+TEST(test_expiry, ex_pool)
+{
+    class ExpiryPool : public WorkQueuePool<int, ExpiryPool>
+    {
+        public:
+            ExpiryPool(size_t queCount) : WorkQueuePool<int, ExpiryPool>(queCount) {}
+
+            void Begin()            {}
+            void End()              {}
+            void Pop(int *pData)    { _sum += *pData; }
+            void OnExpired(int *, WQ_EXPIRE_REASON)     { ++_expired; }
+
+            std::atomic<int>    _sum     {0};
+            std::atomic<int>    _expired {0};
+    };
+
+    ExpiryPool pool(2);
+    pool.Init(WQ_QUEUE_STATE::WORKING, "ExpiryPool");
+
+    WQCancelToken token = WQCancelToken::Create();
+    token.Cancel();
+    for (int i = 0; i < 10; ++i)
+    {
+        EXPECT_GE(pool.PushExpiring(1, WQItemLimit::Token(token)), 0);
+        EXPECT_GE(pool.PushExpiring(1, WQItemLimit::Ttl(SEC_TO_NS(60))), 0);
+    }
+    pool.Flush();
+    pool.Release();
+
+    EXPECT_EQ(pool._sum, 10);
+    EXPECT_EQ(pool._expired, 10);
+}
+
+
+// clang-format on
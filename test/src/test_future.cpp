@@ -0,0 +1,195 @@
+
+// clang-format off
+
+
+#include <WorkQueue.h>
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+
+
+class FutureQue : public WorkQueue<int, FutureQue>
+{
+    public:
+        void Begin()            {}
+        void End()              {}
+        int  Pop(int *pData)    { return *pData * 2; }
+};
+
+
+class FutureVoidQue : public WorkQueue<int, FutureVoidQue>
+{
+    public:
+        void Begin()            {}
+        void End()              {}
+        void Pop(int *pData)    { _sum += *pData; }
+
+        int _sum = 0;
+};
+
+
+class FuturePool : public WorkQueuePool<int, FuturePool>
+{
+    public:
+        FuturePool(size_t queCount) : WorkQueuePool<int, FuturePool>(queCount) {}
+
+        void        Begin()             {}
+        void        End()               {}
+        std::string Pop(int *pData)     { return std::to_string(*pData); }
+};
+
+
+TEST(test_future, fu_submit)
+{
+    FutureQue que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "FutureQue");
+
+    std::vector<WQFuture<int>> futures;
+    for (int i = 0; i < 100; ++i)
+        futures.push_back(que.Submit(i));
+
+    for (int i = 0; i < 100; ++i)
+    {
+        int val = -1;
+        EXPECT_EQ(futures[i].Get(val), 0);
+        EXPECT_EQ(val, i * 2);
+        EXPECT_TRUE(futures[i].IsReady());
+    }
+
+    std::atomic<int> seen {0};
+    WQFuture<int> fut = que.Submit(21);
+    EXPECT_EQ(fut.Then([&seen](int *val) { seen = val ? *val : -1; }), 0);
+    EXPECT_EQ(fut.Then([](int *) {}), -1);     // only one continuation
+    EXPECT_EQ(fut.Wait(), 0);
+    EXPECT_EQ(seen, 42);
+
+    que.Release();
+
+    //Queue no longer WORKING: the future is broken right away, continuation runs on the caller
+    WQFuture<int> late = que.Submit(1);
+    EXPECT_TRUE(late.IsBroken());
+    int cont = 0;
+    late.Then([&cont](int *val) { cont = val ? 1 : -1; });
+    EXPECT_EQ(cont, -1);
+    EXPECT_EQ(late.Wait(), -1);
+}
+
+
+TEST(test_future, fu_void_paused)
+{
+    FutureVoidQue que;
+    que.SetWaitTime({0, long(MS_TO_NS(1))});
+    que.Init(WQ_QUEUE_STATE::PAUSE, "FutureVoidQue");
+
+    //Paused queue rejects: broken immediately, WaitFor does not block
+    WQFuture<void> fut = que.Submit(5);
+    EXPECT_EQ(fut.WaitFor(MS_TO_NS(1)), -1);
+
+    que.SetState(WQ_QUEUE_STATE::WORKING);
+    WQFuture<void> ok = que.Submit(7);
+    EXPECT_EQ(ok.Wait(), 0);
+    que.Release();
+    EXPECT_EQ(que._sum, 7);
+}
+
+
+TEST(test_future, fu_pool)
+{
+    FuturePool pool(3);
+    pool.Init(WQ_QUEUE_STATE::WORKING, "FuturePool");
+
+    std::vector<WQFuture<std::string>> futures;
+    for (int i = 0; i < 30; ++i)
+        futures.push_back(pool.Submit(i));
+
+    for (int i = 0; i < 30; ++i)
+    {
+        std::string val;
+        EXPECT_EQ(futures[i].Get(val), 0);
+        EXPECT_EQ(val, std::to_string(i));
+    }
+    pool.Release();
+}
+
+
+
+//Result type of its own, so the test owns the slab it exhausts
+struct SlabResult
+{
+    int _value;
+};
+
+
+class SlabQue : public WorkQueue<int, SlabQue>
+{
+    public:
+        void        Begin()             {}
+        void        End()               {}
+        SlabResult  Pop(int *pData)
+        {
+            while (false == _go.load())
+                usleep(100);
+            return SlabResult{*pData};
+        }
+
+        std::atomic_bool    _go {false};
+};
+
+
+TEST(test_future, fu_exhaust)
+{
+    using TSlab = WQFutureSlab<SlabResult>;
+    TSlab::Instance().SetMaxChunks(1);
+
+    SlabQue que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "FutureExhaust");
+
+    //Every state of the slab held by a pending future, one more Submit is not queued
+    std::vector<WQFuture<SlabResult>> futures;
+    for (uint32_t idx = 0; idx < TSlab::CHUNK_SIZE; ++idx)
+    {
+        futures.push_back(que.Submit(int(idx)));
+        ASSERT_TRUE(futures.back().Valid());
+    }
+    WQFuture<SlabResult> lost = que.Submit(-1);
+    EXPECT_FALSE(lost.Valid());
+    EXPECT_EQ(que.Stats()._dropped.load(), 1u);
+    EXPECT_EQ(que.Stats()._pushed.load(), uint64_t(TSlab::CHUNK_SIZE));
+
+    que._go = true;
+    SlabResult res {-1};
+    EXPECT_EQ(futures.back().Get(res), 0);
+    EXPECT_EQ(res._value, int(TSlab::CHUNK_SIZE - 1));
+
+    //Completed futures give their states back
+    futures.clear();
+    WQFuture<SlabResult> again = que.Submit(7);
+    ASSERT_TRUE(again.Valid());
+    EXPECT_EQ(again.Get(res), 0);
+    EXPECT_EQ(res._value, 7);
+
+    que.Release();
+    EXPECT_EQ(que.Stats()._popped.load(), uint64_t(TSlab::CHUNK_SIZE + 1));
+}
+
+
+//Released during static destruction, the slab it returns its state to must still be there
+static WQFuture<int> s_future;
+
+TEST(test_future, fu_static)
+{
+    FutureQue que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "FutureStatic");
+    s_future = que.Submit(21);
+    que.Release();
+
+    int val = -1;
+    EXPECT_EQ(s_future.Get(val), 0);
+    EXPECT_EQ(val, 42);
+}
+
+// clang-format on
@@ -0,0 +1,162 @@
+// clang-format off
+
+
+#include <WorkQueue.h>
+
+#include "TestUtil.h"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+
+
+//Item -1 hangs until released, 99 must stay on the worker thread
+template <typename TPolicy = WQDefaultPolicy>
+class InlineQueue : public WorkQueue<int, InlineQueue<TPolicy>, TPolicy>
+{
+    public:
+        void Begin()                {}
+        void End()                  {}
+
+        void Pop(int *pData)
+        {
+            if (*pData < 0)
+            {
+                _hung = true;
+                while (false == _release.load())
+                    usleep(100);
+            }
+            std::lock_guard<std::mutex> lck{_lock};
+            _order.push_back(*pData);
+            _threads.push_back(std::this_thread::get_id());
+        }
+
+        bool CanRunInline(const int *pData) const   { return 99 != *pData; }
+
+        std::atomic_bool                _hung    {false};
+        std::atomic_bool                _release {false};
+        std::mutex                      _lock;
+        std::vector<int>                _order;
+        std::vector<std::thread::id>    _threads;
+};
+
+
+TEST(test_inline, in_idle)
+{
+    InlineQueue<> que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "InlineIdle");
+
+    //Idle queue: Pop runs right here, before PushOrRun returns
+    EXPECT_EQ(que.PushOrRun(1), 1);
+    EXPECT_EQ(que.PushOrRun(2), 1);
+    ASSERT_EQ(que._order.size(), 2u);
+    EXPECT_EQ(que._threads[0], std::this_thread::get_id());
+    EXPECT_EQ(que.Stats()._inlined.load(), 2u);
+    EXPECT_EQ(que.Stats()._pushed.load(),  2u);
+    EXPECT_EQ(que.Stats()._popped.load(),  2u);
+    EXPECT_EQ(que.WaitIdle(SEC_TO_NS(1)), 0);
+
+    //Not inline-able: queued for the worker as PushBack would
+    EXPECT_EQ(que.PushOrRun(99), 0);
+    que.Flush();
+    ASSERT_EQ(que._order.size(), 3u);
+    EXPECT_NE(que._threads[2], std::this_thread::get_id());
+    EXPECT_EQ(que.Stats()._inlined.load(), 2u);
+    que.Release();
+
+    //Only a WORKING queue takes items
+    EXPECT_EQ(que.PushOrRun(3), -1);
+}
+
+
+TEST(test_inline, in_order)
+{
+    InlineQueue<> que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "InlineOrder");
+
+    //While the worker holds a batch nothing may overtake it
+    que.PushBack(-1);
+    ASSERT_TRUE(WaitFor([&]() { return que._hung.load(); }));
+    for (int i = 1; i <= 5; ++i)
+        EXPECT_EQ(que.PushOrRun(i), 0);
+
+    que._release = true;
+    que.Flush();
+    que.Release();
+
+    EXPECT_EQ(que._order, (std::vector<int>{-1, 1, 2, 3, 4, 5}));
+    EXPECT_EQ(que.Stats()._inlined.load(), 0u);
+}
+
+
+TEST(test_inline, in_overflow)
+{
+    InlineQueue<WQBoundedPolicy<4>> que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "InlineFull");
+
+    que.PushBack(-1);
+    ASSERT_TRUE(WaitFor([&]() { return que._hung.load(); }));
+    for (int i = 1; i <= 4; ++i)
+        que.PushBack(i);
+    ASSERT_EQ(que.Size(), 4u);
+
+    //Caller-runs: the full queue holds the caller until the worker's batch is done, no drop
+    std::atomic<int> rc {-2};
+    std::thread producer([&]() { rc = que.PushOrRun(5); });
+    usleep(20000);
+    EXPECT_EQ(rc.load(), -2);
+
+    que._release = true;
+    producer.join();
+    EXPECT_GE(rc.load(), 0);
+    que.Flush();
+    que.Release();
+
+    EXPECT_EQ(que._order, (std::vector<int>{-1, 1, 2, 3, 4, 5}));
+    EXPECT_EQ(que.Stats()._dropped.load(), 0u);
+    EXPECT_EQ(que.Stats()._popped.load(), 6u);
+}
+
+
+TEST(test_inline, in_pool)
+{
+    class InlinePool : public WorkQueuePool<int, InlinePool>
+    {
+        public:
+            InlinePool(size_t queCount) : WorkQueuePool<int, InlinePool>(queCount) {}
+
+            void Begin()            {}
+            void End()              {}
+            void Pop(int *pData)    { _sum += *pData; _caller += (std::this_thread::get_id() == _self) ? 1 : 0; }
+
+            bool CanRunInline(const int * /*pData*/) const  { return _inline; }
+
+            bool                _inline = true;
+            std::thread::id     _self   = std::this_thread::get_id();
+            std::atomic<int>    _sum    {0};
+            std::atomic<int>    _caller {0};
+    };
+
+    InlinePool pool(2);
+    pool.Init(WQ_QUEUE_STATE::WORKING, "InlinePool");
+    int idx = pool.PushOrRun(2);
+    ASSERT_GE(idx, 0);
+    EXPECT_EQ(pool._caller.load(), 1);
+
+    //Refused by the hook PushOrRun is a plain push
+    pool._inline = false;
+    EXPECT_GE(pool.PushOrRun(1), 0);
+    pool.Flush();
+    pool.Release();
+
+    EXPECT_EQ(pool._sum.load(), 3);
+    EXPECT_EQ(pool._caller.load(), 1);
+    EXPECT_EQ(pool.QueStats(idx)._inlined.load(), 1u);
+}
+
+
+// clang-format on
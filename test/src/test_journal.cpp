@@ -0,0 +1,232 @@
+// clang-format off
+
+
+#include <WorkQueue.h>
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+
+static std::string MakeJournalDir()
+{
+    char tmpl[] = "/tmp/wq_journal_XXXXXX";
+    EXPECT_NE(mkdtemp(tmpl), nullptr);
+    return tmpl;
+}
+
+
+static size_t CountSegments(const std::string &dir)
+{
+    size_t count = 0;
+    if (DIR *d = opendir(dir.c_str()))
+    {
+        while (dirent *entry = readdir(d))
+            count += (nullptr != strstr(entry->d_name, ".wqj")) ? 1 : 0;
+        closedir(d);
+    }
+    return count;
+}
+
+
+static void RemoveJournalDir(const std::string &dir)
+{
+    if (DIR *d = opendir(dir.c_str()))
+    {
+        while (dirent *entry = readdir(d))
+            if ('.' != entry->d_name[0])
+                unlink((dir + "/" + entry->d_name).c_str());
+        closedir(d);
+    }
+    rmdir(dir.c_str());
+}
+
+
+TEST(test_journal, jr_recover)
+{
+    std::string dir = MakeJournalDir();
+    WQJournalConfig cfg;
+    cfg._segmentRecords = 16;
+
+    {
+        WQJournal journal(dir, sizeof(uint64_t), cfg);
+        ASSERT_EQ(journal.Open([](uint64_t, const void *) { FAIL(); }), 0);
+
+        std::vector<uint64_t> seqs;
+        for (uint64_t val = 0; val < 40; ++val)
+            seqs.push_back(journal.Append(&val));
+        EXPECT_EQ(CountSegments(dir), 3u);
+
+        //Acknowledging the whole first segment removes its file
+        for (size_t idx = 0; idx < 16; ++idx)
+            journal.Ack(seqs[idx]);
+        journal.Ack(seqs[20]);
+        EXPECT_EQ(CountSegments(dir), 2u);
+        EXPECT_EQ(journal.Sync(), 0);
+    }
+
+    std::vector<uint64_t> values;
+    {
+        WQJournal journal(dir, sizeof(uint64_t), cfg);
+        ASSERT_EQ(journal.Open([&values](uint64_t, const void *rec) { values.push_back(*static_cast<const uint64_t *>(rec)); }), 0);
+
+        //New records start in a fresh segment
+        uint64_t val = 99;
+        EXPECT_EQ(journal.Append(&val), 3u * 16 + 1);
+    }
+    ASSERT_EQ(values.size(), 23u);
+    EXPECT_EQ(values.front(), 16u);
+    EXPECT_EQ(values[4],      21u);
+    EXPECT_EQ(values.back(),  39u);
+
+    //A different record size does not match the segments on disk
+    WQJournal other(dir, 4, cfg);
+    EXPECT_EQ(other.Open([](uint64_t, const void *) {}), -1);
+
+    RemoveJournalDir(dir);
+}
+
+
+TEST(test_journal, jr_crash)
+{
+    std::string dir = MakeJournalDir();
+    WQJournalConfig cfg;
+    cfg._segmentRecords = 16;
+
+    {
+        WQJournal journal(dir, sizeof(uint64_t), cfg);
+        ASSERT_EQ(journal.Open([](uint64_t, const void *) { FAIL(); }), 0);
+        for (uint64_t val = 0; val < 20; ++val)
+            EXPECT_NE(journal.Append(&val), 0u);
+    }
+
+    //What a crash while creating a segment can leave: a temporary file, a segment whose
+    //header never reached the disk and one that was not even sized
+    struct stat st;
+    ASSERT_EQ(stat((dir + "/0000000000000000.wqj").c_str(), &st), 0);
+    const std::pair<const char *, off_t> leftovers[] = {{"/0000000000000002.wqj",     st.st_size},
+                                                        {"/0000000000000003.wqj",     0},
+                                                        {"/0000000000000004.wqj.tmp", st.st_size}};
+    for (const auto &leftover : leftovers)
+    {
+        int fd = open((dir + leftover.first).c_str(), O_RDWR | O_CREAT, 0644);
+        ASSERT_GE(fd, 0);
+        EXPECT_EQ(ftruncate(fd, leftover.second), 0);
+        close(fd);
+    }
+    EXPECT_EQ(CountSegments(dir), 5u);
+
+    size_t recovered = 0;
+    {
+        WQJournal journal(dir, sizeof(uint64_t), cfg);
+        ASSERT_EQ(journal.Open([&recovered](uint64_t, const void *) { ++recovered; }), 0);
+        EXPECT_EQ(CountSegments(dir), 2u);
+
+        uint64_t val = 99;
+        EXPECT_EQ(journal.Append(&val), 2u * 16 + 1);
+    }
+    EXPECT_EQ(recovered, 20u);
+
+    RemoveJournalDir(dir);
+}
+
+
+TEST(test_journal, jr_full)
+{
+    std::string dir = MakeJournalDir();
+    WQJournalConfig cfg;
+    cfg._segmentRecords = 4;
+    cfg._maxSegments    = 2;
+
+    WQJournal journal(dir, sizeof(uint32_t), cfg);
+    ASSERT_EQ(journal.Open([](uint64_t, const void *) {}), 0);
+
+    uint32_t val = 0;
+    for (int idx = 0; idx < 8; ++idx)
+        EXPECT_NE(journal.Append(&val), 0u);
+    EXPECT_EQ(journal.Append(&val), 0u);
+
+    for (uint64_t seq = 1; seq <= 4; ++seq)
+        journal.Ack(seq);
+    EXPECT_EQ(journal.Append(&val), 9u);
+
+    journal.Close();
+    RemoveJournalDir(dir);
+}
+
+
+struct JournalItem
+{
+    uint32_t    _id;
+    uint32_t    _value;
+};
+
+
+class JournalQueue : public WorkQueue<JournalItem, JournalQueue>
+{
+    public:
+        void Begin()            {}
+        void End()              {}
+        void Pop(JournalItem *pData)
+        {
+            while (_hold.load())
+                usleep(100);
+            _ids.push_back(pData->_id);
+        }
+
+        std::atomic_bool        _hold {false};
+        std::vector<uint32_t>   _ids;
+};
+
+
+TEST(test_journal, jr_queue)
+{
+    std::string dir = MakeJournalDir();
+    WQJournalConfig cfg;
+    cfg._segmentRecords = 8;
+    cfg._syncEvery      = 4;
+
+    {
+        //A forced exit leaves everything behind the blocked Pop in the journal
+        JournalQueue que;
+        ASSERT_EQ(que.EnableJournal(dir, cfg), 0);
+        que._hold = true;
+        ASSERT_EQ(que.Init(WQ_QUEUE_STATE::WORKING, "Journal"), 0);
+        EXPECT_EQ(que.EnableJournal(dir, cfg), -1);
+
+        for (uint32_t id = 0; id < 20; ++id)
+            que.PushBack(JournalItem{id, id * 2});
+        que.SetState(WQ_QUEUE_STATE::EXITING_FORCE);
+        que._hold = false;
+        que.Release(true);
+    }
+
+    {
+        JournalQueue que;
+        ASSERT_EQ(que.EnableJournal(dir, cfg), 0);
+        ASSERT_EQ(que.Init(WQ_QUEUE_STATE::WORKING, "Journal"), 0);
+        que.PushBack(JournalItem{100, 0});
+        que.Release();
+
+        //At most the item held by the first run was processed, the rest comes back in order
+        ASSERT_GE(que._ids.size(), 20u);
+        EXPECT_EQ(que._ids.back(), 100u);
+        for (size_t idx = 1; idx + 1 < que._ids.size(); ++idx)
+            EXPECT_EQ(que._ids[idx], que._ids[idx - 1] + 1);
+    }
+
+    //Everything was acknowledged, every segment is gone
+    EXPECT_EQ(CountSegments(dir), 0u);
+    RemoveJournalDir(dir);
+}
+
+
+// clang-format on
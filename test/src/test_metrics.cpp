@@ -0,0 +1,113 @@
+
+// clang-format off
+
+
+#include <MetricsReporter.h>
+
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+
+
+class MetricsQue : public WorkQueue<int, MetricsQue>
+{
+    public:
+        void Begin()        {}
+        void End()          {}
+        int  Pop(int *)     { return 0; }
+};
+
+
+class MetricsPool : public WorkQueuePool<int, MetricsPool>
+{
+    public:
+        MetricsPool(size_t queCount) : WorkQueuePool<int, MetricsPool>(queCount) {}
+
+        void Begin()        {}
+        void End()          {}
+        int  Pop(int *)     { return 0; }
+};
+
+
+TEST(test_metrics, mr_prometheus)
+{
+    MetricsQue que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "MetricsQue");
+    for (int i = 0; i < 10; ++i)
+        que.PushBack(i);
+    que.Release();
+    que.PushBack(0);    //dropped, queue is no longer WORKING
+
+    MetricsPool pool(2);
+    pool.Init(WQ_QUEUE_STATE::WORKING, "MetricsPool");
+
+    MetricsReporter reporter;
+    reporter.Register(que);
+    reporter.RegisterPool(pool);
+
+    std::string text = reporter.Snapshot();
+    EXPECT_NE(text.find("workqueue_pushed_total{queue=\"MetricsQue\"} 10"),   std::string::npos);
+    EXPECT_NE(text.find("workqueue_popped_total{queue=\"MetricsQue\"} 10"),   std::string::npos);
+    EXPECT_NE(text.find("workqueue_dropped_total{queue=\"MetricsQue\"} 1"),   std::string::npos);
+    EXPECT_NE(text.find("workqueue_depth{queue=\"MetricsPool:0\"} 0"),        std::string::npos);
+    EXPECT_NE(text.find("workqueue_depth{queue=\"MetricsPool:1\"} 0"),        std::string::npos);
+    EXPECT_NE(text.find("workqueue_wait_seconds_count{queue=\"MetricsQue\"} 10"), std::string::npos);
+
+    reporter.Unregister(&pool);
+    EXPECT_EQ(reporter.Snapshot().find("MetricsPool"), std::string::npos);
+
+    pool.Release();
+}
+
+
+TEST(test_metrics, mr_jsonfile)
+{
+    MetricsQue que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "MetricsJson");
+    for (int i = 0; i < 5; ++i)
+        que.PushBack(i);
+    que.Release();
+
+    std::string path = "/tmp/wq_metrics_" + std::to_string(getpid()) + ".json";
+
+    MetricsReporter reporter;
+    reporter.Register(que);
+    reporter.SetFormat(WQ_METRICS_FORMAT::JSON);
+    reporter.SetOutputFile(path);
+    reporter.SetInterval(MS_TO_NS(1));
+    reporter.Start();
+    while (reporter.TickCount() < 2)
+        usleep(1000);
+    reporter.Stop();
+
+    std::ifstream file(path);
+    std::stringstream ss;
+    ss << file.rdbuf();
+    unlink(path.c_str());
+
+    EXPECT_NE(ss.str().find("\"name\":\"MetricsJson\""), std::string::npos);
+    EXPECT_NE(ss.str().find("\"popped\":5"),              std::string::npos);
+}
+
+
+
+TEST(test_metrics, mr_escape)
+{
+    MetricsQue que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "Esc\"\t\r\\");
+    que.Release();
+
+    MetricsReporter reporter;
+    reporter.Register(que);
+
+    //Label values escape backslash, quote and newline only, JSON strings every control character
+    EXPECT_NE(reporter.Snapshot().find("{queue=\"Esc\\\"\t\r\\\\\"}"), std::string::npos);
+    reporter.SetFormat(WQ_METRICS_FORMAT::JSON);
+    std::string json = reporter.Snapshot();
+    EXPECT_NE(json.find("\"name\":\"Esc\\\"\\t\\r\\\\\""), std::string::npos);
+    EXPECT_EQ(json.find_first_of("\t\r"), std::string::npos);
+}
+
+// clang-format on
@@ -0,0 +1,104 @@
+// clang-format off
+
+
+#include <WorkQueue.h>
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <vector>
+
+
+
+class ParallelPool : public WorkQueuePool<int, ParallelPool>
+{
+    public:
+        ParallelPool(size_t queCount) : WorkQueuePool<int, ParallelPool>(queCount) {}
+
+        void Begin()            {}
+        void End()              {}
+        void Pop(int *)         {}
+};
+
+
+TEST(test_parallel, pf_for)
+{
+    ParallelPool pool(4);
+    pool.Init(WQ_QUEUE_STATE::WORKING, "ParallelPool");
+
+    std::vector<std::atomic<int>> hits(100'000);
+    EXPECT_EQ(pool.ParallelFor(0, hits.size(), [&hits](size_t idx) { ++hits[idx]; }), 0);
+    for (auto &hit : hits)
+        ASSERT_EQ(hit, 1);
+
+    //Sub range, coarse grain, empty range
+    pool.ParallelFor(10, 20, [&hits](size_t idx) { ++hits[idx]; }, 64);
+    pool.ParallelFor(5, 5,   [&hits](size_t idx) { ++hits[idx]; });
+    EXPECT_EQ(hits[9],  1);
+    EXPECT_EQ(hits[10], 2);
+    EXPECT_EQ(hits[19], 2);
+    EXPECT_EQ(hits[5],  1);
+
+    pool.Release();
+}
+
+
+TEST(test_parallel, pf_reduce)
+{
+    ParallelPool pool(3);
+    pool.Init(WQ_QUEUE_STATE::WORKING, "ParallelPool");
+
+    uint64_t sum = pool.ParallelReduce(0, 1'000'001, uint64_t(0),
+                                       [](uint64_t acc, size_t idx) { return acc + idx; });
+    EXPECT_EQ(sum, 500'000'500'000ull);
+
+    size_t top = pool.ParallelReduce(0, 5000, size_t(0),
+                                     [](size_t acc, size_t idx)  { return std::max(acc, (idx * 7919) % 5000); },
+                                     [](size_t lhs, size_t rhs)  { return std::max(lhs, rhs); });
+    EXPECT_EQ(top, 4999u);
+
+    pool.Release();
+}
+
+
+TEST(test_parallel, pf_paused)
+{
+    //Helpers are rejected, the caller does all the work alone
+    ParallelPool pool(2);
+    pool.Init(WQ_QUEUE_STATE::WORKING, "ParallelPool");
+    pool.SetState(WQ_QUEUE_STATE::PAUSE);
+
+    int count = 0;
+    pool.ParallelFor(0, 1000, [&count](size_t) { ++count; });
+    EXPECT_EQ(count, 1000);
+
+    pool.SetState(WQ_QUEUE_STATE::WORKING);
+    pool.Release();
+}
+
+
+TEST(test_parallel, pf_parked)
+{
+    //A parked worker gets no helper, the others still do
+    ParallelPool pool(3);
+    pool.Init(WQ_QUEUE_STATE::WORKING, "ParallelPool");
+    pool.ParkQue(0, true);
+
+    std::atomic<int> count {0};
+    pool.ParallelFor(0, 1000, [&count](size_t) { ++count; });
+    EXPECT_EQ(count, 1000);
+    EXPECT_EQ(pool.QueStats(0)._pushed.load(), 0u);
+    EXPECT_EQ(pool.QueStats(1)._pushed.load(), 1u);
+    EXPECT_EQ(pool.QueStats(2)._pushed.load(), 1u);
+
+    //All of them parked: the caller does all the work alone
+    pool.ParkQue(1, true);
+    pool.ParkQue(2, true);
+    pool.ParallelFor(0, 1000, [&count](size_t) { ++count; });
+    EXPECT_EQ(count, 2000);
+    EXPECT_EQ(pool.QueStats(1)._pushed.load() + pool.QueStats(2)._pushed.load(), 2u);
+
+    pool.Release();
+}
+
+
+// clang-format on
@@ -0,0 +1,161 @@
+// clang-format off
+
+
+#include <WorkQueuePipeline.h>
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+
+
+struct Record
+{
+    int     _value = 0;
+    int     _copies = 0;
+
+    Record(int value) : _value(value) {}
+    Record(const Record &other) : _value(other._value), _copies(other._copies + 1) {}
+    Record(Record &&) = default;
+};
+
+
+struct ParseStage
+{
+    using TIn  = std::string;
+    using TOut = Record;
+
+    void Begin()    {}
+    void End()      {}
+    void Pop(std::string *line, WQPipelineEmit<Record> &out)
+    {
+        int value = std::stoi(*line);
+        if (value % 10 != 0)           // filter
+            out.Push(Record(value));
+    }
+};
+
+
+struct EnrichStage
+{
+    using TIn  = Record;
+    using TOut = std::unique_ptr<Record>;
+
+    void Begin()    {}
+    void End()      {}
+    void Pop(Record *rec, WQPipelineEmit<std::unique_ptr<Record>> &out)
+    {
+        rec->_value *= 2;
+        out.Push(std::make_unique<Record>(std::move(*rec)));
+    }
+};
+
+
+struct PersistStage
+{
+    using TIn  = std::unique_ptr<Record>;
+    using TOut = void;
+
+    void Begin()    {}
+    void End()      {}
+    void Pop(std::unique_ptr<Record> *rec)
+    {
+        while (_block)
+            std::this_thread::yield();
+        _sum    += (*rec)->_value;
+        _copies += (*rec)->_copies;
+        ++_count;
+    }
+
+    std::atomic<long>   _sum    {0};
+    std::atomic<int>    _copies {0};
+    std::atomic<int>    _count  {0};
+    std::atomic_bool    _block  {false};
+};
+
+
+TEST(test_pipeline, pl_chain)
+{
+    Pipeline<ParseStage, EnrichStage, PersistStage> pipe;
+    pipe.SetWorkers(1, 3);
+    pipe.SetLinkCapacity(8);
+    EXPECT_EQ(pipe.Init("chain"), 0);
+    EXPECT_EQ(pipe.Init("chain"), -1);
+
+    long expect = 0;
+    for (int i = 1; i <= 1000; ++i)
+    {
+        EXPECT_EQ(pipe.Push(std::to_string(i)), 0);
+        if (i % 10 != 0)
+            expect += i * 2;
+    }
+    pipe.Release();
+
+    EXPECT_EQ(pipe.Stage<2>()._count, 900);
+    EXPECT_EQ(pipe.Stage<2>()._sum, expect);
+    EXPECT_EQ(pipe.Stage<2>()._copies, 0);
+    EXPECT_EQ(pipe.Push(std::string("1")), -1);
+}
+
+
+TEST(test_pipeline, pl_backpressure)
+{
+    Pipeline<ParseStage, EnrichStage, PersistStage> pipe;
+    pipe.SetLinkCapacity(2);
+    pipe.Stage<2>()._block = true;
+    pipe.Init("backpressure");
+
+    //Blocked tail: every link fills up and the head refuses more
+    int accepted = 0;
+    for (int i = 1; i < 100; ++i)
+    {
+        if (0 != pipe.TryPush(std::to_string(i)))
+        {
+            //Workers may still be moving items down, give them a moment
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            if (0 != pipe.TryPush(std::to_string(i)))
+                break;
+        }
+        ++accepted;
+    }
+    EXPECT_LT(accepted, 20);
+    EXPECT_EQ(pipe.Stage<2>()._count, 0);
+
+    pipe.Stage<2>()._block = false;
+    pipe.Release();
+    EXPECT_EQ(pipe.Stage<2>()._count, accepted);
+}
+
+
+TEST(test_pipeline, pl_force)
+{
+    Pipeline<ParseStage, EnrichStage, PersistStage> pipe;
+    pipe.SetLinkCapacity(2);
+    pipe.Stage<2>()._block = true;
+    pipe.Init("force");
+
+    std::thread producer([&pipe]()
+    {
+        for (int i = 1; i < 100; ++i)
+            if (0 != pipe.Push(std::to_string(i)))
+                break;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    //The producer is parked on the full head link, a forced Release gets it out
+    //and the tail stops right after the item it is blocked on
+    std::thread unblock([&pipe]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        pipe.Stage<2>()._block = false;
+    });
+    pipe.Release(true);
+    producer.join();
+    unblock.join();
+    EXPECT_EQ(pipe.Stage<2>()._count, 1);
+}
+
+
+// clang-format on
@@ -0,0 +1,243 @@
+// clang-format off
+
+
+#include <WorkQueue.h>
+#include <WorkQueueTask.h>
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <vector>
+#include <new>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+
+//Heap allocations of the calling thread, counted by the replaced global operator new
+static thread_local size_t s_allocs = 0;
+
+void *operator new(size_t size)
+{
+    ++s_allocs;
+    if (void *ptr = malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+
+
+template <typename TPolicy>
+class PolicyQueue : public WorkQueue<int, PolicyQueue<TPolicy>, TPolicy>
+{
+    public:
+        void Begin()            {}
+        void End()              {}
+        void Pop(int *pData)
+        {
+            _order.push_back(*pData);
+            _sum += *pData;
+        }
+
+        std::vector<int>    _order;
+        std::atomic<int>    _sum {0};
+};
+
+
+template <typename TPolicy>
+static void CheckOrder()
+{
+    PolicyQueue<TPolicy> que;
+    que.Init(WQ_QUEUE_STATE::PAUSE, "PolicyQueue");
+
+    que.SetState(WQ_QUEUE_STATE::WORKING);
+    for (int i = 1; i <= 1000; ++i)
+        que.PushBack(i);
+    que.Release();
+
+    ASSERT_EQ(que._order.size(), 1000u);
+    for (int i = 0; i < 1000; ++i)
+        ASSERT_EQ(que._order[i], i + 1);
+    EXPECT_EQ(que.Stats()._popped.load(), 1000u);
+}
+
+
+TEST(test_policy, po_default)
+{
+    CheckOrder<WQDefaultPolicy>();
+}
+
+
+TEST(test_policy, po_lowlatency)
+{
+    CheckOrder<WQLowLatencyPolicy>();
+}
+
+
+TEST(test_policy, po_mixed)
+{
+    CheckOrder<WQPolicy<WQDequeContainer, WQSpinLock, WQCondAnyWake, WQVectorDrain, WQStateAtomic>>();
+    CheckOrder<WQPolicy<WQDequeContainer, std::mutex, WQFutexWake, WQListDrain,   WQStateShared>>();
+}
+
+
+TEST(test_policy, po_bounded)
+{
+    CheckOrder<WQBoundedPolicy<1024>>();
+}
+
+
+TEST(test_policy, po_layout)
+{
+    //Field groups on their own cache lines, consecutive pool workers never share one
+    EXPECT_EQ(alignof(PolicyQueue<WQDefaultPolicy>), size_t(WQ_CACHE_LINE));
+    EXPECT_EQ(sizeof(PolicyQueue<WQDefaultPolicy>) % WQ_CACHE_LINE, 0u);
+    EXPECT_EQ(alignof(WorkQueueStats), size_t(WQ_CACHE_LINE));
+    EXPECT_LT(sizeof(PolicyQueue<WQCompactPolicy>), sizeof(PolicyQueue<WQDefaultPolicy>));
+
+    CheckOrder<WQCompactPolicy>();
+    CheckOrder<WQAlignPolicy<WQLowLatencyPolicy, 128>>();
+}
+
+
+TEST(test_policy, po_features)
+{
+    //Features left out take no space: the queue drops their members, every queued item its fields
+    using Lean = WQFeaturePolicy<WQLowLatencyPolicy, WQ_FEATURE_NONE>;
+    EXPECT_LT(sizeof(PolicyQueue<Lean>), sizeof(PolicyQueue<WQLowLatencyPolicy>));
+    EXPECT_EQ(PolicyQueue<Lean>::ItemSize(), sizeof(int) + sizeof(uint64_t) * 2 + sizeof(void *) + 4);
+    EXPECT_LT(PolicyQueue<Lean>::ItemSize() * 2, PolicyQueue<WQLowLatencyPolicy>::ItemSize());
+
+    CheckOrder<Lean>();
+    CheckOrder<WQFeaturePolicy<WQBoundedPolicy<1024>, WQ_FEATURE_NONE>>();
+
+    //A feature kept works as before; no rate limit or retries, so InitExternal is allowed
+    PolicyQueue<WQFeaturePolicy<WQLowLatencyPolicy, WQ_FEATURE_CONFLATE>> que;
+    ASSERT_EQ(que.InitExternal(WQ_QUEUE_STATE::WORKING, "Features"), 0);
+    que.PushConflate(1, 10);
+    que.PushConflate(2, 20);
+    que.PushConflate(1, 11);
+    EXPECT_EQ(que.TryDrain(), 2u);
+    que.Release();
+    EXPECT_EQ(que._order, (std::vector<int>{11, 20}));
+}
+
+
+TEST(test_policy, po_boundedfull)
+{
+    class Blocked : public WorkQueue<int, Blocked, WQBoundedPolicy<4>>
+    {
+        public:
+            void Begin()            {}
+            void End()              {}
+            void Pop(int *pData)
+            {
+                _entered = true;
+                while (false == _go.load())
+                    usleep(100);
+                _sum += *pData;
+            }
+
+            std::atomic_bool    _entered {false};
+            std::atomic_bool    _go      {false};
+            std::atomic<int>    _sum     {0};
+    };
+
+    Blocked que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "BoundedFull");
+
+    //The Listener holds the first item, four more fill the ring and the sixth is rejected
+    que.PushBack(1);
+    while (false == que._entered.load())
+        usleep(100);
+
+    for (int i = 0; i < 4; ++i)
+        EXPECT_EQ(que.PushBack(10), size_t(i + 1));
+    EXPECT_EQ(que.PushBack(10), 4u);
+    EXPECT_EQ(que.Stats()._dropped.load(), 1u);
+
+    //PushFresh still replaces the content
+    EXPECT_EQ(que.PushFresh(100), 1u);
+    EXPECT_EQ(que.Stats()._dropped.load(), 5u);
+
+    que._go = true;
+    que.Release();
+    EXPECT_EQ(que._sum, 101);
+    EXPECT_EQ(que.Stats()._pushed.load(), 6u);
+}
+
+
+TEST(test_policy, po_pushalloc)
+{
+    class Blocked : public WorkQueue<int, Blocked, WQDefaultPolicy>
+    {
+        public:
+            void Begin()            {}
+            void End()              {}
+            void Pop(int *pData)
+            {
+                _entered = true;
+                while (false == _go.load())
+                    usleep(100);
+                _sum += *pData;
+            }
+
+            std::atomic_bool    _entered {false};
+            std::atomic_bool    _go      {false};
+            std::atomic<int>    _sum     {0};
+    };
+
+    Blocked que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "PushAlloc");
+    que.PushBack(1);
+    while (false == que._entered.load())
+        usleep(100);
+
+    //Back, front and conflated pushes allocate only the deque blocks their items go to (one per
+    //blockItems items), the conflate index nodes of the 8 keys and a few map reallocations
+    const size_t pushes     = 3000;
+    const size_t blockItems = std::max<size_t>(1, 512 / Blocked::ItemSize());
+    size_t allocs = s_allocs;
+    for (size_t i = 0; i < pushes / 3; ++i)
+    {
+        que.PushBack(1);
+        que.PushFront(1);
+        que.PushConflate(i % 8, 1);
+    }
+    allocs = s_allocs - allocs;
+    EXPECT_LE(allocs, (pushes - pushes / 3) / blockItems + 32) << "ItemSize " << Blocked::ItemSize();
+
+    //PushFresh still hands the old content back for dropping, with the superseded values that makes all of them
+    EXPECT_EQ(que.PushFresh(100), 1u);
+    EXPECT_EQ(que.Stats()._dropped.load(), pushes);
+
+    que._go = true;
+    que.Release();
+    EXPECT_EQ(que._sum, 101);
+}
+
+
+TEST(test_policy, po_task)
+{
+    TaskQueue<64, WQLowLatencyPolicy> que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "TaskLowLatency");
+
+    std::atomic<int> count {0};
+    for (int i = 0; i < 100; ++i)
+        que.Post([&count]() { ++count; });
+    que.Release();
+
+    EXPECT_EQ(count, 100);
+}
+
+
+// clang-format on
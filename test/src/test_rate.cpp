@@ -0,0 +1,139 @@
+// clang-format off
+
+
+#include <WorkQueue.h>
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <unistd.h>
+
+
+
+TEST(test_rate, rt_bucket)
+{
+    const uint64_t t0 = SEC_TO_NS(100);
+    WQTokenBucket bucket(1000.0, 5.0);
+
+    //The burst is free, then one token per millisecond
+    for (int i = 0; i < 5; ++i)
+        EXPECT_EQ(bucket.Reserve(1, t0), 0u);
+    EXPECT_EQ(bucket.Reserve(1, t0), MS_TO_NS(1));
+    EXPECT_EQ(bucket.Reserve(2, t0), MS_TO_NS(3));
+
+    //Idle time refills up to the burst only
+    EXPECT_EQ(bucket.Reserve(5, t0 + MS_TO_NS(100)), 0u);
+    EXPECT_EQ(bucket.Reserve(1, t0 + MS_TO_NS(100)), MS_TO_NS(1));
+
+    //Acquire takes what is there and never runs ahead
+    uint64_t waitNs = 0;
+    const uint64_t t1 = t0 + SEC_TO_NS(1);
+    EXPECT_EQ(bucket.Acquire(8, t1, waitNs), 5u);
+    EXPECT_EQ(bucket.Acquire(8, t1, waitNs), 0u);
+    EXPECT_EQ(waitNs, MS_TO_NS(1));
+    EXPECT_EQ(bucket.Acquire(8, t1 + MS_TO_NS(2), waitNs), 2u);
+    EXPECT_EQ(waitNs, 0u);
+}
+
+
+class RateQueue : public WorkQueue<int, RateQueue>
+{
+    public:
+        void Begin()            {}
+        void End()              {}
+        void Pop(int *pData)    { _count += *pData; }
+
+        std::atomic<int>    _count {0};
+};
+
+
+TEST(test_rate, rt_item)
+{
+    RateQueue que;
+    ASSERT_EQ(que.SetRateLimit(2000.0), 0);
+    que.Init(WQ_QUEUE_STATE::WORKING, "RateQueue");
+    EXPECT_EQ(que.SetRateLimit(1.0), -1);
+
+    uint64_t start = WQNowNs();
+    for (int i = 0; i < 100; ++i)
+        que.PushBack(1);
+    que.Flush();
+    uint64_t elapsed = WQNowNs() - start;
+    que.Release();
+
+    EXPECT_EQ(que._count, 100);
+    EXPECT_GE(elapsed, MS_TO_NS(45));
+    EXPECT_GT(que.Stats()._throttledNs.load(), MS_TO_NS(20));
+}
+
+
+TEST(test_rate, rt_backlog)
+{
+    //Items wait for their tokens in the queue, where PushFresh and Size see them
+    RateQueue que;
+    ASSERT_EQ(que.SetRateLimit(10.0), 0);
+    que.Init(WQ_QUEUE_STATE::WORKING, "RateBacklog");
+
+    for (int i = 0; i < 50; ++i)
+        que.PushBack(1);
+    usleep(20'000);
+    EXPECT_GE(que.Size(), 48u);
+
+    que.PushFresh(100);
+    EXPECT_LE(que.Size(), 1u);
+    que.Release();
+
+    //The burst token popped one item, the fresh one waited for the next token
+    EXPECT_EQ(que.Stats()._dropped.load(), 49u);
+    EXPECT_EQ(que._count, 101);
+}
+
+
+TEST(test_rate, rt_batch)
+{
+    //One token per drained batch: far fewer waits than items
+    RateQueue que;
+    ASSERT_EQ(que.SetRateLimit(20.0, 1.0, WQ_RATE_UNIT::BATCH), 0);
+    que.Init(WQ_QUEUE_STATE::WORKING, "RateBatch");
+
+    uint64_t start = WQNowNs();
+    for (int i = 0; i < 50; ++i)
+        que.PushBack(1);
+    que.Release();
+
+    EXPECT_EQ(que._count, 50);
+    EXPECT_LT(WQNowNs() - start, SEC_TO_NS(2));
+}
+
+
+TEST(test_rate, rt_pool)
+{
+    class RatePool : public WorkQueuePool<int, RatePool>
+    {
+        public:
+            RatePool(size_t queCount) : WorkQueuePool<int, RatePool>(queCount) {}
+
+            void Begin()            {}
+            void End()              {}
+            void Pop(int *pData)    { _count += *pData; }
+
+            std::atomic<int>    _count {0};
+    };
+
+    //The shared bucket caps the pool as a whole, not each worker
+    RatePool pool(3);
+    ASSERT_EQ(pool.SetRateLimit(2000.0), 0);
+    pool.Init(WQ_QUEUE_STATE::WORKING, "RatePool");
+
+    uint64_t start = WQNowNs();
+    for (int i = 0; i < 90; ++i)
+        pool.PushBack(1);
+    pool.Flush();
+    uint64_t elapsed = WQNowNs() - start;
+    pool.Release();
+
+    EXPECT_EQ(pool._count, 90);
+    EXPECT_GE(elapsed, MS_TO_NS(40));
+}
+
+
+// clang-format on
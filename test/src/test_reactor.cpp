@@ -0,0 +1,205 @@
+// clang-format off
+
+
+#include <WorkQueue.h>
+#include <WorkQueueReactor.h>
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <poll.h>
+#include <unistd.h>
+
+
+
+static bool Readable(int fd)
+{
+    pollfd pfd {fd, POLLIN, 0};
+    return 1 == poll(&pfd, 1, 0);
+}
+
+
+class EventQueue : public WorkQueue<int, EventQueue, WQEventFdPolicy>
+{
+    public:
+        void Begin()                { ++_begin; }
+        void End()                  { ++_end;   }
+        void Pop(int *pData)
+        {
+            _thread = std::this_thread::get_id();
+            _sum += *pData;
+        }
+
+        std::atomic<int>    _sum    {0};
+        int                 _begin  = 0;
+        int                 _end    = 0;
+        std::thread::id     _thread;
+};
+
+
+TEST(test_reactor, re_eventfd)
+{
+    EventQueue que;
+    ASSERT_EQ(que.InitExternal(WQ_QUEUE_STATE::WORKING, "EventFd"), 0);
+    EXPECT_EQ(que._begin, 1);
+
+    //Readable while items are pending (state changes wake it too), TryDrain never blocks
+    int fd = que.EventFd();
+    EXPECT_EQ(que.TryDrain(), 0u);
+    EXPECT_FALSE(Readable(fd));
+
+    que.PushBack(1);
+    que.PushBack(2);
+    que.PushBack(3);
+    EXPECT_TRUE(Readable(fd));
+    EXPECT_EQ(que.TryDrain(2), 2u);
+    EXPECT_TRUE(Readable(fd));
+    EXPECT_EQ(que.TryDrain(2), 1u);
+    EXPECT_FALSE(Readable(fd));
+    EXPECT_EQ(que._sum, 6);
+    EXPECT_EQ(que._thread, std::this_thread::get_id());
+
+    //Release drains the rest on the calling thread
+    que.PushBack(10);
+    que.Release();
+    EXPECT_EQ(que._sum, 16);
+    EXPECT_EQ(que._end, 1);
+    EXPECT_EQ(que.Stats()._popped.load(), 4u);
+}
+
+
+TEST(test_reactor, re_pause)
+{
+    EventQueue que;
+    ASSERT_EQ(que.InitExternal(WQ_QUEUE_STATE::WORKING, "EventFdPause"), 0);
+    int fd = que.EventFd();
+    que.PushBack(1);
+    que.PushBack(2);
+
+    //A paused queue drains nothing, its fd must not stay readable for an event loop to spin on
+    que.SetState(WQ_QUEUE_STATE::PAUSE);
+    EXPECT_EQ(que.TryDrain(), 0u);
+    EXPECT_FALSE(Readable(fd));
+
+    //Back to work, the items still pending make it readable again
+    que.SetState(WQ_QUEUE_STATE::WORKING);
+    EXPECT_TRUE(Readable(fd));
+    EXPECT_EQ(que.TryDrain(), 2u);
+    EXPECT_FALSE(Readable(fd));
+    EXPECT_EQ(que._sum, 3);
+    que.Release();
+}
+
+
+TEST(test_reactor, re_resetrace)
+{
+    EventQueue que;
+    ASSERT_EQ(que.InitExternal(WQ_QUEUE_STATE::WORKING, "EventFdRace"), 0);
+    int fd = que.EventFd();
+
+    //State changes and pushes race the resets of TryDrain, the flag and the fd must not drift apart:
+    //once the queue is drained the fd stays quiet, without a later Notify() to heal it
+    size_t drained  = 0;
+    int    readable = 0;
+    for (int round = 0; round < 500; ++round)
+    {
+        std::atomic_bool done {false};
+        std::thread th([&]()
+        {
+            for (int i = 0; i < 40; ++i)
+            {
+                que.SetState(0 == i % 2 ? WQ_QUEUE_STATE::PAUSE : WQ_QUEUE_STATE::WORKING);
+                if (1 == i % 4)
+                    que.PushBack(1);
+            }
+            done = true;
+        });
+
+        while (false == done.load())
+            drained += que.TryDrain();
+        th.join();
+        drained += que.TryDrain();
+        readable += Readable(fd) ? 1 : 0;
+    }
+
+    EXPECT_EQ(drained, 5000u);
+    EXPECT_EQ(que.Size(), 0u);
+    EXPECT_EQ(readable, 0);
+    que.Release();
+}
+
+
+TEST(test_reactor, re_features)
+{
+    //Waiting for tokens or backoffs would stall the event loop thread: InitExternal static_asserts
+    //a policy without them, SetRateLimit and SetRetryPolicy do not compile on this one
+    static_assert(0 == (WQEventFdPolicy::Features & (WQ_FEATURE_RATE | WQ_FEATURE_RETRY)), "no rate limit or retry lane");
+    static_assert(0 != (WQEventFdPolicy::Features & WQ_FEATURE_CALL), "callbacks still run on the loop");
+
+    EventQueue que;
+    ASSERT_EQ(que.InitExternal(WQ_QUEUE_STATE::WORKING, "EventFdFeatures"), 0);
+    int calls = 0;
+    EXPECT_EQ(que.PushCall([](void *ctx, bool cancelled) { *static_cast<int *>(ctx) += cancelled ? 100 : 1; }, &calls), 0);
+    EXPECT_EQ(que.TryDrain(), 1u);
+    EXPECT_EQ(calls, 1);
+    que.Release();
+}
+
+
+TEST(test_reactor, re_listener)
+{
+    //The threaded Listener sleeps on the eventfd like on any other wake policy
+    EventQueue que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "EventFdListener");
+    for (int i = 1; i <= 1000; ++i)
+        que.PushBack(i);
+    que.Release();
+    EXPECT_EQ(que._sum, 500500);
+}
+
+
+TEST(test_reactor, re_reactor)
+{
+    EventQueue que;
+    ASSERT_EQ(que.InitExternal(WQ_QUEUE_STATE::WORKING, "Reactor"), 0);
+
+    WQReactor reactor;
+    ASSERT_EQ(reactor.Init("reactor"), 0);
+    ASSERT_EQ(reactor.Attach(que, 16), 0);
+    EXPECT_EQ(reactor.Attach(que), -1);
+
+    int pipeFd[2];
+    ASSERT_EQ(pipe(pipeFd), 0);
+    std::atomic<int>        bytes {0};
+    std::thread::id         ioThread;
+    ASSERT_EQ(reactor.Add(pipeFd[0], EPOLLIN, [&](uint32_t events)
+    {
+        char buf[16];
+        ssize_t len = read(pipeFd[0], buf, sizeof(buf));
+        ioThread = std::this_thread::get_id();
+        if (len > 0 && (events & EPOLLIN))
+            bytes += int(len);
+    }), 0);
+
+    //Queued work and descriptor I/O share the reactor thread
+    for (int i = 1; i <= 100; ++i)
+        que.PushBack(i);
+    ASSERT_EQ(write(pipeFd[1], "abc", 3), 3);
+
+    uint64_t deadline = WQNowNs() + SEC_TO_NS(5);
+    while ((que._sum != 5050 || bytes != 3) && WQNowNs() < deadline)
+        usleep(1000);
+    EXPECT_EQ(que._sum, 5050);
+    EXPECT_EQ(bytes, 3);
+
+    reactor.Release();
+    EXPECT_EQ(ioThread, que._thread);
+    EXPECT_NE(ioThread, std::this_thread::get_id());
+
+    que.Release();
+    close(pipeFd[0]);
+    close(pipeFd[1]);
+}
+
+
+// clang-format on
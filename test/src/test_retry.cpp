@@ -0,0 +1,179 @@
+// clang-format off
+
+
+#include <WorkQueue.h>
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+
+
+TEST(test_retry, rt_backoff)
+{
+    WQRetryPolicy policy;
+    policy._backoffNs    = MS_TO_NS(1);
+    policy._maxBackoffNs = MS_TO_NS(5);
+
+    EXPECT_EQ(policy.BackoffNs(1), uint64_t(MS_TO_NS(1)));
+    EXPECT_EQ(policy.BackoffNs(2), uint64_t(MS_TO_NS(2)));
+    EXPECT_EQ(policy.BackoffNs(3), uint64_t(MS_TO_NS(4)));
+    EXPECT_EQ(policy.BackoffNs(4), uint64_t(MS_TO_NS(5)));
+    EXPECT_EQ(policy.BackoffNs(60), uint64_t(MS_TO_NS(5)));
+}
+
+
+class FlakyQueue : public WorkQueue<int, FlakyQueue>
+{
+    public:
+        void Begin()                {}
+        void End()                  {}
+
+        //Item i fails its first i calls, a failure returns the item value
+        int  Pop(int *pData)
+        {
+            std::lock_guard<std::mutex> lck{_lock};
+            _order.push_back(*pData);
+            if (_calls[*pData]++ < *pData)
+                return *pData;
+            ++_done;
+            return 0;
+        }
+
+        void OnDeadLetter(int *pData, int rc, uint32_t attempts)
+        {
+            std::lock_guard<std::mutex> lck{_lock};
+            _dead.push_back(*pData);
+            EXPECT_EQ(rc, *pData);
+            EXPECT_EQ(attempts, 3u);
+        }
+
+        std::mutex          _lock;
+        std::map<int, int>  _calls;
+        std::vector<int>    _order;
+        std::vector<int>    _dead;
+        std::atomic<int>    _done {0};
+};
+
+
+TEST(test_retry, rt_lane)
+{
+    WQRetryPolicy policy;
+    policy._maxAttempts = 3;
+    policy._backoffNs   = MS_TO_NS(20);
+
+    FlakyQueue que;
+    ASSERT_EQ(que.SetRetryPolicy(policy), 0);
+    que.Init(WQ_QUEUE_STATE::WORKING, "FlakyQueue");
+    EXPECT_EQ(que.SetRetryPolicy(policy), -1);
+
+    //0 succeeds at once, 1 and 2 after retries, 5 is dead lettered after 3 calls
+    uint64_t start = WQNowNs();
+    que.PushBack(5);
+    que.PushBack(1);
+    que.PushBack(2);
+    que.PushBack(0);
+    EXPECT_EQ(que.WaitIdle(SEC_TO_NS(5)), 0);
+    uint64_t elapsed = WQNowNs() - start;
+    que.Release();
+
+    //The failing items did not hold up the one behind them
+    ASSERT_GE(que._order.size(), 4u);
+    EXPECT_EQ(que._order[3], 0);
+    EXPECT_EQ(que._calls[1], 2);
+    EXPECT_EQ(que._calls[2], 3);
+    EXPECT_EQ(que._calls[5], 3);
+    EXPECT_EQ(que._dead, std::vector<int>{5});
+    EXPECT_GE(elapsed, uint64_t(MS_TO_NS(60)));
+
+    const WorkQueueStats &stats = que.Stats();
+    EXPECT_EQ(stats._popped.load(), 3u);
+    EXPECT_EQ(stats._retried.load(), 5u);
+    EXPECT_EQ(stats._deadLettered.load(), 1u);
+    EXPECT_EQ(stats._retryNs.Snapshot()._count, 3u);
+}
+
+
+TEST(test_retry, rt_release)
+{
+    WQRetryPolicy policy;
+    policy._maxAttempts = 2;
+    policy._backoffNs   = SEC_TO_NS(60);
+
+    //A forced exit drops what waits in the retry lane, a drain waits for it
+    FlakyQueue que;
+    que.SetRetryPolicy(policy);
+    que.Init(WQ_QUEUE_STATE::WORKING, "FlakyRelease");
+    que.PushBack(1);
+    EXPECT_EQ(que.WaitIdle(MS_TO_NS(50)), -1);
+    EXPECT_EQ(que.Release(TimespecFromNs(uint64_t(MS_TO_NS(50)))), -1);
+
+    EXPECT_EQ(que._calls[1], 1);
+    EXPECT_EQ(que.Stats()._dropped.load(), 1u);
+    EXPECT_EQ(que.Completed(), 1u);
+}
+
+
+TEST(test_retry, rt_barrier)
+{
+    WQRetryPolicy policy;
+    policy._maxAttempts = 3;
+    policy._backoffNs   = MS_TO_NS(50);
+
+    FlakyQueue que;
+    que.SetRetryPolicy(policy);
+    que.Init(WQ_QUEUE_STATE::WORKING, "FlakyBarrier");
+
+    //1 waits in the retry lane while items pushed after the barrier complete
+    que.PushBack(1);
+    que.PushBack(0);
+    std::thread late([&que]() { usleep(5000); for (int i = 0; i < 4; ++i) que.PushBack(0); });
+    EXPECT_EQ(que.WaitIdle(SEC_TO_NS(5)), 0);
+    {
+        std::lock_guard<std::mutex> lck{que._lock};
+        EXPECT_EQ(que._calls[1], 2);
+    }
+    late.join();
+    que.Release();
+    EXPECT_EQ(que._done, 6);
+}
+
+
+TEST(test_retry, rt_pool)
+{
+    class FlakyPool : public WorkQueuePool<int, FlakyPool>
+    {
+        public:
+            FlakyPool(size_t queCount) : WorkQueuePool<int, FlakyPool>(queCount) {}
+
+            void Begin()            {}
+            void End()              {}
+            int  Pop(int *pData)    { ++_calls; return *pData; }
+            void OnDeadLetter(int *, int, uint32_t)     { ++_dead; }
+
+            std::atomic<int>    _calls {0};
+            std::atomic<int>    _dead  {0};
+    };
+
+    WQRetryPolicy policy;
+    policy._maxAttempts = 2;
+    policy._backoffNs   = MS_TO_NS(1);
+
+    FlakyPool pool(2);
+    ASSERT_EQ(pool.SetRetryPolicy(policy), 0);
+    pool.Init(WQ_QUEUE_STATE::WORKING, "FlakyPool");
+    for (int i = 0; i < 10; ++i)
+        pool.PushBack(i % 2);
+    pool.Flush();
+    pool.Release();
+
+    EXPECT_EQ(pool._calls, 15);
+    EXPECT_EQ(pool._dead, 5);
+}
+
+
+// clang-format on
@@ -0,0 +1,231 @@
+// clang-format off
+
+
+#include <WorkQueueShm.h>
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+
+struct ShmItem
+{
+    uint32_t    _producer;
+    uint32_t    _seq;
+};
+
+
+class ShmSink : public ShmWorkQueue<ShmItem, ShmSink, 256>
+{
+    public:
+        void Begin()                {}
+        void End()                  {}
+        void Pop(ShmItem *pData)
+        {
+            if (pData->_seq != _next[pData->_producer])
+                ++_outOfOrder;
+            _next[pData->_producer] = pData->_seq + 1;
+            ++_count;
+        }
+
+        uint32_t            _next[4]    {};
+        uint32_t            _outOfOrder = 0;
+        std::atomic<int>    _count      {0};
+};
+
+
+using ShmSource = ShmWorkQueueProducer<ShmItem, 256>;
+
+
+static std::string ShmName(const char *tag)
+{
+    return "/wq_test_" + std::string(tag) + "_" + std::to_string(getpid());
+}
+
+
+static pid_t ForkProducer(const std::string &name, uint32_t producer, uint32_t count)
+{
+    pid_t pid = fork();
+    if (0 == pid)
+    {
+        ShmSource source;
+        if (0 != source.Attach(name))
+            _exit(2);
+        for (uint32_t seq = 0; seq < count; )
+        {
+            if (source.Push(ShmItem{producer, seq}))
+                ++seq;
+            else
+                usleep(10);
+        }
+        _exit(0);
+    }
+    return pid;
+}
+
+
+TEST(test_shm, shm_processes)
+{
+    std::string name = ShmName("proc");
+    ShmSink::Unlink(name);
+
+    ShmSink sink;
+    ASSERT_EQ(sink.Init(WQ_QUEUE_STATE::WORKING, name), 0);
+
+    //A second consumer is refused while the first one lives
+    ShmSink other;
+    EXPECT_EQ(other.Init(WQ_QUEUE_STATE::WORKING, name), -1);
+
+    std::vector<pid_t> children;
+    for (uint32_t producer = 0; producer < 3; ++producer)
+        children.push_back(ForkProducer(name, producer, 2000));
+    for (pid_t pid : children)
+    {
+        int status = -1;
+        waitpid(pid, &status, 0);
+        EXPECT_TRUE(WIFEXITED(status) && 0 == WEXITSTATUS(status));
+    }
+
+    sink.Release();
+    EXPECT_EQ(sink._count, 6000);
+    EXPECT_EQ(sink._outOfOrder, 0u);
+    EXPECT_EQ(sink.Stats()._popped.load(), 6000u);
+    ShmSink::Unlink(name);
+}
+
+
+TEST(test_shm, shm_states)
+{
+    std::string name = ShmName("state");
+    ShmSink::Unlink(name);
+
+    ShmSource source;
+    EXPECT_EQ(source.Attach(name), -1);
+
+    ShmSink sink;
+    ASSERT_EQ(sink.Init(WQ_QUEUE_STATE::PAUSE, name), 0);
+    ASSERT_EQ(source.Attach(name), 0);
+    EXPECT_TRUE(source.ConsumerAlive());
+
+    EXPECT_FALSE(source.Push(ShmItem{0, 0}));
+    sink.SetState(WQ_QUEUE_STATE::WORKING);
+    EXPECT_TRUE(source.Push(ShmItem{0, 0}));
+    sink.Release();
+
+    EXPECT_EQ(sink._count, 1);
+    EXPECT_FALSE(source.ConsumerAlive());
+    EXPECT_FALSE(source.Push(ShmItem{0, 1}));
+    ShmSink::Unlink(name);
+}
+
+
+TEST(test_shm, shm_deadproducer)
+{
+    std::string name = ShmName("dead");
+    ShmSink::Unlink(name);
+
+    ShmSink sink;
+    sink.SetStallTimeout(MS_TO_NS(5));
+    ASSERT_EQ(sink.Init(WQ_QUEUE_STATE::WORKING, name), 0);
+
+    //A producer process that claims a cell and dies before publishing it
+    pid_t pid = fork();
+    if (0 == pid)
+    {
+        ShmSource source;
+        if (0 != source.Attach(name))
+            _exit(2);
+        bool created;
+        auto *seg = static_cast<ShmSource::TSegment *>(WQShmMap(name, sizeof(ShmSource::TSegment), false, created));
+        uint64_t pos = seg->_head.load();
+        for (auto &producer : seg->_producers)
+            if (producer._pid.load() == int32_t(getpid()))
+                producer._inflight.store(pos + 1);
+        seg->_head.store(pos + 1);
+        _exit(0);
+    }
+    int status = -1;
+    waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status) && 0 == WEXITSTATUS(status));
+
+    //Items behind the dead cell still come through, the slot of the dead producer is reused
+    ShmSource source;
+    ASSERT_EQ(source.Attach(name), 0);
+    for (uint32_t seq = 0; seq < 10; ++seq)
+        EXPECT_TRUE(source.Push(ShmItem{1, seq}));
+    sink.Release();
+
+    EXPECT_EQ(sink._count, 10);
+    EXPECT_EQ(sink.Stats()._dropped.load(), 1u);
+    ShmSink::Unlink(name);
+}
+
+
+
+TEST(test_shm, shm_staleclaim)
+{
+    std::string name = ShmName("stale");
+    ShmSink::Unlink(name);
+
+    ShmSink sink;
+    sink.SetStallTimeout(MS_TO_NS(5));
+    ASSERT_EQ(sink.Init(WQ_QUEUE_STATE::WORKING, name), 0);
+
+    ShmSource source;
+    ASSERT_EQ(source.Attach(name), 0);
+    bool created;
+    auto *seg = static_cast<ShmSource::TSegment *>(WQShmMap(name, sizeof(ShmSource::TSegment), false, created));
+    uint64_t pos = seg->_head.load();
+
+    //A producer process that lost the CAS for pos and died before withdrawing its claim
+    pid_t pid = fork();
+    if (0 == pid)
+    {
+        ShmSource loser;
+        if (0 != loser.Attach(name))
+            _exit(2);
+        for (auto &producer : seg->_producers)
+            if (producer._pid.load() == int32_t(getpid()))
+                producer._inflight.store(pos + 1);
+        _exit(0);
+    }
+    int status = -1;
+    waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status) && 0 == WEXITSTATUS(status));
+
+    //The live winner of pos takes far longer than the stall timeout to publish
+    typename ShmSource::TSegment::Producer *winner = nullptr;
+    for (auto &producer : seg->_producers)
+        if (producer._pid.load() == int32_t(getpid()))
+            winner = &producer;
+    ASSERT_NE(winner, nullptr);
+    winner->_inflight.store(pos + 1);
+    seg->_head.store(pos + 1);
+    seg->_dataSeq.fetch_add(1);
+    FutexWake(seg->_dataSeq, 1, true);
+    usleep(30000);
+
+    auto &cell = seg->_cells[pos & ShmSource::TSegment::MASK];
+    cell._data = ShmItem{1, 0};
+    cell._seq.store(pos + 1);
+    winner->_inflight.store(0);
+
+    //Its cell was not skipped, the ring keeps going (a skipped one would leave it full for good)
+    int retries = 0;
+    for (uint32_t seq = 1; seq < 300 && retries < 100000; ++seq)
+        while (false == source.Push(ShmItem{1, seq}) && ++retries < 100000)
+            usleep(10);
+    sink.Release();
+
+    EXPECT_EQ(sink._count, 300);
+    EXPECT_EQ(sink._outOfOrder, 0u);
+    EXPECT_EQ(sink.Stats()._dropped.load(), 0u);
+    WQShmUnmap(seg, sizeof(ShmSource::TSegment));
+    ShmSink::Unlink(name);
+}
+
+// clang-format on
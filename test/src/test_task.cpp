@@ -0,0 +1,122 @@
+// clang-format off
+
+
+#include <WorkQueueTask.h>
+
+#include <gtest/gtest.h>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+
+
+TEST(test_task, tk_inline)
+{
+    int hit = 0;
+    auto small = [&hit]() { ++hit; };
+    auto large = [&hit, pad = std::array<char, 128>{}]() { hit += 1 + pad[0]; };
+
+    static_assert(WQTask<64>::FitsInline<decltype(small)>(),  "small capture must be inline");
+    static_assert(!WQTask<64>::FitsInline<decltype(large)>(), "large capture must fall back");
+
+    WQTask<64> a(small);
+    WQTask<64> b(large);
+    EXPECT_TRUE(a.IsInline());
+    EXPECT_FALSE(b.IsInline());
+
+    WQTask<64> c(std::move(b));
+    EXPECT_FALSE(b);
+    c();
+    a();
+    EXPECT_EQ(hit, 2);
+
+    WQTask<64> empty;
+    empty();
+    EXPECT_FALSE(empty);
+}
+
+
+TEST(test_task, tk_queue)
+{
+    TaskQueue<> que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "TaskQueue");
+
+    std::atomic<int> sum {0};
+    auto owned = std::make_unique<int>(5);
+    que.Post([&sum, owned = std::move(owned)]() { sum += *owned; });            // move-only capture
+    que.Post([&sum]() { sum += 1; });
+    que.Post([&sum, pad = std::array<int, 64>{{100}}]() { sum += pad[0]; });    // heap fallback
+    que.Release();
+
+    EXPECT_EQ(sum, 106);
+    EXPECT_EQ(que.HeapFallbacks(), 1u);
+}
+
+
+TEST(test_task, tk_pool)
+{
+    TaskPool<32> pool(3);
+    pool.Init(WQ_QUEUE_STATE::WORKING, "TaskPool");
+
+    std::atomic<int> count {0};
+    for (int i = 0; i < 300; ++i)
+        EXPECT_GE(pool.Post([&count]() { ++count; }), 0);
+    pool.Release();
+
+    EXPECT_EQ(count, 300);
+    EXPECT_EQ(pool.HeapFallbacks(), 0u);
+}
+
+
+TEST(test_task, tk_bounded)
+{
+    BoundedTaskQueue<64, 4> que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "BoundedTaskQueue");
+
+    //Hold the worker in a task while the ring fills up
+    std::atomic<bool> running {false};
+    std::atomic<bool> go      {false};
+    que.Post([&running, &go]() { running = true; while (false == go) std::this_thread::yield(); });
+    while (false == running)
+        std::this_thread::yield();
+
+    //Rejected posts are dropped, neither run nor counted as heap fallbacks
+    std::atomic<int> sum {0};
+    for (int i = 0; i < 6; ++i)
+        que.Post([&sum, pad = std::array<int, 64>{{1}}]() { sum += pad[0]; });
+    EXPECT_EQ(que.Size(), 4u);
+    EXPECT_EQ(que.Stats()._dropped.load(), 2u);
+
+    go = true;
+    que.Release();
+    EXPECT_EQ(sum, 4);
+    EXPECT_EQ(que.HeapFallbacks(), 4u);
+}
+
+
+TEST(test_task, tk_unbounded)
+{
+    UnboundedTaskQueue<> que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "UnboundedTaskQueue");
+
+    std::atomic<bool> running {false};
+    std::atomic<bool> go      {false};
+    que.Post([&running, &go]() { running = true; while (false == go) std::this_thread::yield(); });
+    while (false == running)
+        std::this_thread::yield();
+
+    //More than the 4096 slots of the default ring, none is dropped
+    std::atomic<int> count {0};
+    for (int i = 0; i < 5000; ++i)
+        que.Post([&count]() { ++count; });
+    EXPECT_EQ(que.Size(), 5000u);
+    EXPECT_EQ(que.Stats()._dropped.load(), 0u);
+
+    go = true;
+    que.Release();
+    EXPECT_EQ(count, 5000);
+}
+
+
+// clang-format on
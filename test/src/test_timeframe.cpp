@@ -0,0 +1,75 @@
+
+// clang-format off
+
+
+#include <TimeFrame.h>
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+
+
+template <typename TFrame>
+static void CheckFrame()
+{
+    TFrame tf;
+    usleep(2000);
+    tf.Stop();
+
+    EXPECT_GE(tf.ElapsNs(), MS_TO_NS(2));
+    EXPECT_LE(tf.ElapsNs(), MS_TO_NS(50));
+    EXPECT_EQ(TimespecToNs(tf.Elaps()), tf.ElapsNs());
+
+    timespec rt;
+    clock_gettime(CLOCK_REALTIME, &rt);
+    int64_t age = TimespecToNs(rt) - TimespecToNs(tf.TimeStamp());
+    EXPECT_GE(age, MS_TO_NS(1));
+    EXPECT_LE(age, MS_TO_NS(50));
+}
+
+
+TEST(test_timeframe, tf_monotonic)
+{
+    CheckFrame<TimeFrame>();
+}
+
+
+TEST(test_timeframe, tf_tsc)
+{
+    CheckFrame<TimeFrameTsc>();
+
+    const ClockTsc::Calibration &cal = ClockTsc::Calibrate();
+    EXPECT_EQ(cal._tsc, ClockTsc::Available());
+    EXPECT_GT(cal._nsPerTick, 0.0);
+}
+
+
+TEST(test_timeframe, tf_step)
+{
+    TimeFrameTsc tf;
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    tf.Step(ts);
+    ts.tv_sec += 1;
+    tf.Step(ts);
+
+    EXPECT_NEAR(double(tf.ElapsNs()), double(SEC_TO_NS(1)), double(US_TO_NS(10)));
+}
+
+
+TEST(test_timeframe, tf_tsc_past)
+{
+    //Times before the calibration map at or below the base tick, 0 at the latest
+    const ClockTsc::Calibration &cal = ClockTsc::Calibrate();
+    uint64_t now = ClockMonotonic::Now();
+
+    EXPECT_LE(ClockTsc::FromMonotonic(now - MS_TO_NS(1)), ClockTsc::FromMonotonic(now));
+    if (cal._tsc)
+    {
+        EXPECT_LE(ClockTsc::FromMonotonic(cal._monoBase / 2), cal._tickBase);
+        EXPECT_LE(ClockTsc::FromMonotonic(0), cal._tickBase);
+    }
+}
+
+
+// clang-format on
@@ -0,0 +1,108 @@
+
+// clang-format off
+
+
+#include <WorkQueue.h>
+
+#include <gtest/gtest.h>
+
+
+
+class TraceQue : public WorkQueue<int, TraceQue>
+{
+    public:
+        void Begin()        {}
+        void End()          {}
+        int  Pop(int *)     { return 0; }
+};
+
+
+static size_t CountOf(const std::string &text, const std::string &what)
+{
+    size_t count = 0;
+    for (size_t pos = text.find(what); pos != std::string::npos; pos = text.find(what, pos + 1))
+        ++count;
+    return count;
+}
+
+
+TEST(test_trace, tr_chrome)
+{
+    WQTrace::Enable(2);
+    WQTrace::Clear();
+
+    TraceQue que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "TraceQue");
+    for (int i = 0; i < 10; ++i)
+        que.PushBack(i);
+    que.Release();
+
+    WQTrace::Disable();
+    que.PushBack(0);    // not traced, queue released and tracing disabled
+
+    std::string json = WQTrace::DumpChrome();
+    WQTrace::Clear();
+
+    EXPECT_EQ(json.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0), 0);
+    EXPECT_EQ(CountOf(json, "\"name\":\"push\""),   5);
+    EXPECT_EQ(CountOf(json, "\"name\":\"pop\""),    5);
+    EXPECT_EQ(CountOf(json, "\"ph\":\"s\""),        5);
+    EXPECT_EQ(CountOf(json, "\"ph\":\"f\""),        5);
+    EXPECT_GE(CountOf(json, "\"name\":\"drain\""),  1);
+    EXPECT_GE(CountOf(json, "\"queue\":\"TraceQue\""), 10);
+
+    EXPECT_EQ(CountOf(WQTrace::DumpChrome(), "\"name\":\"push\""), 0);
+}
+
+
+TEST(test_trace, tr_escape)
+{
+    EXPECT_EQ(WQEscapeJson("a\"b\\c\n\r\t\x01"), "a\\\"b\\\\c\\n\\r\\t\\u0001");
+
+    //Queue names are user supplied, a control character must not break the trace file
+    WQTrace::Enable();
+    WQTrace::Clear();
+
+    TraceQue que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "Trace\tQue\x1f");
+    que.PushBack(1);
+    que.Release();
+
+    WQTrace::Disable();
+    std::string json = WQTrace::DumpChrome();
+    WQTrace::Clear();
+
+    EXPECT_GE(CountOf(json, "\"queue\":\"Trace\\tQue\\u001f\""), 2);
+    EXPECT_EQ(CountOf(json, "\t"), 0);
+}
+
+
+TEST(test_trace, tr_thread_churn)
+{
+    WQTrace::Enable();
+    WQTrace::Clear();
+
+    TraceQue que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "ChurnQue");
+
+    //Warm up until the worker has its ring and a freed one waits for the next producer
+    std::thread([&que]() { que.PushBack(0); }).join();
+    que.Flush();
+    std::thread([&que]() { que.PushBack(1); }).join();
+    que.Flush();
+
+    //Short lived producers one after the other: their rings are recycled
+    size_t rings = WQTrace::RingCount();
+    for (int i = 2; i <= 16; ++i)
+        std::thread([&que, i]() { que.PushBack(i); }).join();
+    que.Release();
+    WQTrace::Disable();
+
+    EXPECT_EQ(WQTrace::RingCount(), rings);
+    std::string json = WQTrace::DumpChrome();
+    WQTrace::Clear();
+    EXPECT_EQ(CountOf(json, "\"name\":\"push\""), 17);     // events of exited threads stay until overwritten
+}
+
+
+// clang-format on
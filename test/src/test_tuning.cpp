@@ -0,0 +1,117 @@
+// clang-format off
+
+
+#include <WorkQueue.h>
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <unistd.h>
+
+
+
+TEST(test_tuning, tu_controller)
+{
+    WQBatchTuning cfg;
+    cfg._sloNs       = MS_TO_NS(1);
+    cfg._minBatch    = 4;
+    cfg._maxBatch    = 64;
+    cfg._maxLingerNs = US_TO_NS(100);
+
+    WQBatchTuner tuner;
+    tuner.Configure(cfg);
+    EXPECT_EQ(tuner.Batch(), 64u);
+    EXPECT_EQ(tuner.LingerNs(), 0u);
+
+    //Over the SLO halves the cap, never below the minimum
+    for (int i = 0; i < 10; ++i)
+        tuner.Update(64, MS_TO_NS(2));
+    EXPECT_EQ(tuner.Batch(), 4u);
+
+    //Full batches within the SLO grow it back, up to the maximum
+    for (int i = 0; i < 100; ++i)
+        tuner.Update(tuner.Batch(), US_TO_NS(100));
+    EXPECT_EQ(tuner.Batch(), 64u);
+
+    //Underfilled batches with headroom linger longer, up to the cap
+    for (int i = 0; i < 20; ++i)
+        tuner.Update(2, US_TO_NS(50));
+    EXPECT_EQ(tuner.LingerNs(), uint64_t(US_TO_NS(100)));
+    tuner.Update(2, MS_TO_NS(2));
+    EXPECT_EQ(tuner.LingerNs(), uint64_t(US_TO_NS(50)));
+
+    EXPECT_EQ(tuner.Wakeups(), 131u);
+}
+
+
+class TunedQueue : public WorkQueue<int, TunedQueue>
+{
+    public:
+        void Begin()            {}
+        void End()              {}
+        void Pop(int *pData)
+        {
+            if (_workUs > 0)
+                usleep(_workUs);
+            _sum += *pData;
+        }
+
+        int                 _workUs = 0;
+        std::atomic<int>    _sum    {0};
+};
+
+
+TEST(test_tuning, tu_linger)
+{
+    //A trickle of items: the Listener learns to linger and takes several per wake-up
+    WQBatchTuning cfg;
+    cfg._sloNs       = MS_TO_NS(20);
+    cfg._maxLingerNs = MS_TO_NS(2);
+
+    TunedQueue que;
+    ASSERT_EQ(que.SetBatchTuning(cfg), 0);
+    que.Init(WQ_QUEUE_STATE::WORKING, "Linger");
+    EXPECT_EQ(que.SetBatchTuning(cfg), -1);
+
+    for (int i = 0; i < 400; ++i)
+    {
+        que.PushBack(1);
+        usleep(200);
+    }
+    que.Flush();
+
+    const WQBatchTuner &tuner = que.BatchTuner();
+    EXPECT_GT(tuner.LingerNs(), 0u);
+    EXPECT_GT(tuner.Items(), tuner.Wakeups() * 2);
+    que.Release();
+    EXPECT_EQ(que._sum, 400);
+}
+
+
+TEST(test_tuning, tu_cap)
+{
+    //Bursts of slow items: the cap shrinks so each batch stays near the SLO
+    WQBatchTuning cfg;
+    cfg._sloNs    = MS_TO_NS(5);
+    cfg._maxBatch = 256;
+
+    TunedQueue que;
+    que._workUs = 500;
+    ASSERT_EQ(que.SetBatchTuning(cfg), 0);
+    que.Init(WQ_QUEUE_STATE::WORKING, "Cap");
+
+    for (int burst = 0; burst < 5; ++burst)
+    {
+        for (int i = 0; i < 100; ++i)
+            que.PushBack(1);
+        que.Flush();
+    }
+    que.Release();
+
+    //500us per item against a 5ms SLO: the cap settles around ten items
+    EXPECT_LE(que.BatchTuner().Batch(), 16u);
+    EXPECT_GE(que.BatchTuner().Wakeups(), 8u);
+    EXPECT_EQ(que._sum, 500);
+}
+
+
+// clang-format on
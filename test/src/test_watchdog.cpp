@@ -0,0 +1,187 @@
+// clang-format off
+
+
+#include <WorkQueue.h>
+#include <WorkQueueWatchdog.h>
+
+#include "TestUtil.h"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+
+
+class HangPool : public WorkQueuePool<int, HangPool>
+{
+    public:
+        HangPool(size_t queCount) : WorkQueuePool<int, HangPool>(queCount) {}
+
+        void Begin()                {}
+        void End()                  {}
+
+        //Item -1 hangs until released
+        void Pop(int *pData)
+        {
+            if (*pData < 0)
+            {
+                _hung = true;
+                while (false == _release.load())
+                    usleep(100);
+                return;
+            }
+            if (_slow.load())
+                usleep(200);
+            _sum += *pData;
+        }
+
+        std::atomic_bool    _hung    {false};
+        std::atomic_bool    _release {false};
+        std::atomic_bool    _slow    {false};
+        std::atomic<int>    _sum     {0};
+};
+
+
+struct EventLog
+{
+    void    Add(const WQWatchdogEvent &ev)
+    {
+        std::lock_guard<std::mutex> lck{_lock};
+        _events.push_back(ev);
+    }
+
+    size_t  Count(WQ_WATCHDOG_EVENT event, size_t worker)
+    {
+        std::lock_guard<std::mutex> lck{_lock};
+        size_t count = 0;
+        for (auto &ev : _events)
+            count += (ev._event == event && ev._worker == worker) ? 1 : 0;
+        return count;
+    }
+
+    std::mutex                      _lock;
+    std::vector<WQWatchdogEvent>    _events;
+};
+
+
+TEST(test_watchdog, wd_popstate)
+{
+    HangPool pool(1);
+    pool.Init(WQ_QUEUE_STATE::WORKING, "PopState");
+    EXPECT_EQ(pool.QuePopRunningNs(0), 0u);
+
+    pool.PushBack(-1);
+    ASSERT_TRUE(WaitFor([&]() { return pool._hung.load(); }));
+    usleep(5000);
+    EXPECT_GE(pool.QuePopRunningNs(0), uint64_t(MS_TO_NS(4)));
+
+    pool._release = true;
+    pool.Flush();
+    EXPECT_EQ(pool.QuePopRunningNs(0), 0u);
+    pool.Release();
+}
+
+
+TEST(test_watchdog, wd_stall)
+{
+    HangPool pool(3);
+    pool.Init(WQ_QUEUE_STATE::WORKING, "Stall");
+
+    EventLog log;
+    WQWatchdogConfig cfg;
+    cfg._popBudgetNs = MS_TO_NS(20);
+    cfg._rehome      = true;
+    WQWatchdog<HangPool> watchdog(pool, cfg, [&log](const WQWatchdogEvent &ev) { log.Add(ev); });
+    watchdog.Init(MS_TO_NS(5));
+
+    //Worker 0 hangs, whatever queued behind it is moved to workers 1 and 2
+    EXPECT_EQ(pool.PushBack(-1), 0);
+    ASSERT_TRUE(WaitFor([&]() { return pool._hung.load(); }));
+    for (int i = 0; i < 100; ++i)
+        pool.PushBack(1);
+
+    ASSERT_TRUE(WaitFor([&]() { return 1 == log.Count(WQ_WATCHDOG_EVENT::STALL, 0); }));
+    EXPECT_TRUE(watchdog.Stalled(0));
+    EXPECT_FALSE(watchdog.Stalled(1));
+    EXPECT_TRUE(WaitFor([&]() { return 100 == pool._sum.load(); }));
+    EXPECT_EQ(pool.QueSize(0), 0u);
+    EXPECT_EQ(pool.QueStats(0)._rehomed.load(), watchdog.Rehomed());
+
+    //The parked worker gets no new pushes, nothing is left for the next tick to move
+    EXPECT_TRUE(pool.QueParked(0));
+    uint64_t pushed = pool.QueStats(0)._pushed.load();
+    for (int i = 0; i < 50; ++i)
+        pool.PushBack(1);
+    EXPECT_EQ(pool.QueStats(0)._pushed.load(), pushed);
+
+    pool._release = true;
+    EXPECT_TRUE(WaitFor([&]() { return 1 == log.Count(WQ_WATCHDOG_EVENT::RECOVERED, 0); }));
+    EXPECT_FALSE(watchdog.Stalled(0));
+    EXPECT_FALSE(pool.QueParked(0));
+
+    watchdog.Release();
+    pool.Release();
+    EXPECT_EQ(pool._sum, 150);
+    EXPECT_EQ(log.Count(WQ_WATCHDOG_EVENT::STALL, 1) + log.Count(WQ_WATCHDOG_EVENT::STALL, 2), 0u);
+}
+
+
+TEST(test_watchdog, wd_rehome_barrier)
+{
+    HangPool pool(2);
+    pool.Init(WQ_QUEUE_STATE::WORKING, "RehomeBarrier");
+
+    pool.PushBack(-1);
+    ASSERT_TRUE(WaitFor([&]() { return pool._hung.load(); }));
+    for (int i = 0; i < 100; ++i)
+        pool.PushBack(1);
+
+    //The items moved off the hung worker keep the barrier up until the slow one popped them
+    pool._slow = true;
+    int sumAtWake = -1;
+    std::thread waiter([&]() { EXPECT_EQ(pool.WaitIdle(SEC_TO_NS(5)), 0); sumAtWake = pool._sum; });
+    usleep(5000);
+    EXPECT_GT(pool.Rehome(0), 0u);
+    pool._release = true;
+    waiter.join();
+
+    EXPECT_EQ(sumAtWake, 100);
+    pool.Release();
+}
+
+
+TEST(test_watchdog, wd_backlog)
+{
+    HangPool pool(2);
+    pool.Init(WQ_QUEUE_STATE::WORKING, "Backlog");
+
+    EventLog log;
+    WQWatchdogConfig cfg;
+    cfg._popBudgetNs   = 0;
+    cfg._backlogBudget = 5;
+    cfg._growthBudget  = 100.0;
+    WQWatchdog<HangPool> watchdog(pool, cfg, [&log](const WQWatchdogEvent &ev) { log.Add(ev); });
+    watchdog.Init(MS_TO_NS(5));
+
+    //Keys 0, 2, 4... stay on worker 0 behind the hung item
+    pool.PushBack(-1);
+    ASSERT_TRUE(WaitFor([&]() { return pool._hung.load(); }));
+    for (uint64_t key = 0; key < 40; key += 2)
+        pool.PushConflate(key, 1);
+
+    EXPECT_TRUE(WaitFor([&]() { return 1 == log.Count(WQ_WATCHDOG_EVENT::BACKLOG, 0); }));
+    EXPECT_TRUE(WaitFor([&]() { return 1 == log.Count(WQ_WATCHDOG_EVENT::GROWTH,  0); }));
+    EXPECT_EQ(log.Count(WQ_WATCHDOG_EVENT::STALL, 0), 0u);
+    EXPECT_EQ(log.Count(WQ_WATCHDOG_EVENT::BACKLOG, 1), 0u);
+
+    pool._release = true;
+    watchdog.Release();
+    pool.Release();
+    EXPECT_EQ(pool._sum, 20);
+}
+
+
+// clang-format on
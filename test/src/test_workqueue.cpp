@@ -4,8 +4,12 @@
 
 #include <WorkQueue.h>
 
+#include "TestUtil.h"
+
 #include <gtest/gtest.h>
 #include <atomic>
+#include <memory>
+#include <thread>
 #include <unistd.h>
 
 
@@ -217,6 +221,134 @@ TEST(test_workqueue, wq_pushfresh)
 
 
 
+class QueMoveTest : public WorkQueue<std::unique_ptr<int>, QueMoveTest>
+{
+    public :
+        void Pop(std::unique_ptr<int> *pData)   { _sum += **pData; }
+        void Begin()                            {}
+        void End()                              {}
+
+        int _sum = 0;
+};
+
+
+TEST(test_workqueue, wq_pushmove)
+{
+    QueMoveTest que;
+    que.Init(WQ_QUEUE_STATE::WORKING, "PushMoveTest");
+
+    //Move-only items go through the rvalue overloads without a copy
+    auto item = std::make_unique<int>(1);
+    que.PushBack(std::move(item));
+    EXPECT_FALSE(item);
+    que.PushFront(std::make_unique<int>(2));
+    que.PushBack(std::make_unique<int>(4));
+    que.Release();
+
+    EXPECT_EQ(7, que._sum);
+}
+
+
+
+class WQSlowTester : public WorkQueue<int, WQSlowTester>
+{
+    public:
+        void Begin()    {}
+        void End()      {}
+        void Pop(int *pData)
+        {
+            while (_hold.load())
+                usleep(100);
+            usleep(20);
+            _sum += *pData;
+        }
+
+        std::atomic_bool    _hold {false};
+        std::atomic<int>    _sum  {0};
+};
+
+
+TEST(test_workqueue, wq_waitidle)
+{
+    WQSlowTester que;
+    que.Init(WQ_QUEUE_STATE::WORKING);
+
+    //Size() reaches zero as soon as the batch is drained, the barrier waits for the Pops
+    for (int i = 0; i < 200; ++i)
+        que.PushBack(1);
+    que.Flush();
+    EXPECT_EQ(que._sum, 200);
+    EXPECT_EQ(que.Completed(), 200u);
+
+    que._hold = true;
+    que.PushBack(1);
+    EXPECT_EQ(que.WaitIdle(MS_TO_NS(5)), -1);
+    que._hold = false;
+    EXPECT_EQ(que.WaitIdle(SEC_TO_NS(5)), 0);
+    EXPECT_EQ(que._sum, 201);
+
+    //Items cleared by PushFresh count as done
+    que.PushFresh(0);
+    EXPECT_EQ(que.WaitIdle(SEC_TO_NS(5)), 0);
+    que.Release();
+}
+
+
+TEST(test_workqueue, wq_waitidle_front)
+{
+    WQSlowTester que;
+    que._hold = true;
+    que.Init(WQ_QUEUE_STATE::WORKING);
+
+    //10 and 100 wait behind the held item, the barrier is raised before a PushFront overtakes them
+    que.PushBack(1);
+    ASSERT_TRUE(WaitFor([&]() { return 0 != que.PopRunningNs(); }));
+    que.PushBack(10);
+    que.PushBack(100);
+
+    int sumAtWake = -1;
+    std::thread waiter([&]() { EXPECT_EQ(que.WaitIdle(SEC_TO_NS(5)), 0); sumAtWake = que._sum; });
+    usleep(5000);
+    que.PushFront(1000);
+    que._hold = false;
+    waiter.join();
+
+    //The later item is not counted in place of an older one
+    EXPECT_EQ(sumAtWake % 1000, 111);
+    que.Release();
+}
+
+
+TEST(test_workqueue, wq_releasetimeout)
+{
+    {
+        WQSlowTester que;
+        que.Init(WQ_QUEUE_STATE::WORKING);
+        for (int i = 0; i < 10; ++i)
+            que.PushBack(1);
+        EXPECT_EQ(que.Release(timespec{5, 0}), 0);
+        EXPECT_EQ(que._sum, 10);
+    }
+
+    {
+        //A stuck Pop escalates to a forced exit, the items behind it are dropped
+        WQSlowTester que;
+        que._hold = true;
+        que.Init(WQ_QUEUE_STATE::WORKING);
+        for (int i = 0; i < 10; ++i)
+            que.PushBack(1);
+
+        std::thread unblock([&que]() { usleep(50'000); que._hold = false; });
+        EXPECT_EQ(que.Release(timespec{0, long(MS_TO_NS(10))}), -1);
+        unblock.join();
+
+        EXPECT_LT(que._sum, 10);
+        EXPECT_EQ(que.Stats()._popped + que.Stats()._dropped, 10u);
+    }
+}
+
+
+
 
 TEST(test_wqpool, wqp_basicpush)
 {
@@ -268,4 +400,32 @@ TEST(test_wqpool, wqp_basicpush)
 }
 
 
+TEST(test_wqpool, wqp_waitidle)
+{
+    class WQPSlow : public WorkQueuePool<int, WQPSlow>
+    {
+        public:
+            WQPSlow(size_t queCount) : WorkQueuePool<int, WQPSlow>(queCount) {}
+
+            void Begin()            {}
+            void End()              {}
+            void Pop(int *pData)    { usleep(10); _sum += *pData; }
+
+            std::atomic<int>    _sum {0};
+    };
+
+    WQPSlow wpool(3);
+    wpool.Init(WQ_QUEUE_STATE::WORKING, "WQPSlow");
+    for (int i = 0; i < 300; ++i)
+        wpool.PushBack(1);
+    EXPECT_EQ(wpool.WaitIdle(SEC_TO_NS(10)), 0);
+    EXPECT_EQ(wpool._sum, 300);
+
+    for (int i = 0; i < 30; ++i)
+        wpool.PushBack(1);
+    EXPECT_EQ(wpool.Release(timespec{10, 0}), 0);
+    EXPECT_EQ(wpool._sum, 330);
+}
+
+
 // clang-format on